@@ -0,0 +1,359 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file Stability.cpp : streaming clock stability statistics of the IRIG-B analyzer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Stability.h"
+
+enum _STABILITY_COMMAND_
+{
+	COMMAND_PROCESS = 0,		/* process the samples from chunk_start to n */
+	COMMAND_GAP,			/* forget the samples of the segment */
+	COMMAND_RESET,			/* forget the samples and the results */
+	COMMAND_QUIT
+};
+
+#define X(s, i)				((s)->x[(i) & (s)->x_mask])
+
+static void tau_forget(TAU_STATE *t)
+{
+	t->d_pos = t->d_count = 0;
+	t->d_sum = 0;
+	t->qmax_head = t->qmax_tail = 0;
+	t->qmin_head = t->qmin_tail = 0;
+}
+
+static void tau_clear(TAU_STATE *t)
+{
+	tau_forget(t);
+	t->adev_sum = t->tdev_sum = 0;
+	t->adev_n = t->tdev_n = 0;
+	t->mtie = 0;
+}
+
+/* Accumulate the samples from..to of the segment into a tau */
+static void tau_process(STABILITY *s, TAU_STATE *t, long long from, long long to)
+{
+	long m = t->m, size = m + 2;
+	double xi, d;
+
+	for (long long i = from; i < to; i++) {
+		xi = X(s, i);
+
+		if (i >= 2 * m) {
+			d = xi - 2 * X(s, i - m) + X(s, i - 2 * m);
+			t->adev_sum += d * d;
+			t->adev_n++;
+
+			/* A sliding sum of the last m second differences */
+			if (t->d_count == m) {
+				t->d_sum -= t->d[t->d_pos];
+			} else {
+				t->d_count++;
+			}
+			t->d[t->d_pos] = d;
+			t->d_sum += d;
+			t->d_pos = (t->d_pos + 1) % m;
+			if (t->d_count == m) {
+				t->tdev_sum += t->d_sum * t->d_sum;
+				t->tdev_n++;
+			}
+		}
+
+		/* The maximum and minimum of the window i - m .. i */
+		if (t->qmax_tail != t->qmax_head && t->qmax[t->qmax_head] < i - m) {
+			t->qmax_head = (t->qmax_head + 1) % size;
+		}
+		while (t->qmax_tail != t->qmax_head && X(s, t->qmax[(t->qmax_tail - 1 + size) % size]) <= xi) {
+			t->qmax_tail = (t->qmax_tail - 1 + size) % size;
+		}
+		t->qmax[t->qmax_tail] = i;
+		t->qmax_tail = (t->qmax_tail + 1) % size;
+
+		if (t->qmin_tail != t->qmin_head && t->qmin[t->qmin_head] < i - m) {
+			t->qmin_head = (t->qmin_head + 1) % size;
+		}
+		while (t->qmin_tail != t->qmin_head && X(s, t->qmin[(t->qmin_tail - 1 + size) % size]) >= xi) {
+			t->qmin_tail = (t->qmin_tail - 1 + size) % size;
+		}
+		t->qmin[t->qmin_tail] = i;
+		t->qmin_tail = (t->qmin_tail + 1) % size;
+
+		if (i >= m && X(s, t->qmax[t->qmax_head]) - X(s, t->qmin[t->qmin_head]) > t->mtie) {
+			t->mtie = X(s, t->qmax[t->qmax_head]) - X(s, t->qmin[t->qmin_head]);
+		}
+	}
+}
+
+/* Every worker owns the taus index, index + threads, ... */
+static void *stability_worker(void *arg)
+{
+	STABILITY_WORKER *w = (STABILITY_WORKER *)arg;
+	STABILITY *s = w->s;
+
+	for (;;) {
+		pthread_barrier_wait(&s->start);
+		if (s->command == COMMAND_QUIT) {
+			break;
+		}
+
+		for (int k = w->index; k < s->tau_count; k += s->threads) {
+			if (s->command == COMMAND_PROCESS) {
+				tau_process(s, &s->tau[k], s->chunk_start, s->n);
+			} else if (s->command == COMMAND_GAP) {
+				tau_forget(&s->tau[k]);
+			} else {
+				tau_clear(&s->tau[k]);
+			}
+		}
+
+		pthread_barrier_wait(&s->done);
+	}
+
+	return NULL;
+}
+
+static int hist_index(double x)
+{
+	double a = fabs(x);
+	int b;
+
+	if (a < 1) {
+		return HIST_BUCKETS;
+	}
+	b = 1 + (int)(log(a) / log(HIST_GROWTH));
+	if (b > HIST_BUCKETS) {
+		b = HIST_BUCKETS;
+	}
+
+	return x < 0 ? HIST_BUCKETS - b : HIST_BUCKETS + b;
+}
+
+/* The geometric middle of a bucket */
+static double hist_value(int index)
+{
+	int b = index - HIST_BUCKETS;
+
+	if (b == 0) {
+		return 0;
+	}
+
+	return (b < 0 ? -1 : 1) * pow(HIST_GROWTH, abs(b) - 0.5);
+}
+
+/* The offset distribution, while the workers process the same samples */
+static void offset_process(STABILITY *s, long long from, long long to)
+{
+	double x, delta;
+
+	for (long long i = from; i < to; i++) {
+		x = X(s, i);
+		if (s->count == 0 || x < s->min) {
+			s->min = x;
+		}
+		if (s->count == 0 || x > s->max) {
+			s->max = x;
+		}
+		s->count++;
+		delta = x - s->mean;
+		s->mean += delta / s->count;
+		s->m2 += delta * (x - s->mean);
+		s->hist[hist_index(x)]++;
+	}
+}
+
+static void run(STABILITY *s, int command)
+{
+	s->command = command;
+	pthread_barrier_wait(&s->start);
+	if (command == COMMAND_PROCESS) {
+		offset_process(s, s->chunk_start, s->n);
+	}
+	pthread_barrier_wait(&s->done);
+	s->chunk_start = s->n;
+}
+
+int stability_init(STABILITY *s, double tau0, long max_points, int threads)
+{
+	long long ring = 1;
+	long m;
+
+	memset(s, 0, sizeof(*s));
+	s->tau0 = tau0;
+
+	/* The taus of an octave series */
+	s->tau = (TAU_STATE *)calloc(32, sizeof(*s->tau));
+	if (s->tau == NULL) {
+		return -1;
+	}
+	for (m = 1; m <= max_points && s->tau_count < 32; m *= 2) {
+		TAU_STATE *t = &s->tau[s->tau_count++];
+
+		t->m = m;
+		t->d = (double *)calloc(m, sizeof(*t->d));
+		t->qmax = (long long *)calloc(m + 2, sizeof(*t->qmax));
+		t->qmin = (long long *)calloc(m + 2, sizeof(*t->qmin));
+		if (t->d == NULL || t->qmax == NULL || t->qmin == NULL) {
+			return -1;
+		}
+	}
+
+	/* Keep the 2 * m samples of the longest tau and a chunk */
+	while (ring < 2 * s->tau[s->tau_count - 1].m + STABILITY_CHUNK + 1) {
+		ring *= 2;
+	}
+	s->x = (double *)malloc(ring * sizeof(*s->x));
+	if (s->x == NULL) {
+		return -1;
+	}
+	s->x_mask = ring - 1;
+
+	if (threads > s->tau_count) {
+		threads = s->tau_count;
+	}
+	if (threads > MAX_STABILITY_THREADS) {
+		threads = MAX_STABILITY_THREADS;
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+	s->threads = threads;
+	pthread_barrier_init(&s->start, NULL, threads + 1);
+	pthread_barrier_init(&s->done, NULL, threads + 1);
+	for (int i = 0; i < threads; i++) {
+		s->worker[i].s = s;
+		s->worker[i].index = i;
+		if (pthread_create(&s->worker[i].thread, NULL, stability_worker, &s->worker[i]) != 0) {
+			fprintf(stderr, "pthread_create() fail\n");
+			exit(1);
+		}
+	}
+
+	return 0;
+}
+
+void stability_add(STABILITY *s, double x)
+{
+	X(s, s->n) = x;
+	s->n++;
+	if (s->n - s->chunk_start == STABILITY_CHUNK) {
+		run(s, COMMAND_PROCESS);
+	}
+}
+
+void stability_gap(STABILITY *s)
+{
+	if (s->n == 0) {
+		return;
+	}
+
+	stability_flush(s);
+	run(s, COMMAND_GAP);
+	s->n = s->chunk_start = 0;
+	s->gaps++;
+}
+
+void stability_flush(STABILITY *s)
+{
+	if (s->n > s->chunk_start) {
+		run(s, COMMAND_PROCESS);
+	}
+}
+
+void stability_reset(STABILITY *s)
+{
+	run(s, COMMAND_RESET);
+	s->n = s->chunk_start = 0;
+	s->count = 0;
+	s->mean = s->m2 = s->min = s->max = 0;
+	s->gaps = 0;
+	memset(s->hist, 0, sizeof(s->hist));
+}
+
+double stability_percentile(STABILITY *s, double q, int absolute)
+{
+	unsigned long long target, seen = 0;
+	double lo = s->min, hi = s->max, v = 0;
+
+	if (s->count == 0) {
+		return 0;
+	}
+	target = (unsigned long long)ceil(q * s->count);
+	if (target < 1) {
+		target = 1;
+	}
+
+	if (absolute) {
+		lo = 0;
+		hi = fmax(fabs(s->min), fabs(s->max));
+		v = hi;
+		for (int b = 0; b <= HIST_BUCKETS; b++) {
+			seen += s->hist[HIST_BUCKETS + b] + (b ? s->hist[HIST_BUCKETS - b] : 0);
+			if (seen >= target) {
+				v = fabs(hist_value(HIST_BUCKETS + b));
+				break;
+			}
+		}
+	} else {
+		v = hi;
+		for (int i = 0; i <= 2 * HIST_BUCKETS; i++) {
+			seen += s->hist[i];
+			if (seen >= target) {
+				v = hist_value(i);
+				break;
+			}
+		}
+	}
+
+	/* The middle of the first or last bucket may be beyond the samples */
+	return fmin(fmax(v, lo), hi);
+}
+
+double stability_adev(STABILITY *s, TAU_STATE *t)
+{
+	double tau = t->m * s->tau0;
+
+	if (t->adev_n == 0) {
+		return 0;
+	}
+
+	return sqrt(t->adev_sum / (2.0 * t->adev_n)) * 1e-9 / tau;
+}
+
+double stability_tdev(TAU_STATE *t)
+{
+	if (t->tdev_n == 0) {
+		return 0;
+	}
+
+	return sqrt(t->tdev_sum / (6.0 * (double)t->m * t->m * t->tdev_n));
+}
+
+void stability_free(STABILITY *s)
+{
+	s->command = COMMAND_QUIT;
+	pthread_barrier_wait(&s->start);
+	for (int i = 0; i < s->threads; i++) {
+		pthread_join(s->worker[i].thread, NULL);
+	}
+	pthread_barrier_destroy(&s->start);
+	pthread_barrier_destroy(&s->done);
+
+	for (int k = 0; k < s->tau_count; k++) {
+		free(s->tau[k].d);
+		free(s->tau[k].qmax);
+		free(s->tau[k].qmin);
+	}
+	free(s->tau);
+	free(s->x);
+}
@@ -0,0 +1,157 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file Stability.h : streaming clock stability statistics of the IRIG-B analyzer.
+ *
+ * The time error samples are taken one at a time and kept only as long as the
+ * largest observation interval needs them, so the input may be of any length.
+ * For every tau of an octave series the overlapping Allan deviation, the time
+ * deviation and the maximum time interval error are accumulated in one pass,
+ * the taus are split over worker threads which process a chunk of samples in
+ * parallel. The offset distribution is kept in a log histogram of 1% buckets.
+ */
+
+#ifndef __STABILITY_H_
+#define __STABILITY_H_
+
+#include <pthread.h>
+
+#define STABILITY_CHUNK			65536		/* samples processed by the workers at a time */
+#define MAX_TAU_POINTS			(1 << 22)	/* the longest tau in samples */
+#define DEFAULT_TAU_POINTS		(1 << 16)
+#define MAX_STABILITY_THREADS		64
+#define HIST_GROWTH			1.01		/* bucket width, the relative error of a percentile */
+#define HIST_BUCKETS			3200		/* per sign, up to 1.01^3200 ns, about 18 hours */
+
+/* The accumulators of a tau */
+typedef struct _TAU_STATE {
+	long m;				/* tau in samples */
+
+	/* ADEV, the second differences x[i] - 2x[i-m] + x[i-2m] */
+	double adev_sum;		/* sum of the squared second differences in ns^2 */
+	long long adev_n;
+
+	/* TDEV, the sums of m consecutive second differences */
+	double *d;			/* the last m second differences */
+	long d_pos;
+	long d_count;
+	double d_sum;
+	double tdev_sum;		/* sum of the squared sums in ns^2 */
+	long long tdev_n;
+
+	/* MTIE, monotonic queues of the sample indexes of the window maximum and minimum */
+	long long *qmax;
+	long long *qmin;
+	long qmax_head, qmax_tail;
+	long qmin_head, qmin_tail;
+	double mtie;			/* the largest peak to peak time error in a window of m + 1 samples in ns */
+} TAU_STATE;
+
+typedef struct _STABILITY STABILITY;
+
+typedef struct _STABILITY_WORKER {
+	STABILITY *s;
+	int index;
+	pthread_t thread;
+} STABILITY_WORKER;
+
+struct _STABILITY {
+	double tau0;			/* the sample interval in seconds */
+	int tau_count;
+	TAU_STATE *tau;
+
+	/* The samples of the current segment, a gap starts a new one */
+	double *x;			/* time error in ns, a ring of the last samples */
+	long long x_mask;
+	long long n;			/* samples in the segment */
+	long long chunk_start;		/* the first sample not processed yet */
+
+	/* Offset distribution */
+	long long count;
+	double mean;
+	double m2;			/* sum of the squared differences from the mean */
+	double min;
+	double max;
+	unsigned long long hist[2 * HIST_BUCKETS + 1];	/* negative, zero and positive buckets */
+	long long gaps;			/* segments started after a missing sample */
+
+	/* Workers */
+	int threads;
+	int command;			/* one of _STABILITY_COMMAND_ */
+	pthread_barrier_t start;
+	pthread_barrier_t done;
+	STABILITY_WORKER worker[MAX_STABILITY_THREADS];
+};
+
+/**
+ * Allocate the accumulators and start the workers
+ * @param  [out] s - the statistics
+ * @param  [in] tau0 - the sample interval in seconds
+ * @param  [in] max_points - the longest tau in samples
+ * @param  [in] threads - the number of workers
+ * @return If the operation completes successfully, the return value is zero.
+ */
+int stability_init(STABILITY *s, double tau0, long max_points, int threads);
+
+/**
+ * Add the next sample
+ * @param  [in] s - the statistics
+ * @param  [in] x - the time error in ns
+ * @return None
+ */
+void stability_add(STABILITY *s, double x);
+
+/**
+ * The samples before and after are not contiguous, no difference spans a gap
+ * @param  [in] s - the statistics
+ * @return None
+ */
+void stability_gap(STABILITY *s);
+
+/**
+ * Process the pending samples, call before reading the results
+ * @param  [in] s - the statistics
+ * @return None
+ */
+void stability_flush(STABILITY *s);
+
+/**
+ * Clear the results and the samples for a new window
+ * @param  [in] s - the statistics
+ * @return None
+ */
+void stability_reset(STABILITY *s);
+
+/**
+ * Get a percentile of the offsets
+ * @param  [in] s - the statistics
+ * @param  [in] q - the fraction of the samples at or below the result, 0 ~ 1
+ * @param  [in] absolute - nonzero for the percentile of |offset|
+ * @return The offset in ns
+ */
+double stability_percentile(STABILITY *s, double q, int absolute);
+
+/**
+ * Get the Allan deviation of a tau
+ * @return The deviation, 0 without enough samples
+ */
+double stability_adev(STABILITY *s, TAU_STATE *t);
+
+/**
+ * Get the time deviation of a tau
+ * @return The deviation in ns, 0 without enough samples
+ */
+double stability_tdev(TAU_STATE *t);
+
+/**
+ * Stop the workers and free the accumulators
+ * @param  [in] s - the statistics
+ * @return None
+ */
+void stability_free(STABILITY *s);
+
+#endif  // __STABILITY_H_
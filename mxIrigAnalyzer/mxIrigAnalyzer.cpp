@@ -0,0 +1,398 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file mxIrigAnalyzer.cpp : Offline clock stability analyzer of the IRIG-B time sync daemon samples.
+ *
+ * Usage: mxIrigAnalyzer -c [card] -T [tier] -f [from] -t [to] -w [window] -i [tau0] -M [max tau] -n [threads] [journal file or archive dir]
+ *
+ * Reads the sample journal (-j) or the archive (-k) of ServiceSyncTime and
+ * prints a JSON report of the time error of every window: the offset
+ * distribution, the IEC 61850-5 time accuracy class, and the Allan deviation,
+ * time deviation and MTIE of an octave series of observation intervals.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../mxSyncTimeSvc/SyncJournal.h"
+#include "../mxSyncTimeSvc/SyncArchive.h"
+#include "../mxSyncTimeSvc/SyncMonitor.h"
+#include "Stability.h"
+
+#define TAU0_PROBE			64		/* samples to estimate the sample interval from */
+#define GAP_TOLERANCE			1.5		/* a longer interval between samples is a gap, in tau0 */
+
+typedef struct _ANALYZER {
+	/* Options */
+	const char *source;
+	int card;
+	int tier;			/* one of _SYNC_ARCHIVE_TIER_, archive only */
+	int64_t from;			/* us since the Epoch */
+	int64_t to;
+	int64_t window;			/* window length in us, 0 for the whole range */
+	double tau0;			/* sample interval in seconds, 0 to estimate */
+	double max_tau;			/* the longest tau in seconds, 0 for DEFAULT_TAU_POINTS */
+	int threads;
+
+	/* The first samples, until the sample interval is known */
+	int64_t probe_time[TAU0_PROBE];
+	double probe_x[TAU0_PROBE];
+	int probe_n;
+	int started;
+
+	/* The current window */
+	int64_t win_start;
+	int64_t win_end;
+	int64_t first;			/* the first and last sample times */
+	int64_t last;
+	long long samples;
+	int windows;			/* windows printed */
+	STABILITY s;
+} ANALYZER;
+
+void usage(char *name) {
+
+	printf("Offline clock stability analyzer of the IRIG-B time sync daemon samples.\n");
+	printf("Usage: %s -c [card] -T [tier] -f [from] -t [to] -w [window] -i [tau0] -M [max tau] -n [threads] [journal file or archive dir]\n", name);
+	printf("   [journal file or archive dir] - The -j journal file or the -k archive directory of ServiceSyncTime\n");
+	printf("   -c - [card] The card index. default value is 0\n");
+	printf("   -T - [tier] The archive tier, raw, minute or hour. default is raw\n");
+	printf("   -f - [from] The first sample time in seconds since the Epoch. default is the oldest sample\n");
+	printf("   -t - [to] The last sample time in seconds since the Epoch. default is the newest sample\n");
+	printf("   -w - [window] Report every window of this many seconds from the first sample. default is one window\n");
+	printf("   -i - [tau0] The sample interval in seconds. default is estimated from the samples\n");
+	printf("   -M - [max tau] The longest observation interval in seconds. default is %d sample intervals\n", DEFAULT_TAU_POINTS);
+	printf("   -n - [threads] The worker threads. default is the number of CPUs\n");
+	printf("The report is JSON: the offset distribution, the IEC 61850-5 class, and ADEV, TDEV and MTIE per tau.\n");
+	printf("Usage example: Report the stability of card 0 per day from the journal\n");
+	printf("root@Moxa:~# mxIrigAnalyzer -w 86400 /var/lib/ServiceSyncTime.journal\n");
+	printf("Usage example: Report the minute means of a month from the archive\n");
+	printf("root@Moxa:~# mxIrigAnalyzer -T minute -f 1790812800 -t 1793491199 /var/lib/ServiceSyncTime.archive\n");
+}
+
+static int compare_delta(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* The median interval of the first samples, rounded to a whole rate or whole seconds */
+static double estimate_tau0(ANALYZER *a)
+{
+	int64_t delta[TAU0_PROBE];
+	int n = 0;
+	double median;
+
+	for (int i = 1; i < a->probe_n; i++) {
+		if (a->probe_time[i] > a->probe_time[i - 1]) {
+			delta[n++] = a->probe_time[i] - a->probe_time[i - 1];
+		}
+	}
+	if (n == 0) {
+		return 1;
+	}
+	qsort(delta, n, sizeof(delta[0]), compare_delta);
+	median = delta[n / 2] / 1e6;
+
+	if (median >= 0.5) {
+		return round(median);
+	}
+
+	return 1 / round(1 / median);
+}
+
+static void print_number(const char *name, double v, const char *sep)
+{
+	printf("\"%s\": %.6g%s", name, v, sep);
+}
+
+/* Print a JSON string, escaping the quotes, the backslashes and the control characters */
+static void print_string(const char *name, const char *v, const char *sep)
+{
+	printf("\"%s\": \"", name);
+	for (; *v; v++) {
+		if (*v == '"' || *v == '\\') {
+			printf("\\%c", *v);
+		} else if ((unsigned char)*v < 0x20) {
+			printf("\\u%04x", (unsigned char)*v);
+		} else {
+			putchar(*v);
+		}
+	}
+	printf("\"%s", sep);
+}
+
+/* Print the report of the current window and start the next */
+static void finish_window(ANALYZER *a)
+{
+	STABILITY *s = &a->s;
+	double worst;
+	int printed = 0;
+
+	if (a->samples == 0) {
+		return;
+	}
+	stability_flush(s);
+
+	worst = fmax(fabs(s->min), fabs(s->max));
+	printf("%s\n    {\n", a->windows ? "," : "");
+	printf("      \"from\": %.6f, \"to\": %.6f, \"samples\": %lld, \"gaps\": %lld,\n",
+		a->first / 1e6, a->last / 1e6, a->samples, s->gaps);
+
+	printf("      \"offset_ns\": { ");
+	print_number("mean", s->mean, ", ");
+	print_number("stddev", s->count > 1 ? sqrt(s->m2 / (s->count - 1)) : 0, ", ");
+	print_number("min", s->min, ", ");
+	print_number("p1", stability_percentile(s, 0.01, 0), ", ");
+	print_number("p50", stability_percentile(s, 0.50, 0), ", ");
+	print_number("p99", stability_percentile(s, 0.99, 0), ", ");
+	print_number("max", s->max, " },\n");
+
+	printf("      \"abs_offset_ns\": { ");
+	print_number("p50", stability_percentile(s, 0.50, 1), ", ");
+	print_number("p95", stability_percentile(s, 0.95, 1), ", ");
+	print_number("p99", stability_percentile(s, 0.99, 1), ", ");
+	print_number("p99_9", stability_percentile(s, 0.999, 1), ", ");
+	print_number("p99_99", stability_percentile(s, 0.9999, 1), ", ");
+	print_number("max", worst, " },\n");
+
+	/* The class every sample of the window meets */
+	printf("      \"iec61850_5_class\": \"%s\", \"ieee_c37_238_1us\": %s,\n",
+		monitor_class_name((long long)ceil(worst)), worst <= 1000 ? "true" : "false");
+
+	printf("      \"stability\": [");
+	for (int k = 0; k < s->tau_count; k++) {
+		TAU_STATE *t = &s->tau[k];
+
+		if (t->adev_n == 0) {
+			continue;
+		}
+		printf("%s\n        { ", printed++ ? "," : "");
+		print_number("tau_s", t->m * s->tau0, ", ");
+		print_number("adev", stability_adev(s, t), ", ");
+		print_number("tdev_ns", stability_tdev(t), ", ");
+		print_number("mtie_ns", t->mtie, ", ");
+		printf("\"terms\": %lld }", t->adev_n);
+	}
+	printf("%s]\n    }", printed ? "\n      " : "");
+
+	a->windows++;
+	a->samples = 0;
+	stability_reset(s);
+}
+
+static void add_sample(ANALYZER *a, int64_t time, double x)
+{
+	/* A new window, the windows start at the first sample or at -f */
+	if (a->samples == 0 && a->window == 0) {
+		a->win_start = time;
+		a->win_end = INT64_MAX;
+	} else if (time >= a->win_end || (a->window && a->win_end == 0)) {
+		finish_window(a);
+		if (a->win_end == 0) {
+			a->win_start = a->from > 0 ? a->from : time;
+			a->win_end = a->win_start + a->window;
+		}
+		while (time >= a->win_end) {
+			a->win_start = a->win_end;
+			a->win_end += a->window;
+		}
+	}
+
+	if (a->samples > 0 && (time <= a->last || time - a->last > GAP_TOLERANCE * a->tau0 * 1e6)) {
+		stability_gap(&a->s);
+	}
+	if (a->samples == 0) {
+		a->first = time;
+	}
+	a->last = time;
+	a->samples++;
+	stability_add(&a->s, x);
+}
+
+/* The sample interval is known, start the statistics and replay the first samples */
+static int start(ANALYZER *a)
+{
+	long points;
+
+	if (a->tau0 <= 0) {
+		a->tau0 = estimate_tau0(a);
+	}
+	points = a->max_tau > 0 ? (long)(a->max_tau / a->tau0) : DEFAULT_TAU_POINTS;
+	if (points < 1) {
+		points = 1;
+	}
+	if (points > MAX_TAU_POINTS) {
+		points = MAX_TAU_POINTS;
+	}
+	if (stability_init(&a->s, a->tau0, points, a->threads) < 0) {
+		fprintf(stderr, "Out of memory for a max tau of %ld samples\n", points);
+		return -1;
+	}
+	a->started = 1;
+
+	printf("{\n  ");
+	print_string("source", a->source, ", ");
+	printf("\"card\": %d, \"tier\": \"%s\", \"tau0_s\": %.6g, \"threads\": %d,\n  \"windows\": [",
+		a->card, a->tier == ARCHIVE_MINUTE ? "minute" : a->tier == ARCHIVE_HOUR ? "hour" : "raw",
+		a->tau0, a->s.threads);
+
+	for (int i = 0; i < a->probe_n; i++) {
+		add_sample(a, a->probe_time[i], a->probe_x[i]);
+	}
+
+	return 0;
+}
+
+static int feed(ANALYZER *a, int64_t time, double x)
+{
+	if (time < a->from || time > a->to) {
+		return 0;
+	}
+
+	if (!a->started) {
+		a->probe_time[a->probe_n] = time;
+		a->probe_x[a->probe_n] = x;
+		if (++a->probe_n < TAU0_PROBE) {
+			return 0;
+		}
+		return start(a);
+	}
+
+	add_sample(a, time, x);
+
+	return 0;
+}
+
+static int journal_sample(const SYNC_RECORD *r, void *arg)
+{
+	ANALYZER *a = (ANALYZER *)arg;
+
+	if (r->card != a->card || !(r->flags & SYNC_RECORD_RTC_VALID)) {
+		return 0;
+	}
+
+	return feed(a, (r->t1 + r->latency / 2) / 1000, (double)SYNC_RECORD_OFFSET(r));
+}
+
+static int archive_sample(int card, int tier, const SYNC_POINT *p, void *arg)
+{
+	(void)card;
+	(void)tier;
+
+	return feed((ANALYZER *)arg, p->time, (double)p->offset);
+}
+
+int main(int argc, char *argv[])
+{
+	char optstring[] = "hc:T:f:t:w:i:M:n:";
+	ANALYZER a;
+	struct stat st;
+	long long n;
+	int c;
+
+	memset(&a, 0, sizeof(a));
+	a.tier = ARCHIVE_RAW;
+	a.to = INT64_MAX;
+	a.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	if ( argc == 1 ) {
+		usage(argv[0]);
+		return 0;
+	}
+
+	while ((c = getopt(argc, argv, optstring)) != -1) {
+		switch (c) {
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		case 'c':
+			a.card = atoi(optarg);
+			break;
+		case 'T':
+			a.tier = sync_archive_tier(optarg);
+			if ( a.tier < 0 ) {
+				printf("Invalid T:%s is not raw, minute or hour\n", optarg);
+				return 1;
+			}
+			break;
+		case 'f':
+			a.from = atoll(optarg) * 1000000;
+			break;
+		case 't':
+			a.to = atoll(optarg) * 1000000 + 999999;
+			break;
+		case 'w':
+			a.window = atoll(optarg) * 1000000;
+			if ( a.window <= 0 ) {
+				printf("Invalid w:%s is not a number of seconds\n", optarg);
+				return 1;
+			}
+			break;
+		case 'i':
+			a.tau0 = atof(optarg);
+			if ( a.tau0 <= 0 ) {
+				printf("Invalid i:%s is not a positive number of seconds\n", optarg);
+				return 1;
+			}
+			break;
+		case 'M':
+			a.max_tau = atof(optarg);
+			if ( a.max_tau <= 0 ) {
+				printf("Invalid M:%s is not a positive number of seconds\n", optarg);
+				return 1;
+			}
+			break;
+		case 'n':
+			a.threads = atoi(optarg);
+			if ( a.threads < 1 || a.threads > MAX_STABILITY_THREADS ) {
+				printf("Invalid n:%s is not in 1 ~ %d\n", optarg, MAX_STABILITY_THREADS);
+				return 1;
+			}
+			break;
+		case '?':
+		default:
+			printf("Invalid option\n");
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if ( optind >= argc ) {
+		printf("No journal file or archive directory\n");
+		return 1;
+	}
+	a.source = argv[optind];
+
+	/* Stream the samples, only the history of the longest tau is kept */
+	if ( stat(a.source, &st) == 0 && S_ISDIR(st.st_mode) )
+		n = sync_archive_query(a.source, a.tier, a.card, a.from, a.to, archive_sample, &a, NULL);
+	else
+		n = sync_journal_scan(a.source, journal_sample, &a);
+	if ( n < 0 )
+		return 1;
+
+	if ( !a.started && a.probe_n > 0 && start(&a) < 0 )
+		return 1;
+	if ( !a.started ) {
+		printf("{\n  ");
+		print_string("source", a.source, ", ");
+		printf("\"card\": %d, \"windows\": [", a.card);
+	} else {
+		finish_window(&a);
+		stability_free(&a.s);
+	}
+	printf("%s]\n}\n", a.windows ? "\n  " : "");
+
+	return 0;
+}
@@ -32,14 +32,17 @@
 const char *strTimeSrc[] = {
 	"Free Run(Internal RTC)",
 	"Port 0/Fiber In",
-	"Port 1 In"
+	"Port 1 In",
+	"Unknown",
+	"PPS In"
 };
 
 const char *strSignalStatus[] = {
 	"Normal",
 	"Off Line",
 	"Frame Error",
-	"Parity Error"
+	"Parity Error",
+	"Unknown"
 };
 
 const char *strPortList[] = {
@@ -100,6 +103,22 @@ enum _IRIG_CMD_FUN_CODE_LIST_ {
 	FUNCODE_mxIrigbSetDigitalOutputSignal,
 	FUNCODE_mxIrigbGetDigitalInputSignal,
 	FUNCODE_mxIrigbGetFpgaBuildDate,
+	FUNCODE_mxIrigbGetLeapSecond,
+	FUNCODE_mxIrigbSetLeapSecond,
+	FUNCODE_mxIrigbGetDstWindow,
+	FUNCODE_mxIrigbSetDstWindow,
+	FUNCODE_mxIrigbGetDecoderFrame,
+	FUNCODE_mxIrigbGetDecoders,
+	FUNCODE_mxIrigbGetAllStatus,
+	FUNCODE_mxIrigbWaitEvent,
+	FUNCODE_mxIrigbGetPpsInput,
+	FUNCODE_mxIrigbSetPpsInput,
+	FUNCODE_mxIrigbGetPpsHoldTime,
+	FUNCODE_mxIrigbSetPpsHoldTime,
+	FUNCODE_mxIrigbGetPpsTimeout,
+	FUNCODE_mxIrigbSetPpsTimeout,
+	FUNCODE_mxIrigbMeasureLoopback,
+	FUNCODE_mxIrigbGetOutputAdvance,
 
 	FUNCODE_MAX
 };
@@ -133,12 +152,12 @@ irigcmd irigcmdlist[] = {
 	{	FUNCODE_mxIrigbSetSyncTimeSrc,
 		"Set IRIG-B RTC Sync. Source", 1,
 		"Source\n\t\tSource:\t\
-0: FreeRun In (Internal RTC)\n\t\t\t1: Port 0/Fiber In, 2: Port 1 In\
+0: FreeRun In (Internal RTC)\n\t\t\t1: Port 0/Fiber In, 2: Port 1 In, 4: PPS In\
 \n\t  default value is 2 if no argument."
 	},
 	{	FUNCODE_mxIrigbGetSignalStatus,
 		"Get IRIG-B Signal Status", 1,
-		"Source\n\t\tSource:\t1: Port 0/Fiber In, 2: Port 1 In\
+		"Source\n\t\tSource:\t1: Port 0/Fiber In, 2: Port 1 In, 4: PPS In\
 \n\t  default value is 2 if no argument."
 	},
 	{	FUNCODE_mxIrigbGetInputParityCheckMode,
@@ -222,6 +241,89 @@ Level:\t[0-1] Output level)\n\t  default value is 0,0 if no argument."
 		"Get FPGA firmware build date", 0,
 		NULL
 	},
+	{
+		FUNCODE_mxIrigbGetLeapSecond,
+		"Get RTC leap second", 0,
+		NULL
+	},
+	{
+		FUNCODE_mxIrigbSetLeapSecond,
+		"Set RTC leap second", 5,
+		"Year,Day,Hour,Minute,Type\n\t\t\
+[2000-2099],[1-366] (day of the year),[0-23],[0-59] (the leap second ends this minute)\n\t\t\
+Type:\t0: Insert, 1: Delete\n\t  Cancel the leap second if no argument."
+	},
+	{
+		FUNCODE_mxIrigbGetDstWindow,
+		"Get RTC daylight saving time", 0,
+		NULL
+	},
+	{
+		FUNCODE_mxIrigbSetDstWindow,
+		"Set RTC daylight saving time", 4,
+		"StartDay,StartHour,EndDay,EndHour\n\t\t\
+[1-366] (day of the year),[0-23],[1-366],[0-23]\n\t  Clear the DST window if no argument."
+	},
+	{
+		FUNCODE_mxIrigbGetDecoderFrame,
+		"Get IRIG-B decoder frame", 1,
+		"Source\n\t\tSource:\t1: Port 0/Fiber In, 2: Port 1 In\
+\n\t  default value is 2 if no argument."
+	},
+	{	FUNCODE_mxIrigbGetDecoders,
+		"Get both IRIG-B decoders", 0,
+		""
+	},
+	{	FUNCODE_mxIrigbGetAllStatus,
+		"Get the status of all sources", 1,
+		"Polls\n\t\tPolls:\tstatus words counted one second apart\
+\n\t  default value is 1 if no argument."
+	},
+	{	FUNCODE_mxIrigbWaitEvent,
+		"Wait for events", 3,
+		"Mask,Timeout,Count\n\t\tMask:\tthe status word bits, e.g. 0x8: Fiber done, 0x80: Port 1 done, 0x200: PPS done\
+\n\t\tTimeout:\tin ms\n\t\tCount:\tevents to wait for\
+\n\t  default value is 0x8,2000,1 if no argument."
+	},
+	{	FUNCODE_mxIrigbGetPpsInput,
+		"Get PPS decoder input port", 0,
+		NULL
+	},
+	{	FUNCODE_mxIrigbSetPpsInput,
+		"Set PPS decoder input port", 1,
+		"Port\n\t\tPort:\t0: Port 0/Fiber, 1: Port 1, 5: Disabled\
+\n\t  default value is 1 if no argument."
+	},
+	{	FUNCODE_mxIrigbGetPpsHoldTime,
+		"Get PPS input hold time(ms)", 0,
+		NULL
+	},
+	{	FUNCODE_mxIrigbSetPpsHoldTime,
+		"Set PPS input hold time(ms)", 1,
+		"Hold\n\t\t[0-999] (hold: 0-999 ms)\
+\n\t  default value is 0 if no argument."
+	},
+	{	FUNCODE_mxIrigbGetPpsTimeout,
+		"Get PPS input timeout(ms)", 0,
+		NULL
+	},
+	{	FUNCODE_mxIrigbSetPpsTimeout,
+		"Set PPS input timeout(ms)", 1,
+		"Timeout\n\t\t[1001-] (timeout: more than 1000 ms)\
+\n\t  default value is 1500 if no argument."
+	},
+	{	FUNCODE_mxIrigbMeasureLoopback,
+		"Measure loopback delay(ns)", 3,
+		"OutPort,InPort,Runs\n\t\tOutPort:\toutput port[1-4] sending the test pulse\
+\n\t\tInPort:\t0: Port 0/Fiber, 1: Port 1 taking it back\
+\n\t\tRuns:\t[1-10000] runs averaged, about 1 ms each\
+\n\t  default value is 1,1,1000 if no argument."
+	},
+	{	FUNCODE_mxIrigbGetOutputAdvance,
+		"Get RTC advance for output cable delays(ns)", 4,
+		"Delay1,Delay2,Delay3,Delay4\n\t\tthe cable delays of output port[1-4] in ns, [-1000000-1000000]\
+\n\t  default value is 0,0,0,0 if no argument."
+	},
 };
 
 void usage(char *name) {
@@ -452,6 +554,82 @@ int main(int argc, char* argv[])
 		if (ret) {
 			printf("Set PPS width = %ld ms\n", dwPpsWidth);
 		}
+	} else if (FUNCODE_mxIrigbGetPpsInput == controlMode) {
+		DWORD dwPort;
+
+		ret = mxIrigbGetPpsInput(hDev, &dwPort);
+		if (ret) {
+			printf("PPS input = %ld (%s)\n", dwPort,
+				(dwPort < PORT_UNKNOWN) ? strPortList[dwPort] : "Disabled");
+		}
+	} else if (FUNCODE_mxIrigbSetPpsInput == controlMode) {
+		DWORD dwPort = ( !p[0] ) ? PORT_1 : atoi(p[0]);
+
+		ret = mxIrigbSetPpsInput(hDev, dwPort);
+		if (ret) {
+			printf("Set PPS input = %ld\n", dwPort);
+		}
+	} else if (FUNCODE_mxIrigbGetPpsHoldTime == controlMode) {
+		DWORD dwHoldTime;
+
+		ret = mxIrigbGetPpsHoldTime(hDev, &dwHoldTime);
+		if (ret) {
+			printf("PPS hold time = %ld ms\n", dwHoldTime);
+		}
+	} else if (FUNCODE_mxIrigbSetPpsHoldTime == controlMode) {
+		DWORD dwHoldTime = ( !p[0] ) ? 0 : atoi(p[0]);
+
+		ret = mxIrigbSetPpsHoldTime(hDev, dwHoldTime);
+		if (ret) {
+			printf("Set PPS hold time = %ld ms\n", dwHoldTime);
+		}
+	} else if (FUNCODE_mxIrigbGetPpsTimeout == controlMode) {
+		DWORD dwTimeout;
+
+		ret = mxIrigbGetPpsTimeout(hDev, &dwTimeout);
+		if (ret) {
+			printf("PPS timeout = %ld ms\n", dwTimeout);
+		}
+	} else if (FUNCODE_mxIrigbSetPpsTimeout == controlMode) {
+		DWORD dwTimeout = ( !p[0] ) ? 1500 : atoi(p[0]);
+
+		ret = mxIrigbSetPpsTimeout(hDev, dwTimeout);
+		if (ret) {
+			printf("Set PPS timeout = %ld ms\n", dwTimeout);
+		}
+	} else if (FUNCODE_mxIrigbMeasureLoopback == controlMode) {
+		DWORD dwOutPort = ( !p[0] ) ? PORT_1 : atoi(p[0]);
+		DWORD dwInPort = ( !p[1] ) ? PORT_1 : atoi(p[1]);
+		DWORD dwRuns = ( !p[2] ) ? 1000 : atoi(p[2]);
+		IRIGB_LOOPBACK loopback;
+
+		ret = mxIrigbMeasureLoopback(hDev, dwOutPort, dwInPort, dwRuns, &loopback);
+		if (ret || loopback.failures) {
+			printf("Runs = %ld, Failures = %ld\n", loopback.runs, loopback.failures);
+		}
+		if (ret) {
+			printf("Round trip = %lld ns, Std. dev. = %lld ns, Min = %lld ns, Max = %lld ns\n",
+				loopback.mean, loopback.stddev, loopback.min, loopback.max);
+			printf("One way = %lld ns\n", loopback.mean / 2);
+		}
+	} else if (FUNCODE_mxIrigbGetOutputAdvance == controlMode) {
+		long lDelay[PORT_UNKNOWN] = { 0 };
+		long long llAdvance, llSpread;
+		DWORD dwPorts;
+
+		for (int i=PORT_1; i<=PORT_4; i++) {
+			lDelay[i] = ( !p[i-PORT_1] ) ? 0 : atol(p[i-PORT_1]);
+		}
+		ret = mxIrigbGetOutputAdvance(hDev, lDelay, &llAdvance, &llSpread, &dwPorts);
+		if (ret) {
+			printf("Encoder ports =");
+			for (int i=PORT_1; i<=PORT_4; i++) {
+				if (dwPorts & (1<<i)) {
+					printf(" %d", i);
+				}
+			}
+			printf("\nRTC advance = %lld ns, Largest port error = %lld ns\n", llAdvance, llSpread);
+		}
 	} else if (FUNCODE_mxIrigbGetInputSignalType == controlMode) {
 		DWORD dwPort = ( !p[0] ) ? PORT_1 : atoi(p[0]);
 		DWORD dwSignalType;
@@ -597,6 +775,161 @@ int main(int argc, char* argv[])
 		if (ret) {
 			printf("FPGA firmware build date = %08x\n", dwValue);
 		}
+	} else if (FUNCODE_mxIrigbGetLeapSecond == controlMode) {
+		LEAP_SECOND leap;
+
+		ret = mxIrigbGetLeapSecond( hDev, &leap);
+		if (ret && leap.enable) {
+			printf("Leap second = %s at the end of %d day %d %02d:%02d\n",
+				leap.ls ? "Delete" : "Insert", leap.year, leap.yday, leap.hour, leap.min);
+		} else if (ret) {
+			printf("Leap second = None\n");
+		}
+	} else if (FUNCODE_mxIrigbSetLeapSecond == controlMode) {
+		LEAP_SECOND leap;
+
+		leap.enable = ( !p[0] ) ? 0 : 1;
+		leap.year = ( !p[0] ) ? 0 : atoi(p[0]);
+		leap.yday = ( !p[1] ) ? 1 : atoi(p[1]);
+		leap.hour = ( !p[2] ) ? 23 : atoi(p[2]);
+		leap.min = ( !p[3] ) ? 59 : atoi(p[3]);
+		leap.ls = ( !p[4] ) ? 0 : atoi(p[4]);
+
+		ret = mxIrigbSetLeapSecond( hDev, &leap);
+		if (ret && leap.enable) {
+			printf("Set Leap second = %s at the end of %d day %d %02d:%02d\n",
+				leap.ls ? "Delete" : "Insert", leap.year, leap.yday, leap.hour, leap.min);
+		} else if (ret) {
+			printf("Cancel Leap second\n");
+		}
+	} else if (FUNCODE_mxIrigbGetDstWindow == controlMode) {
+		DST_WINDOW dst;
+
+		ret = mxIrigbGetDstWindow( hDev, &dst);
+		if (ret && dst.startYday) {
+			printf("DST = day %d %02d:00 ~ day %d %02d:00\n",
+				dst.startYday, dst.startHour, dst.endYday, dst.endHour);
+		} else if (ret) {
+			printf("DST = None\n");
+		}
+	} else if (FUNCODE_mxIrigbSetDstWindow == controlMode) {
+		DST_WINDOW dst;
+
+		dst.startYday = ( !p[0] ) ? 0 : atoi(p[0]);
+		dst.startHour = ( !p[1] ) ? 0 : atoi(p[1]);
+		dst.endYday = ( !p[2] ) ? 0 : atoi(p[2]);
+		dst.endHour = ( !p[3] ) ? 0 : atoi(p[3]);
+
+		ret = mxIrigbSetDstWindow( hDev, &dst);
+		if (ret && dst.startYday) {
+			printf("Set DST = day %d %02d:00 ~ day %d %02d:00\n",
+				dst.startYday, dst.startHour, dst.endYday, dst.endHour);
+		} else if (ret) {
+			printf("Clear DST\n");
+		}
+	} else if (FUNCODE_mxIrigbGetDecoderFrame == controlMode) {
+		DWORD dwSync = ( !p[0] ) ? TIMESRC_PORT1 : atoi(p[0]);
+		IRIGB_FRAME frame;
+
+		/* Only the two IRIG-B inputs have a decoder, check before strTimeSrc is indexed */
+		if (dwSync == TIMESRC_FIBER || dwSync == TIMESRC_PORT1) {
+			ret = mxIrigbGetDecoderFrame( hDev, dwSync, &frame);
+		} else {
+			ret = FALSE;
+		}
+		if (ret) {
+			printf("%s frame = %d day %d %02d:%02d:%02d, SBS = %d, Epoch = %lld\nTZ = %c%d%s",
+				strTimeSrc[dwSync], frame.year, frame.yday,
+				frame.hour, frame.min, frame.sec, frame.sbs, frame.epoch,
+				frame.tzs ? '-' : '+', frame.tz, frame.tzh ? ".5" : "");
+			printf(", TQ = %d, LSP = %d, LS = %d, DSP = %d, DST = %d, PAR = %d\n",
+				frame.tq, frame.lsp, frame.ls, frame.dsp, frame.dst, frame.par);
+			printf("Raw = %08lx %08lx %08lx %08lx, Counter = %lu, Elapsed = %lld ns\n",
+				frame.raw[0], frame.raw[1], frame.raw[2], frame.raw[3],
+				frame.count, frame.elapsed);
+		}
+	} else if (FUNCODE_mxIrigbGetDecoders == controlMode) {
+		IRIGB_DECODERS decoders;
+
+		ret = mxIrigbGetDecoders( hDev, &decoders);
+		if (ret) {
+			for (int i=0; i<2; i++) {
+				printf("%s status = %s, Elapsed = %lld ns, Frame = ",
+					strTimeSrc[i ? TIMESRC_PORT1 : TIMESRC_FIBER],
+					strSignalStatus[decoders.status[i]], decoders.frame[i].elapsed);
+				if (decoders.frameValid[i]) {
+					printf("%d day %d %02d:%02d:%02d, Epoch = %lld\n", decoders.frame[i].year,
+						decoders.frame[i].yday, decoders.frame[i].hour, decoders.frame[i].min,
+						decoders.frame[i].sec, decoders.frame[i].epoch);
+				} else {
+					printf("invalid\n");
+				}
+			}
+			if (decoders.frameValid[0] && decoders.frameValid[1]) {
+				printf("Port 1 - Fiber = %lld s", decoders.frame[1].epoch - decoders.frame[0].epoch);
+				if (decoders.frame[0].elapsed >= 0 && decoders.frame[1].elapsed >= 0) {
+					printf(" %+lld ns", decoders.frame[1].elapsed - decoders.frame[0].elapsed);
+				}
+				printf("\n");
+			}
+		}
+	} else if (FUNCODE_mxIrigbGetAllStatus == controlMode) {
+		const char *strBit[IRIGB_STATUS_BITS] = {
+			"Fiber off line", "Fiber frame error", "Fiber parity error", "Fiber done",
+			"Port 1 off line", "Port 1 frame error", "Port 1 parity error", "Port 1 done",
+			"PPS time out", "PPS done", "IRIG-B encoder done", "PPS encoder done"
+		};
+		int polls = ( !p[0] ) ? 1 : atoi(p[0]);
+		IRIGB_ALL_STATUS status;
+		IRIGB_STATUS_COUNTERS counters;
+
+		memset(&counters, 0, sizeof(counters));
+		for (int i=0; i<polls; i++) {
+			if (i) {
+#ifdef WIN32
+				Sleep(1000);
+#else
+				sleep(1);
+#endif
+			}
+			ret = mxIrigbGetAllStatus( hDev, &status, &counters);
+			if (!ret) {
+				break;
+			}
+		}
+		if (ret) {
+			printf("Status = %03lx, %s = %s, %s = %s\n", status.intsts,
+				strTimeSrc[TIMESRC_FIBER], strSignalStatus[status.signal[0]],
+				strTimeSrc[TIMESRC_PORT1], strSignalStatus[status.signal[1]]);
+			printf("Events in %lu polls:\n", counters.polls);
+			for (int i=0; i<IRIGB_STATUS_BITS; i++) {
+				printf("\t%s = %lu\n", strBit[i], counters.bit[i]);
+			}
+		}
+	} else if (FUNCODE_mxIrigbWaitEvent == controlMode) {
+		DWORD dwMask = ( !p[0] ) ? (1<<IRIGB_BIT_DE0_DONE) : strtoul(p[0], NULL, 0);
+		DWORD dwTimeout = ( !p[1] ) ? 2000 : strtoul(p[1], NULL, 0);
+		int count = ( !p[2] ) ? 1 : atoi(p[2]);
+		DWORD dwEvents;
+
+		for (int i=0; i<count; i++) {
+			ret = mxIrigbWaitEvent( hDev, dwMask, dwTimeout, &dwEvents);
+			if (!ret) {
+				break;
+			}
+#ifdef WIN32
+			SYSTEMTIME systime;
+
+			GetSystemTime(&systime);
+			printf("%02d:%02d:%02d.%03d Events = %03lx\n", systime.wHour, systime.wMinute,
+				systime.wSecond, systime.wMilliseconds, dwEvents);
+#else
+			struct timespec ts;
+
+			clock_gettime(CLOCK_REALTIME, &ts);
+			printf("%ld.%06ld Events = %03lx\n", (long)ts.tv_sec, ts.tv_nsec / 1000, dwEvents);
+#endif
+		}
 	}
 
 	mxIrigbClose(hDev);
@@ -1,6 +1,6 @@
 /*
  * IRIG-B time sync daemon.
- * Usage: ServiceSyncTime -t [signal type] -I -i [Time sync interval] -s [Time Source] -p [Parity check mode] -B
+ * Usage: ServiceSyncTime -t [signal type] -I -i [Time sync interval] -r [rate] -D [decimation] -P [phase] -s [Time Source] -p [Parity check mode] -a -B -u [socket path] -m [metrics port] -c [card] -F [config file] -R [priority] -A [cpu] -l [log level] -j [journal file] -J [records] -k [archive dir] -K [days] -T [accuracy] -L [TAI offset] -E [input delay] -O [output delays] -x [journal file or archive dir]
  *  -t - [signal type]
  *      0 - TTL
  *      1 - DIFF
@@ -8,14 +8,58 @@
  *  -I - inverse the input signal
  *  -s - [Time Source] The sync source from IRIG-B Port.
  *      2 - IRIG-B Port
+ *      4 - PPS on the IRIG-B Port, the seconds are taken from the system time
  *      default value is 2
+ *  -a - Switch automatically between the Fiber port and the IRIG-B port when the time source fails.
+ *      The -s time source is used first. Default is disabled.
  *  -i - [Time sync interval] The time interval in seconds to sync the IRIG-B time into system time.
  *      1 ~ 86400 Time sync interval. Default is 10 second.
+ *  -r - [rate] Sample the IRIG-B card this many times a second instead of once per time sync interval.
+ *      1 ~ 32, a divisor of 1000000000. Default is 0, once per time sync interval.
+ *  -D - [decimation] Average this many samples of -r into one system time update.
+ *      1 ~ 64. Default is 1, every sample updates the system time.
+ *  -P - [phase] Sample the IRIG-B card this many ms after the second of the system time.
+ *      0 ~ 900 The sample phase. Default is 100 ms.
  *  -p - [Parity check mode] Set the parity bit
  *       0: EVEN 
  *       1: ODD
  *       2: NONE
  *  -B - Run daemon in the background
+ *  -u - [socket path] The status and control socket. Default is /var/run/ServiceSyncTime.sock
+ *  -m - [port or socket path] Serve OpenMetrics on this TCP port or local socket. Default is disabled.
+ *  -c - [card] The IRIG-B cards to sync the time from.
+ *      n[,n...] - The card indexes. The first healthy card disciplines the system time, the others take over on failure.
+ *      all - All the installed cards
+ *      list - List the installed cards
+ *      default value is 0
+ *  -F - [config file] Read the settings from a file, they override the command line options.
+ *      The file is read again on SIGHUP or the "reload" command, only the changed settings are written to the card.
+ *  -R - [priority] Sample the cards in SCHED_FIFO threads of this priority and lock the daemon memory.
+ *      1 ~ 99 The real-time priority. Default is 0, the normal scheduling.
+ *  -A - [cpu] Run the card sampling threads on these CPUs only.
+ *      n[,n...] - The CPU numbers. Default is any CPU.
+ *  -l - [log level] Log the messages up to this syslog level, to syslog in the background, else to stderr.
+ *      3 (error) ~ 7 (debug). Default is 6 (info).
+ *  -j - [journal file] Record every sample in this binary ring file. Default is disabled.
+ *  -J - [records] The samples kept in the journal file, 40 bytes each.
+ *      60 ~ 100000000 The journal size. Default is 2592000, 30 days at one sample a second.
+ *  -k - [archive dir] Compress the journal into a long-term archive in this directory, needs -j. Default is disabled.
+ *  -K - [days] The days the raw samples and the minute aggregates are kept in the archive, the hour aggregates are kept forever.
+ *      raw[,minute] - 1 ~ 36500 days. Default is 31,366.
+ *  -T - [accuracy] Raise the alarm of a card when its offset leaves this limit or its time source fails.
+ *      T1 ~ T5 - The IEC 61850-5 class, 1 ms, 100 us, 25 us, 4 us or 1 us.
+ *      n - The limit in ns. Default is 0, no alarm.
+ *  -L - [TAI offset] TAI minus UTC in seconds, set in the kernel with the leap seconds announced by the reference.
+ *      0 ~ 1000 The offset, the kernel keeps it current after a leap second. Default is 0, keep the kernel offset.
+ *  -E - [input delay] The cable delay of the time source, added to the RTC time unless it runs free.
+ *      n - The delay in ns, 0 ~ 1000000. Default is 0.
+ *      Pn - Measure the delay at start, half the round trip of a loopback from output port n (1 ~ 4) to the input.
+ *  -O - [output delays] The cable delays of the output ports 1 ~ 4 sending the IRIG-B or PPS encoder signal.
+ *      n[,n...] - The delays in ns, -1000000 ~ 1000000. A free running RTC leads by the middle of them,
+ *      the system time follows it that much behind. Default is 0.
+ *  -x - [journal file or archive dir] [tier] [from] [to] Print the samples of a journal file, or of an archive
+ *      between the seconds since the Epoch from and to, as CSV and exit, the only option.
+ *      tier - raw, minute or hour. Default is raw.
  *
  *	Usage example: Enable to sync time from IRIG-B Port 1 in TTL signal type every 10 seconds. The input signal is not inverse.
  *	root@Moxa:~#  ServiceSyncTime -t 0 -s 2 -i 10
@@ -23,6 +67,8 @@
  *	root@Moxa:~#  ServiceSyncTime -t 1 -s 2 -i 10
  *	Usage example: Enable to sync time from Fiber PORT 1 in TTL signal type every 10 seconds. The input signal is inverse.
  *	root@Moxa:~#  ServiceSyncTime -t 1 -s 1 -i 10 -I 1
+ *	Usage example: Sync time from the IRIG-B Port 1 of every installed card, card 0 first.
+ *	root@Moxa:~#  ServiceSyncTime -t 1 -s 2 -i 10 -c all
  *
  * History:
  * Date		Author			Comment
@@ -41,15 +87,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <time.h>
 #include <sys/select.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <signal.h>
+#include <sched.h>
 
 #include "../mxirig/Public.h"
 #include "../mxirig/mxirig.h"
+#include "SyncState.h"
+#include "SyncDevice.h"
+#include "SyncIpc.h"
+#include "SyncMetrics.h"
+#include "SyncConfig.h"
+#include "SyncLog.h"
+#include "SyncArchive.h"
+#include "SyncQuality.h"
 
 #ifdef __ENABLE_OUTPUT_FEATURE__
 #define DEFAULT_OUTPUT_PORT		2
@@ -61,8 +118,6 @@
 
 #define DEFAULT_TIME_SOURCE		2
 #define DEFAULT_INTERFACE_TYPE		1
-#define MIN_TIME_SYNC_INTERVAL		1	/* 1 second */
-#define MAX_TIME_SYNC_INTERVAL		86400	/* 1 day */
 #define DEFAULT_DISABLE_TIME_SYNC	0
 #define DEFAULT_PARITY			0	/* EVEN PARITY */
 #define DEFAULT_TIME_SYNC_INTERVAL	10
@@ -70,11 +125,24 @@
 
 /* Used to control the daemon running. 0 for running, else for running */
 int bStopping = 0;
+/* Set by SIGHUP to read the configuration file again */
+volatile sig_atomic_t bReload = 0;
+
+/* The configuration file, NULL without -F */
+static const char *config_path = NULL;
+/* The settings from the command line, the configuration file overrides them */
+static SYNC_CONFIG cmdline_config;
+/* The settings in effect */
+static SYNC_CONFIG running_config;
+/* The settings written to each card of state.device, a failed reload keeps the previous ones to retry them */
+static SYNC_CONFIG applied_card[SYNC_MAX_DEVICES];
+
+#define CONFIG_CHANGED(old, cfg, field)		((old) == NULL || (old)->field != (cfg)->field)
 
 void usage(char *name) {
 
 	printf("IRIG-B time sync daemon.\n");
-	printf("Usage: ServiceSyncTime -t [signal type] -I -i [Time sync interval] -s [Time Source] -p [Parity check mode] -B\n");
+	printf("Usage: ServiceSyncTime -t [signal type] -I -i [Time sync interval] -r [rate] -D [decimation] -P [phase] -s [Time Source] -p [Parity check mode] -a -B -u [socket path] -m [metrics port] -c [card] -F [config file] -R [priority] -A [cpu] -l [log level] -j [journal file] -J [records] -k [archive dir] -K [days] -T [accuracy] -L [TAI offset] -E [input delay] -O [output delays] -x [journal file or archive dir]\n");
 #ifdef __ENABLE_OUTPUT_FEATURE__
 	printf("-o [port to output] -f [from port] -w [PPS width]\n");
 #endif  /* end of __ENABLE_OUTPUT_FEATURE__ */
@@ -110,9 +178,18 @@ void usage(char *name) {
 	printf("       0 - FREERUN(Internal RTC) module\n");
 	printf("       1 - Fiber port\n");
 	printf("       2 - IRIG-B port\n");
+	printf("       4 - PPS on the IRIG-B port, the seconds are taken from the system time\n");
 	printf("       default value is %d\n", DEFAULT_TIME_SOURCE);
+	printf("   -a - Switch automatically between the Fiber port and the IRIG-B port when the time source fails.\n");
+	printf("       The -s time source is used first. default is disabled\n");
 	printf("   -i - [Time sync interval] The time interval in seconds to sync the IRIG-B time into system time.\n");
 	printf("       %d ~ %d Time sync interval. Default is %d second.\n", MIN_TIME_SYNC_INTERVAL, MAX_TIME_SYNC_INTERVAL, DEFAULT_TIME_SYNC_INTERVAL);
+	printf("   -r - [rate] Sample the IRIG-B card this many times a second instead of once per time sync interval.\n");
+	printf("       1 ~ %d, a divisor of 1000000000. Default is 0, once per time sync interval.\n", MAX_SAMPLE_RATE);
+	printf("   -D - [decimation] Average this many samples of -r into one system time update.\n");
+	printf("       1 ~ %d. Default is 1, every sample updates the system time.\n", MAX_DECIMATION);
+	printf("   -P - [phase] Sample the IRIG-B card this many ms after the second of the system time.\n");
+	printf("       %d ~ %d The sample phase. Default is %d ms.\n", MIN_SAMPLE_PHASE, MAX_SAMPLE_PHASE, DEFAULT_SAMPLE_PHASE);
 	printf("   -p - [Parity check mode] Set the parity bit\n");
 	printf("       0: EVEN\n");
 	printf("       1: ODD\n");
@@ -122,6 +199,41 @@ void usage(char *name) {
 #endif
 	printf("       default value is %d\n", DEFAULT_PARITY);
 	printf("   -B - Run daemon in the background\n");
+	printf("   -u - [socket path] The status and control socket.\n");
+	printf("       default value is %s\n", SYNCIPC_SOCKET_PATH);
+	printf("   -m - [port or socket path] Serve the OpenMetrics (Prometheus) text on a TCP port or a local socket.\n");
+	printf("       default is disabled\n");
+	printf("   -c - [card] The IRIG-B cards to sync the time from\n");
+	printf("       n[,n...] - The card indexes, the first healthy one disciplines the system time\n");
+	printf("       all - All the installed cards\n");
+	printf("       list - List the installed cards\n");
+	printf("       default value is 0\n");
+	printf("   -F - [config file] Read the settings from a file, they override the command line options.\n");
+	printf("       The file is read again on SIGHUP, e.g. %s\n", SYNC_CONFIG_PATH);
+	printf("   -R - [priority] Sample the cards in SCHED_FIFO threads of this priority and lock the daemon memory.\n");
+	printf("       1 ~ 99 The real-time priority. default is 0, the normal scheduling\n");
+	printf("   -A - [cpu] Run the card sampling threads on these CPUs only\n");
+	printf("       n[,n...] - The CPU numbers. default is any CPU\n");
+	printf("   -l - [log level] Log the messages up to this syslog level, to syslog with -B, else to stderr\n");
+	printf("       %d (error) ~ %d (debug). default is %d (info)\n", LOG_ERR, LOG_DEBUG, DEFAULT_LOG_LEVEL);
+	printf("   -j - [journal file] Record every sample in this binary ring file. default is disabled\n");
+	printf("   -J - [records] The samples kept in the journal file, 40 bytes each\n");
+	printf("       %d ~ %d The journal size. default is %d, 30 days at one sample a second\n", MIN_JOURNAL_RECORDS, MAX_JOURNAL_RECORDS, DEFAULT_JOURNAL_RECORDS);
+	printf("   -k - [archive dir] Compress the journal into a long-term archive in this directory, needs -j. default is disabled\n");
+	printf("   -K - [days] The days the raw samples and the minute aggregates are kept in the archive\n");
+	printf("       raw[,minute] - %d ~ %d days. default is %d,%d, the hour aggregates are kept forever\n", 1, MAX_ARCHIVE_DAYS, DEFAULT_ARCHIVE_RAW_DAYS, DEFAULT_ARCHIVE_MINUTE_DAYS);
+	printf("   -T - [accuracy] Raise the alarm of a card when its offset leaves this limit or its time source fails\n");
+	printf("       T1 ~ T5 - The IEC 61850-5 class, 1 ms, 100 us, 25 us, 4 us or 1 us\n");
+	printf("       n - The limit in ns. default is 0, no alarm\n");
+	printf("   -L - [TAI offset] TAI minus UTC in seconds, set in the kernel with the leap seconds announced by the reference\n");
+	printf("       0 ~ %d The offset, the kernel keeps it current after a leap second. default is 0, keep the kernel offset\n", MAX_TAI_OFFSET);
+	printf("   -E - [input delay] The cable delay of the time source, added to the RTC time unless it runs free\n");
+	printf("       n - The delay in ns, 0 ~ %d. default is 0\n", MAX_INPUT_DELAY);
+	printf("       Pn - Measure the delay at start, half the round trip of a loopback from output port n (1 ~ 4) to the input\n");
+	printf("   -O - [output delays] The cable delays of the output ports 1 ~ 4 sending the IRIG-B or PPS encoder signal\n");
+	printf("       n[,n...] - The delays in ns, %d ~ %d. A free running RTC leads by the middle of them, default is 0\n", -MAX_OUTPUT_DELAY, MAX_OUTPUT_DELAY);
+	printf("   -x - [journal file or archive dir] [tier] [from] [to] Print the samples as CSV and exit, the only option\n");
+	printf("       tier - raw, minute or hour of an archive between the seconds since the Epoch from and to. default is raw\n");
 
 #ifdef __ENABLE_OUTPUT_FEATURE__
 	printf("Usage example: Enable to sync time from IRIG-B Port 1, in TTL signal type every 10 seconds, and enable to output IRIG-B signal from the IRIG-B encoder. The input and output signals are not inverse.\n");
@@ -135,7 +247,7 @@ void usage(char *name) {
 void usage_DA_IRIGB_4DIO_PCI104(char *name) {
 
 	printf("IRIG-B time sync daemon.\n");
-	printf("Usage: ServiceSyncTime -t [signal type] -I -d -i [Time sync interval] -p [Parity check mode] -B\n");
+	printf("Usage: ServiceSyncTime -t [signal type] -I -d -i [Time sync interval] -r [rate] -D [decimation] -P [phase] -p [Parity check mode] -a -B -u [socket path] -m [metrics port] -c [card] -F [config file] -R [priority] -A [cpu] -l [log level] -j [journal file] -J [records] -k [archive dir] -K [days] -T [accuracy] -L [TAI offset] -E [input delay] -O [output delays] -x [journal file or archive dir]\n");
 #ifdef __ENABLE_OUTPUT_FEATURE__
 	printf("-s [Time Source] -o [port to output] -f [from port] -w [PPS width]\n");
 #endif  /* end of __ENABLE_OUTPUT_FEATURE__ */
@@ -160,8 +272,16 @@ void usage_DA_IRIGB_4DIO_PCI104(char *name) {
 	printf("       Default this daemon enables the IRIG-B time sync from source port to system time.\n");
 #endif  /* end of __ENABLE_OUTPUT_FEATURE__ */
 	printf("   -I - inverse the input or output signal\n");
+	printf("   -a - Switch automatically between the Fiber port and the IRIG-B port when the time source fails.\n");
+	printf("       Unavailable on DA-IRIGB-4DIO-PCI104. default is disabled\n");
 	printf("   -i - [Time sync interval] The time interval in seconds to sync the IRIG-B time into system time.\n");
 	printf("       %d ~ %d Time sync interval. Default is %d second.\n", MIN_TIME_SYNC_INTERVAL, MAX_TIME_SYNC_INTERVAL, DEFAULT_TIME_SYNC_INTERVAL);
+	printf("   -r - [rate] Sample the IRIG-B card this many times a second instead of once per time sync interval.\n");
+	printf("       1 ~ %d, a divisor of 1000000000. Default is 0, once per time sync interval.\n", MAX_SAMPLE_RATE);
+	printf("   -D - [decimation] Average this many samples of -r into one system time update.\n");
+	printf("       1 ~ %d. Default is 1, every sample updates the system time.\n", MAX_DECIMATION);
+	printf("   -P - [phase] Sample the IRIG-B card this many ms after the second of the system time.\n");
+	printf("       %d ~ %d The sample phase. Default is %d ms.\n", MIN_SAMPLE_PHASE, MAX_SAMPLE_PHASE, DEFAULT_SAMPLE_PHASE);
 	printf("   -p - [Parity check mode] Set the parity bit\n");
 	printf("       0: EVEN\n");
 	printf("       1: ODD\n");
@@ -171,6 +291,41 @@ void usage_DA_IRIGB_4DIO_PCI104(char *name) {
 #endif
 	printf("       default value is %d\n", DEFAULT_PARITY);
 	printf("   -B - Run daemon in the background\n");
+	printf("   -u - [socket path] The status and control socket.\n");
+	printf("       default value is %s\n", SYNCIPC_SOCKET_PATH);
+	printf("   -m - [port or socket path] Serve the OpenMetrics (Prometheus) text on a TCP port or a local socket.\n");
+	printf("       default is disabled\n");
+	printf("   -c - [card] The IRIG-B cards to sync the time from\n");
+	printf("       n[,n...] - The card indexes, the first healthy one disciplines the system time\n");
+	printf("       all - All the installed cards\n");
+	printf("       list - List the installed cards\n");
+	printf("       default value is 0\n");
+	printf("   -F - [config file] Read the settings from a file, they override the command line options.\n");
+	printf("       The file is read again on SIGHUP, e.g. %s\n", SYNC_CONFIG_PATH);
+	printf("   -R - [priority] Sample the cards in SCHED_FIFO threads of this priority and lock the daemon memory.\n");
+	printf("       1 ~ 99 The real-time priority. default is 0, the normal scheduling\n");
+	printf("   -A - [cpu] Run the card sampling threads on these CPUs only\n");
+	printf("       n[,n...] - The CPU numbers. default is any CPU\n");
+	printf("   -l - [log level] Log the messages up to this syslog level, to syslog with -B, else to stderr\n");
+	printf("       %d (error) ~ %d (debug). default is %d (info)\n", LOG_ERR, LOG_DEBUG, DEFAULT_LOG_LEVEL);
+	printf("   -j - [journal file] Record every sample in this binary ring file. default is disabled\n");
+	printf("   -J - [records] The samples kept in the journal file, 40 bytes each\n");
+	printf("       %d ~ %d The journal size. default is %d, 30 days at one sample a second\n", MIN_JOURNAL_RECORDS, MAX_JOURNAL_RECORDS, DEFAULT_JOURNAL_RECORDS);
+	printf("   -k - [archive dir] Compress the journal into a long-term archive in this directory, needs -j. default is disabled\n");
+	printf("   -K - [days] The days the raw samples and the minute aggregates are kept in the archive\n");
+	printf("       raw[,minute] - %d ~ %d days. default is %d,%d, the hour aggregates are kept forever\n", 1, MAX_ARCHIVE_DAYS, DEFAULT_ARCHIVE_RAW_DAYS, DEFAULT_ARCHIVE_MINUTE_DAYS);
+	printf("   -T - [accuracy] Raise the alarm of a card when its offset leaves this limit or its time source fails\n");
+	printf("       T1 ~ T5 - The IEC 61850-5 class, 1 ms, 100 us, 25 us, 4 us or 1 us\n");
+	printf("       n - The limit in ns. default is 0, no alarm\n");
+	printf("   -L - [TAI offset] TAI minus UTC in seconds, set in the kernel with the leap seconds announced by the reference\n");
+	printf("       0 ~ %d The offset, the kernel keeps it current after a leap second. default is 0, keep the kernel offset\n", MAX_TAI_OFFSET);
+	printf("   -E - [input delay] The cable delay of the time source, added to the RTC time unless it runs free\n");
+	printf("       n - The delay in ns, 0 ~ %d. default is 0\n", MAX_INPUT_DELAY);
+	printf("       Pn - Measure the delay at start, half the round trip of a loopback from output port n (1 ~ 4) to the input\n");
+	printf("   -O - [output delays] The cable delays of the output ports 1 ~ 4 sending the IRIG-B or PPS encoder signal\n");
+	printf("       n[,n...] - The delays in ns, %d ~ %d. A free running RTC leads by the middle of them, default is 0\n", -MAX_OUTPUT_DELAY, MAX_OUTPUT_DELAY);
+	printf("   -x - [journal file or archive dir] [tier] [from] [to] Print the samples as CSV and exit, the only option\n");
+	printf("       tier - raw, minute or hour of an archive between the seconds since the Epoch from and to. default is raw\n");
 
 #ifdef __ENABLE_OUTPUT_FEATURE__
 	printf("Usage example: Enable to sync time from IRIG-B Port 1, in TTL signal type every 10 seconds, and enable to output IRIG-B signal from the IRIG-B encoder. The input and output signals are not inverse.\n");
@@ -217,12 +372,358 @@ void sig_handler_for_stopping_process(int sig) {
 	remove_pid_file(PIDFILE);
 }
 
+void sig_handler_for_reload(int sig) {
+
+	(void)sig;
+	bReload = 1;
+}
+
+
+/* Print the installed IRIG-B cards */
+void list_cards(void) {
+	HANDLE hDev;
+	DWORD dwHWID;
+	int i, count = mxIrigbGetDeviceCount();
+
+	printf("%d IRIG-B card(s) found\n", count);
+	for ( i = 0; i < count; i++ ) {
+		hDev = mxIrigbOpen(i);
+		if ( hDev < 0 )
+			continue;
+		if ( mxIrigbGetHardwareID(hDev, &dwHWID) )
+			printf("Card %d: Hardware ID = %lu\n", i, dwHWID);
+		else
+			printf("Card %d: Get Hardware ID error: %d\n", i, GetLastError());
+		mxIrigbClose(hDev);
+	}
+}
+
+/* Parse the -c argument, "all" or a comma separated list of card indexes */
+int parse_cards(char *arg, int *cards) {
+	int count = mxIrigbGetDeviceCount();
+	int n = 0, i;
+	char *tok;
+
+	if ( strcmp(arg, "all") == 0 ) {
+		for ( n = 0; n < count; n++ )
+			cards[n] = n;
+		return n;
+	}
+
+	for ( tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ",") ) {
+		cards[n] = atoi(tok);
+		if ( cards[n] < 0 || cards[n] >= count ) {
+			printf("Invalid c:%s, %d IRIG-B card(s) found\n", tok, count);
+			return -1;
+		}
+		for ( i = 0; i < n; i++ ) {
+			if ( cards[i] == cards[n] )
+				break;
+		}
+		if ( i == n && ++n >= SYNC_MAX_DEVICES )
+			break;
+	}
+
+	return n;
+}
+
+/* Parse the -A argument, a comma separated list of CPU numbers */
+int parse_cpus(char *arg, cpu_set_t *cpus) {
+	long count = sysconf(_SC_NPROCESSORS_CONF);
+	int cpu;
+	char *tok;
+
+	CPU_ZERO(cpus);
+	for ( tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ",") ) {
+		cpu = atoi(tok);
+		if ( cpu < 0 || cpu >= count || cpu >= CPU_SETSIZE ) {
+			printf("Invalid A:%s, %ld CPU(s) found\n", tok, count);
+			return -1;
+		}
+		CPU_SET(cpu, cpus);
+	}
+
+	return CPU_COUNT(cpus);
+}
+
+/* The -x arguments, a journal file, or an archive directory with [tier] [from] [to] in seconds since the Epoch */
+int dump_records(int argc, char *argv[]) {
+	long long from = 0, to = LLONG_MAX / 1000000 - 1;
+	int tier = ARCHIVE_RAW;
+	struct stat st;
+
+	if ( stat(argv[2], &st) < 0 || !S_ISDIR(st.st_mode) )
+		return sync_journal_dump(argv[2], stdout) < 0 ? 1 : 0;
+
+	if ( argc > 3 && (tier = sync_archive_tier(argv[3])) < 0 ) {
+		printf("Invalid tier %s is not raw, minute or hour\n", argv[3]);
+		return 1;
+	}
+	if ( argc > 4 )
+		from = atoll(argv[4]);
+	if ( argc > 5 )
+		to = atoll(argv[5]);
+
+	return sync_archive_dump(argv[2], tier, from * 1000000, to * 1000000 + 999999, stdout) < 0 ? 1 : 0;
+}
+
+/* Configure the time source and the signal of a card.
+ * Without the old configuration every register is written, else only the changed ones. */
+BOOL setup_card(HANDLE irigbCardHandle, SYNC_CONFIG *old, SYNC_CONFIG *cfg) {
+	BOOL src_changed = CONFIG_CHANGED(old, cfg, time_source);
+	BOOL type_changed = CONFIG_CHANGED(old, cfg, signal_type) || CONFIG_CHANGED(old, cfg, inverse);
+	BOOL parity_changed = CONFIG_CHANGED(old, cfg, parity_mode);
+
+	/* Set sync time source */
+	if ( old == NULL && !mxIrigbSetSyncTimeSrc(irigbCardHandle, cfg->time_source) ) {
+		printf("Set sync source fail\n");
+		return FALSE;
+	}
+
+	/* The PPS decoder takes the input of a port, set as for its IRIG-B decoder */
+	if ( cfg->time_source == TIMESRC_PPS ) {
+		if ( src_changed || type_changed || CONFIG_CHANGED(old, cfg, time_source_interface) ) {
+			sync_log(LOG_INFO, "Set PPS input PORT(%d) signal type: %d, inverse:%d", cfg->time_source_interface, cfg->signal_type, cfg->inverse);
+			if(!mxIrigbSetInputSignalType(irigbCardHandle, cfg->time_source_interface, cfg->signal_type, cfg->inverse) ||
+				!mxIrigbSetPpsInput(irigbCardHandle, cfg->time_source_interface)) {
+				sync_log(LOG_ERR, "mxIrigbSetPpsInput() fail");
+				return FALSE;
+			}
+		}
+		if ( cfg->pps_hold && CONFIG_CHANGED(old, cfg, pps_hold) ) {
+			sync_log(LOG_INFO, "Set PPS hold time: {%d} ms", cfg->pps_hold);
+			if(!mxIrigbSetPpsHoldTime(irigbCardHandle, cfg->pps_hold)) {
+				sync_log(LOG_ERR, "mxIrigbSetPpsHoldTime() pps_hold:%d fail", cfg->pps_hold);
+				return FALSE;
+			}
+		}
+		if ( cfg->pps_timeout && CONFIG_CHANGED(old, cfg, pps_timeout) ) {
+			sync_log(LOG_INFO, "Set PPS timeout: {%d} ms", cfg->pps_timeout);
+			if(!mxIrigbSetPpsTimeout(irigbCardHandle, cfg->pps_timeout)) {
+				sync_log(LOG_ERR, "mxIrigbSetPpsTimeout() pps_timeout:%d fail", cfg->pps_timeout);
+				return FALSE;
+			}
+		}
+	}
+
+	/* Only Fiber port and IRIG-B port1 need to set time interface */
+	if ( cfg->time_source == 1 || cfg->time_source == 2 ) {
+
+		if ( src_changed || type_changed ) {
+			/* Configure IRIG-B input interface and type. */ 
+			sync_log(LOG_INFO, "Set PORT(%d) time_source_interface: %d signal type: %d, inverse:%d", cfg->time_source, cfg->time_source_interface, cfg->signal_type, cfg->inverse);
+
+			/* Set the interface type for Fiber port and IRIG-B port 1 */
+			if(!mxIrigbSetInputSignalType(irigbCardHandle, cfg->time_source_interface, cfg->signal_type, cfg->inverse)) {
+				sync_log(LOG_ERR, "mxIrigbSetSignalType() fail");
+				return FALSE;
+			}
+		}
+
+		if ( src_changed || parity_changed ) {
+			/* Configure the IRIG-B input parity mode */
+			sync_log(LOG_INFO, "Set input interface %d parity %d", cfg->time_source, cfg->parity_mode);
+			if (!mxIrigbSetInputParityCheckMode(irigbCardHandle, cfg->time_source, cfg->parity_mode)) {
+				sync_log(LOG_ERR, "mxIrigbSetInputParityCheckMode fail");
+				return FALSE;
+			}
+		}
+
+		/* The failover needs the other decoder too, the Fiber port only accepts TTL */
+		if ( cfg->failover && (src_changed || type_changed || parity_changed || CONFIG_CHANGED(old, cfg, failover)) ) {
+			int other = (cfg->time_source == TIMESRC_FIBER) ? TIMESRC_PORT1 : TIMESRC_FIBER;
+
+			sync_log(LOG_INFO, "Set failover PORT(%d) signal type: %d, inverse:%d, parity %d", other, (other == TIMESRC_FIBER) ? TYPE_TTL : cfg->signal_type, cfg->inverse, cfg->parity_mode);
+			if(!mxIrigbSetInputSignalType(irigbCardHandle, (other == TIMESRC_FIBER) ? PORT_FIBER : PORT_1,
+				(other == TIMESRC_FIBER) ? TYPE_TTL : cfg->signal_type, cfg->inverse)) {
+				sync_log(LOG_ERR, "mxIrigbSetSignalType() fail");
+				return FALSE;
+			}
+			if (!mxIrigbSetInputParityCheckMode(irigbCardHandle, other, cfg->parity_mode)) {
+				sync_log(LOG_ERR, "mxIrigbSetInputParityCheckMode fail");
+				return FALSE;
+			}
+		}
+	}
+
+#ifdef __ENABLE_OUTPUT_FEATURE__
+	if ( type_changed || CONFIG_CHANGED(old, cfg, port_to_output) || CONFIG_CHANGED(old, cfg, from_port) ) {
+		/* Configure IRIG-B output port and its input time source */
+		sync_log(LOG_INFO, "Set IRIG-B output port:%d, signal type:%d, from_port:%d, inverse:%d", cfg->port_to_output, cfg->signal_type, cfg->from_port, cfg->inverse);
+		if( ! mxIrigbSetOutputInterface(irigbCardHandle, cfg->port_to_output, cfg->signal_type, cfg->from_port, cfg->inverse) ) {
+			sync_log(LOG_ERR, "mxIrigbSetOutputInterface(): fail");
+			return FALSE;
+		}
+	}
+
+	if ( parity_changed ) {
+		/* Configure the IRIG-B output parity mode */
+		sync_log(LOG_INFO, "Set IRIG-B output parity %d",  cfg->parity_mode);
+		if ( cfg->parity_mode == 2 )  {
+			printf("The parity(NONE) is unavailable in output mode.\n");
+		}
+		else {
+			if (!mxIrigbSetOutputParityCheckMode(irigbCardHandle, cfg->parity_mode) ) {
+				sync_log(LOG_ERR, "mxIrigbSetOutputParityCheckMode(): fail");
+				return FALSE;
+			}
+		}
+	}
+
+	/* For DA-682A DA-IRIGB-4DIO-PCI104, DA-820 IRIG-B module */
+	if( cfg->pps_width && CONFIG_CHANGED(old, cfg, pps_width) ) {
+		sync_log(LOG_INFO, "Set PPS Width: {%d} ms", cfg->pps_width);
+		if(!mxIrigbSetPpsWidth(irigbCardHandle, cfg->pps_width)) {
+			sync_log(LOG_ERR, "mxIrigbSetPpsWidth() pps_width:%d fail", cfg->pps_width);
+			return FALSE;
+		}
+	}
+#endif  /* end of __ENABLE_OUTPUT_FEATURE__ */
+
+	if ( src_changed ) {
+		/* Sync Time Source */
+		sync_log(LOG_INFO, "Sync Time Source = {%d}", cfg->time_source);
+		if(!mxIrigbSetSyncTimeSrc(irigbCardHandle, cfg->time_source)) {
+			sync_log(LOG_ERR, "mxIrigbSetSyncTimeSrc() time_source:%d fail", cfg->time_source);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* The configuration of a card, DA-IRIGB-4DIO-PCI104 has the IRIG-B port only */
+void card_config(SYNC_CONFIG *card, SYNC_CONFIG *cfg, DWORD dwHWID) {
+
+	*card = *cfg;
+	card->failover = cfg->failover && dwHWID != DA_IRIGB_4DIO_PCI104;
+}
+
+/* The cable delay of the time source of a card in ns at start, measured in a loopback if configured.
+ * The loopback takes the input of the time source, set up by "setup_card" function, before the
+ * card is sampled. */
+long long card_input_delay(HANDLE irigbCardHandle, int index, SYNC_CONFIG *cfg) {
+	if ( cfg->loopback_port == 0 || cfg->time_source == TIMESRC_FREERUN )
+		return cfg->input_delay;
+
+	return sync_device_loopback(irigbCardHandle, index, cfg->loopback_port, cfg->time_source_interface, cfg->input_delay);
+}
+
+/* The advance of a free running RTC compensating the cable delays of the encoder outputs of a card in ns.
+ * The ports share the encoder, an input sets the phase of the RTC. */
+long long card_output_advance(HANDLE irigbCardHandle, int index, SYNC_CONFIG *cfg) {
+	long delay[PORT_UNKNOWN] = { 0 };
+	long long advance, spread;
+	DWORD ports;
+	int i, any = 0;
+
+	for ( i = 0; i < SYNC_OUTPUT_PORTS; i++ ) {
+		delay[PORT_1 + i] = cfg->output_delay[i];
+		any |= cfg->output_delay[i] != 0;
+	}
+	if ( !any )
+		return 0;
+
+	if ( !mxIrigbGetOutputAdvance(irigbCardHandle, delay, &advance, &spread, &ports) ) {
+		sync_log(LOG_ERR, "Card %d: mxIrigbGetOutputAdvance() fail", index);
+		return 0;
+	}
+	if ( cfg->time_source != TIMESRC_FREERUN ) {
+		if ( advance )
+			sync_log(LOG_WARNING, "Card %d: the RTC follows time source %d, the output advance %lld ns is not applied",
+				index, cfg->time_source, advance);
+		return 0;
+	}
+
+	sync_log(LOG_NOTICE, "Card %d: the RTC leads by %lld ns for the output ports 0x%lx, every port within %lld ns",
+		index, advance, ports, spread);
+	return advance;
+}
+
+/* Read the configuration file again and apply the changed settings.
+ * The servo, the frequency estimate and the statistics are kept. A card failing the
+ * setup keeps its previous settings, the next reload writes the changes again. */
+int reload_config(SYNC_STATE *state) {
+	SYNC_CONFIG cfg = cmdline_config, old_card, new_card;
+	BOOL failed[SYNC_MAX_DEVICES] = { FALSE };
+	SYNC_DEVICE *dev;
+	long long input_delay;
+	BOOL loopback;
+	int i, ret = 0;
+
+	if ( config_path == NULL )
+		return -1;
+
+	sync_log(LOG_NOTICE, "Reload %s", config_path);
+	if ( sync_config_load(config_path, &cfg) < 0 )
+		return -1;
+
+	pthread_mutex_lock(&state->lock);
+	for ( i = 0; i < state->device_count; i++ ) {
+		dev = &state->device[i];
+		old_card = applied_card[i];
+		card_config(&new_card, &cfg, dev->hwid);
+
+		if ( !setup_card(dev->hDev, &old_card, &new_card) ) {
+			sync_log(LOG_ERR, "Card %d is not reconfigured, the next reload tries again", dev->index);
+			failed[i] = TRUE;
+			ret = -1;
+			continue;
+		}
+
+		if ( CONFIG_CHANGED(&old_card, &new_card, time_source) || CONFIG_CHANGED(&old_card, &new_card, failover) )
+			sync_device_set_source(state, dev, new_card.time_source, new_card.failover);
+	}
+	pthread_mutex_unlock(&state->lock);
+
+	/* A loopback takes about a second, the sampling thread of the card runs it instead of its samples.
+	 * The output modes may have changed meanwhile, the output advance is read again. */
+	for ( i = 0; i < state->device_count; i++ ) {
+		if ( failed[i] )
+			continue;
+		dev = &state->device[i];
+		old_card = applied_card[i];
+		card_config(&new_card, &cfg, dev->hwid);
+
+		input_delay = -1;
+		loopback = FALSE;
+		if ( CONFIG_CHANGED(&old_card, &new_card, input_delay) || CONFIG_CHANGED(&old_card, &new_card, loopback_port) ||
+		     (new_card.loopback_port && (CONFIG_CHANGED(&old_card, &new_card, time_source_interface) ||
+			CONFIG_CHANGED(&old_card, &new_card, time_source) || CONFIG_CHANGED(&old_card, &new_card, signal_type) ||
+			CONFIG_CHANGED(&old_card, &new_card, inverse))) ) {
+			loopback = new_card.loopback_port && new_card.time_source != TIMESRC_FREERUN;
+			if ( !loopback )
+				input_delay = new_card.input_delay;
+		}
+		sync_device_set_delay(state, dev, input_delay, card_output_advance(dev->hDev, dev->index, &new_card));
+		if ( loopback )
+			sync_device_request_loopback(state, dev, new_card.loopback_port, new_card.time_source_interface,
+				new_card.input_delay);
+		applied_card[i] = new_card;
+	}
+
+	if ( cfg.interval != running_config.interval )
+		sync_state_set_interval(state, cfg.interval);
+	if ( cfg.phase != running_config.phase )
+		sync_state_set_phase(state, cfg.phase);
+	if ( cfg.rate != running_config.rate || cfg.decimation != running_config.decimation )
+		sync_state_set_rate(state, cfg.rate, cfg.decimation);
+	if ( cfg.accuracy != running_config.accuracy )
+		sync_state_set_accuracy(state, cfg.accuracy);
+	if ( cfg.tai_offset != running_config.tai_offset && sync_state_set_tai(state, cfg.tai_offset) < 0 )
+		sync_log(LOG_WARNING, "The TAI offset %d s is not set", cfg.tai_offset);
+
+	running_config = cfg;
+
+	return ret;
+}
+
 extern int optind, opterr, optopt; 
 extern char *optarg;
 
 int main(int argc, char *argv[])
 {
-	int i, remove_files_signal_list[] = {SIGHUP, SIGINT, SIGQUIT, SIGILL, SIGABRT, SIGFPE, SIGKILL, SIGSEGV, SIGPIPE, SIGALRM, SIGTERM, SIGUSR1, SIGUSR2};
+	int i, remove_files_signal_list[] = {SIGINT, SIGQUIT, SIGILL, SIGABRT, SIGFPE, SIGKILL, SIGSEGV, SIGPIPE, SIGALRM, SIGTERM, SIGUSR1, SIGUSR2};
 	HANDLE irigbCardHandle;
 	DWORD dwHWID;
 	long time_sync_interval = DEFAULT_TIME_SYNC_INTERVAL;
@@ -239,18 +740,50 @@ int main(int argc, char *argv[])
 	int time_source_interface = 1;	/* IRIG-B Port 1, IRIG-B decoded 1 */
 	int parity_mode = DEFAULT_PARITY;
 	int be_a_Daemon = 0;
+	int failover = 0;
+	long long accuracy = 0;
+	int tai_offset = 0;
+	int input_delay = 0;
+	int loopback_port = 0;
+	int output_delay[SYNC_OUTPUT_PORTS] = { 0 };
+	int rt_priority = 0;
+	int sample_phase = DEFAULT_SAMPLE_PHASE;
+	int sample_rate = 0;
+	int log_level = DEFAULT_LOG_LEVEL;
+	int decimation = 1;
+	cpu_set_t rt_cpus;
+	const char *socket_path = SYNCIPC_SOCKET_PATH;
+	const char *metrics_address = NULL;
+	const char *journal_path = NULL;
+	unsigned long long journal_records = DEFAULT_JOURNAL_RECORDS;
+	SYNC_JOURNAL journal;
+	struct timespec journal_flush, now;
+	const char *archive_path = NULL;
+	int archive_raw_days = DEFAULT_ARCHIVE_RAW_DAYS;
+	int archive_minute_days = DEFAULT_ARCHIVE_MINUTE_DAYS;
+	SYNC_ARCHIVE *archive = NULL;
+	int cards[SYNC_MAX_DEVICES] = { 0 };	/* Sync from the first card by default */
+	int card_count = 1;
+	int ipc_fd, maxfd;
+	SYNC_CONFIG card;
+	SYNC_METRICS metrics;
+	SYNC_QUALITY quality;
+	SYNC_STATE state;
 #ifdef __ENABLE_OUTPUT_FEATURE__
-	char optstring[] = "ht:o:f:Iw:ds:i:p:B";
+	char optstring[] = "ht:o:f:Iw:ds:i:r:D:P:p:Bu:m:c:aF:R:A:l:j:J:k:K:T:L:E:O:";
 #else
-	char optstring[] = "ht:Ids:i:p:B";
+	char optstring[] = "ht:Ids:i:r:D:P:p:Bu:m:c:aF:R:A:l:j:J:k:K:T:L:E:O:";
 #endif  /* end of __ENABLE_OUTPUT_FEATURE__ */
 	char c;
 
+	/* Read the journal of a stopped or crashed daemon, no card is needed */
+	if ( argc >= 3 && strcmp(argv[1], "-x") == 0 )
+		return dump_records(argc, argv);
 
 	irigbCardHandle = mxIrigbOpen(0);
 
 	if( irigbCardHandle < 0 ) {
-		fprintf(stderr,"mxIrigbOpen() fail! device not exist!\n");
+		sync_log(LOG_ERR, "mxIrigbOpen() fail! device not exist!");
 		return 0;
 	}
 
@@ -276,6 +809,7 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 
+	CPU_ZERO(&rt_cpus);
 	while ((c = getopt(argc, argv, optstring)) != -1)
 		switch (c) {
 		case 'h':
@@ -358,17 +892,17 @@ int main(int argc, char *argv[])
 			break;
 		case 's':
 			time_source = atoi(optarg);
-			printf("timesource - s:%d, 0(FREERUN) 1(IRIG0) 2(IRIG1)\n", time_source);
+			printf("timesource - s:%d, 0(FREERUN) 1(IRIG0) 2(IRIG1) 4(PPS)\n", time_source);
 			switch(dwHWID) {
 				case 0x01:
-				if ( time_source != 2 ) {
+				if ( time_source != TIMESRC_PORT1 && time_source != TIMESRC_PPS ) {
 					printf("Invalid s:%d, please check the usage information\n", time_source);
 					return 0;
 				}
 				break;
 				case 0x02:
 				case 0x07:
-				if ( time_source < 0 || time_source > 2 ) {
+				if ( time_source < 0 || (time_source >= TIMESRC_UNKNOWN && time_source != TIMESRC_PPS) ) {
 					printf("Invalid s:%d, please check the usage information\n", time_source);
 					return 0;
 				}
@@ -382,7 +916,7 @@ int main(int argc, char *argv[])
 						return 0;
 					}
 				}
-				else if ( time_source == 2 )  { /* IRIG-B Port 1, IRIG-B decoded 1 */
+				else if ( time_source == 2 || time_source == TIMESRC_PPS )  { /* IRIG-B Port 1, IRIG-B decoded 1 or the PPS decoder */
 					time_source_interface = 1;
 				}
 			}
@@ -395,6 +929,30 @@ int main(int argc, char *argv[])
 				return 0;
 			}
 			break;
+		case 'r':
+			sscanf(optarg, "%d", &sample_rate);
+			printf("sample_rate - r:%d\n", sample_rate);
+			if ( sample_rate < 0 || sample_rate > MAX_SAMPLE_RATE || (sample_rate > 0 && 1000000000 % sample_rate != 0) ) {
+				printf("Invalid r:%d is not a divisor of 1000000000 in 1 ~ %d\n", sample_rate, MAX_SAMPLE_RATE);
+				return 0;
+			}
+			break;
+		case 'D':
+			sscanf(optarg, "%d", &decimation);
+			printf("decimation - D:%d\n", decimation);
+			if ( decimation < 1 || decimation > MAX_DECIMATION ) {
+				printf("Invalid D:%d is not in 1 ~ %d\n", decimation, MAX_DECIMATION);
+				return 0;
+			}
+			break;
+		case 'P':
+			sscanf(optarg, "%d", &sample_phase);
+			printf("sample_phase - P:%d\n", sample_phase);
+			if ( sample_phase < MIN_SAMPLE_PHASE || sample_phase > MAX_SAMPLE_PHASE ) {
+				printf("Invalid P:%d is not in %d ~ %d\n", sample_phase, MIN_SAMPLE_PHASE, MAX_SAMPLE_PHASE);
+				return 0;
+			}
+			break;
 		case 'p':
 			sscanf(optarg, "%d", &parity_mode);
 			printf("Input and output parity_mode:%d\n", parity_mode);
@@ -403,10 +961,125 @@ int main(int argc, char *argv[])
 				return 0;
 			}
 			break;
+		case 'F':
+			config_path = optarg;
+			printf("config_path - F:%s\n", config_path);
+			break;
+		case 'a':
+			failover = 1;
+			printf("failover - a:%d, 0(Sync from the -s time source only) 1(Switch between Fiber and IRIG-B port)\n", failover);
+			break;
+		case 'R':
+			sscanf(optarg, "%d", &rt_priority);
+			printf("rt_priority - R:%d, 0(Normal scheduling) 1 ~ 99(SCHED_FIFO priority)\n", rt_priority);
+			if ( rt_priority < 0 || rt_priority > 99 ) {
+				printf("Invalid R:%d is not in 0 ~ 99\n", rt_priority);
+				return 0;
+			}
+			break;
+		case 'A':
+			printf("rt_cpus - A:%s\n", optarg);
+			if ( parse_cpus(optarg, &rt_cpus) <= 0 )
+				return 0;
+			break;
+		case 'l':
+			sscanf(optarg, "%d", &log_level);
+			printf("log_level - l:%d\n", log_level);
+			if ( log_level < LOG_ERR || log_level > LOG_DEBUG ) {
+				printf("Invalid l:%d is not in %d ~ %d\n", log_level, LOG_ERR, LOG_DEBUG);
+				return 0;
+			}
+			break;
+		case 'j':
+			journal_path = optarg;
+			printf("journal_path - j:%s\n", journal_path);
+			break;
+		case 'J':
+			sscanf(optarg, "%llu", &journal_records);
+			printf("journal_records - J:%llu\n", journal_records);
+			if ( journal_records < MIN_JOURNAL_RECORDS || journal_records > MAX_JOURNAL_RECORDS ) {
+				printf("Invalid J:%llu is not in %d ~ %d\n", journal_records, MIN_JOURNAL_RECORDS, MAX_JOURNAL_RECORDS);
+				return 0;
+			}
+			break;
+		case 'k':
+			archive_path = optarg;
+			printf("archive_path - k:%s\n", archive_path);
+			break;
+		case 'K':
+			sscanf(optarg, "%d,%d", &archive_raw_days, &archive_minute_days);
+			printf("archive_days - K:%d,%d\n", archive_raw_days, archive_minute_days);
+			if ( archive_raw_days < 1 || archive_raw_days > MAX_ARCHIVE_DAYS ||
+			     archive_minute_days < 1 || archive_minute_days > MAX_ARCHIVE_DAYS ) {
+				printf("Invalid K:%s is not in 1 ~ %d days\n", optarg, MAX_ARCHIVE_DAYS);
+				return 0;
+			}
+			break;
+		case 'T':
+			accuracy = monitor_limit(optarg);
+			printf("accuracy - T:%s, %lld ns\n", optarg, accuracy);
+			if ( accuracy < 0 ) {
+				printf("Invalid T:%s is not T1 ~ T5 or 0 ~ %lld ns\n", optarg, MAX_MONITOR_LIMIT);
+				return 0;
+			}
+			break;
+		case 'L':
+			tai_offset = atoi(optarg);
+			printf("tai_offset - L:%d\n", tai_offset);
+			if ( tai_offset < 0 || tai_offset > MAX_TAI_OFFSET ) {
+				printf("Invalid L:%d is not in 0 ~ %d\n", tai_offset, MAX_TAI_OFFSET);
+				return 0;
+			}
+			break;
+		case 'E':
+			if ( optarg[0] == 'P' || optarg[0] == 'p' ) {
+				loopback_port = atoi(optarg + 1);
+				printf("loopback_port - E:%d\n", loopback_port);
+				if ( loopback_port < PORT_1 || loopback_port > PORT_4 ) {
+					printf("Invalid E:%s is not P%d ~ P%d\n", optarg, PORT_1, PORT_4);
+					return 0;
+				}
+			} else {
+				input_delay = atoi(optarg);
+				printf("input_delay - E:%d ns\n", input_delay);
+				if ( input_delay < 0 || input_delay > MAX_INPUT_DELAY ) {
+					printf("Invalid E:%s is not in 0 ~ %d ns\n", optarg, MAX_INPUT_DELAY);
+					return 0;
+				}
+			}
+			break;
+		case 'O':
+			sscanf(optarg, "%d,%d,%d,%d", &output_delay[0], &output_delay[1], &output_delay[2], &output_delay[3]);
+			printf("output_delay - O:%d,%d,%d,%d ns\n", output_delay[0], output_delay[1], output_delay[2], output_delay[3]);
+			for ( i = 0; i < SYNC_OUTPUT_PORTS; i++ ) {
+				if ( output_delay[i] < -MAX_OUTPUT_DELAY || output_delay[i] > MAX_OUTPUT_DELAY ) {
+					printf("Invalid O:%s is not in %d ~ %d ns\n", optarg, -MAX_OUTPUT_DELAY, MAX_OUTPUT_DELAY);
+					return 0;
+				}
+			}
+			break;
 		case 'B':
 			be_a_Daemon = 1;
 			printf("be_a_Daemon - B:%d, 0(Not run in daemon) 1(Run in Daemon)\n", be_a_Daemon);
 			break;
+		case 'u':
+			socket_path = optarg;
+			printf("socket_path - u:%s\n", socket_path);
+			break;
+		case 'm':
+			metrics_address = optarg;
+			printf("metrics_address - m:%s\n", metrics_address);
+			break;
+		case 'c':
+			if ( strcmp(optarg, "list") == 0 ) {
+				list_cards();
+				return 0;
+			}
+			card_count = parse_cards(optarg, cards);
+			printf("cards - c:%s, %d card(s) selected\n", optarg, card_count);
+			if ( card_count <= 0 )
+				return 0;
+			break;
 		case '?':
 			printf("Invalid option, please check the usage information\n");
 		default:
@@ -451,114 +1124,219 @@ int main(int argc, char *argv[])
 		create_pid_file(PIDFILE);
 	}
 
-	/* Get the IRIG-B file discriptor */
-	irigbCardHandle = mxIrigbOpen(0);
+	/* Never block the sampling threads on the console or the journal */
+	if ( sync_log_open(be_a_Daemon, log_level) < 0 ) {
+		fprintf(stderr,"The log writer is unavailable, log to stderr\n");
+	}
 
-	if( irigbCardHandle < 0 ) {
-		fprintf(stderr,"mxIrigbOpen() fail!\n");
+	cmdline_config.interval = time_sync_interval;
+	cmdline_config.phase = sample_phase;
+	cmdline_config.rate = sample_rate;
+	cmdline_config.decimation = decimation;
+	cmdline_config.signal_type = signal_type;
+	cmdline_config.inverse = inverse;
+	cmdline_config.time_source = time_source;
+	cmdline_config.time_source_interface = time_source_interface;
+	cmdline_config.pps_port = (time_source == TIMESRC_PPS) ? time_source_interface : PORT_1;
+	cmdline_config.parity_mode = parity_mode;
+	cmdline_config.failover = failover;
+	cmdline_config.accuracy = (int)accuracy;
+	cmdline_config.tai_offset = tai_offset;
+	cmdline_config.input_delay = input_delay;
+	cmdline_config.loopback_port = loopback_port;
+	memcpy(cmdline_config.output_delay, output_delay, sizeof(output_delay));
+#ifdef __ENABLE_OUTPUT_FEATURE__
+	cmdline_config.port_to_output = port_to_output;
+	cmdline_config.from_port = from_port;
+	cmdline_config.pps_width = pps_width;
+#endif  /* end of __ENABLE_OUTPUT_FEATURE__ */
+
+	/* The configuration file overrides the command line */
+	running_config = cmdline_config;
+	if ( config_path && sync_config_load(config_path, &running_config) < 0 ) {
+		sync_log(LOG_ERR, "Invalid configuration file %s", config_path);
 		return 0;
 	}
 
-	fprintf(stderr,"+++Services start\n");
+	/* Read the configuration file again on SIGHUP */
+	signal(SIGHUP, sig_handler_for_reload);
 
-	/* Sync Local Time from IRIG-B RTC */
-	if(!mxIrigbSyncTime(irigbCardHandle, TRUE)) {
-		fprintf(stderr, "mxIrigbSyncTime() fail\n");
-		mxIrigbClose(irigbCardHandle);
+	if ( sync_state_init(&state, running_config.interval) < 0 ) {
+		sync_log(LOG_ERR, "sync_state_init() fail");
 		return 0;
 	}
 
-	/* Set sync time source */
-	if (!mxIrigbSetSyncTimeSrc(irigbCardHandle, time_source) ) {
-		printf("Set sync source fail\n");
-		mxIrigbClose(irigbCardHandle);
+	sync_state_set_phase(&state, running_config.phase);
+	if ( sync_state_set_rate(&state, running_config.rate, running_config.decimation) < 0 ) {
+		sync_log(LOG_ERR, "Invalid sample rate %d", running_config.rate);
+		return 0;
+	}
+	sync_state_set_accuracy(&state, running_config.accuracy);
+	if ( sync_state_set_tai(&state, running_config.tai_offset) < 0 ) {
+		sync_log(LOG_WARNING, "The TAI offset %d s is not set", running_config.tai_offset);
+	}
+	if ( sync_state_set_realtime(&state, rt_priority, &rt_cpus) < 0 ) {
+		sync_log(LOG_ERR, "Invalid real-time priority %d", rt_priority);
 		return 0;
 	}
 
-	/* Only Fiber port and IRIG-B port1 need to set time interface */
-	if ( time_source == 1 || time_source == 2 ) {
-
-		/* Configure IRIG-B input interface and type. */ 
-		fprintf(stderr,"Set PORT(%d) time_source_interface: %d signal type: %d, inverse:%d\n", time_source, time_source_interface, signal_type, inverse);
+	/* Nothing is allocated in the steady state, keep the pages resident.
+	 * The journal ring (40 bytes a record, 100 MB by default) and the archive blocks would
+	 * pin too much of a small host, they are mapped after the lock and only the journal
+	 * writer of the normal scheduling touches the ring. */
+	if ( state.rt_priority > 0 && sync_state_lock_memory() < 0 ) {
+		sync_log(LOG_WARNING, "The memory is not locked, a page fault may delay the sampling");
+	}
 
-		/* Set the interface type for Fiber port and IRIG-B port 1 */
-		if(!mxIrigbSetInputSignalType(irigbCardHandle, time_source_interface, signal_type, inverse)) {
-			fprintf(stderr, "mxIrigbSetSignalType() fail\n");
-			mxIrigbClose(irigbCardHandle);
+	/* Map the journal before the sampling threads queue records for it */
+	if ( journal_path ) {
+		if ( sync_journal_open(&journal, journal_path, journal_records) < 0 ) {
+			sync_log(LOG_ERR, "The sample journal %s is unavailable", journal_path);
 			return 0;
 		}
-
-		/* Configure the IRIG-B input parity mode */
-		fprintf(stderr,"Set input interface %d parity %d\n", time_source, parity_mode);
-		if (!mxIrigbSetInputParityCheckMode(irigbCardHandle, time_source, parity_mode)) {
-			fprintf(stderr, "mxIrigbSetInputParityCheckMode fail\n");
-			mxIrigbClose(irigbCardHandle);
+		if ( sync_journal_start(&journal) < 0 ) {
+			sync_log(LOG_ERR, "The sample journal writer is unavailable");
 			return 0;
 		}
+		state.journal = &journal;
 	}
 
-#ifdef __ENABLE_OUTPUT_FEATURE__
-	/* Configure IRIG-B output port and its input time source */
-	fprintf(stderr,"Set IRIG-B output port:%d, signal type:%d, from_port:%d, inverse:%d\n", port_to_output, signal_type, from_port, inverse);
-	if( ! mxIrigbSetOutputInterface(irigbCardHandle, port_to_output, signal_type, from_port, inverse) ) {
-		fprintf(stderr,"mxIrigbSetOutputInterface(): fail\n");
-		mxIrigbClose(irigbCardHandle);
-		return 0;
+	/* The archive follows the journal, resume where the last run stopped */
+	if ( archive_path ) {
+		if ( !journal_path ) {
+			sync_log(LOG_ERR, "The archive %s is compressed from the journal, add -j", archive_path);
+			return 0;
+		}
+		archive = sync_archive_open(archive_path, archive_raw_days, archive_minute_days);
+		if ( archive == NULL ) {
+			sync_log(LOG_ERR, "The archive %s is unavailable", archive_path);
+			return 0;
+		}
 	}
 
-	/* Configure the IRIG-B output parity mode */
-	fprintf(stderr,"Set IRIG-B output parity %d\n",  parity_mode);
-	if ( parity_mode == 2 )  {
-		printf("The parity(NONE) is unavailable in output mode.\n");
+	/* The stacks of the sampling threads started next are locked */
+	if ( state.rt_priority > 0 && sync_state_lock_future() < 0 ) {
+		sync_log(LOG_WARNING, "The memory is not locked, a page fault may delay the sampling");
 	}
-	else {
-		if (!mxIrigbSetOutputParityCheckMode(irigbCardHandle, parity_mode) ) {
-			fprintf(stderr, "mxIrigbSetOutputParityCheckMode(): fail\n");
+
+	sync_log(LOG_NOTICE, "+++Services start");
+
+	for ( i = 0; i < card_count; i++ ) {
+		/* Get the IRIG-B file discriptor */
+		irigbCardHandle = mxIrigbOpen(cards[i]);
+
+		if( irigbCardHandle < 0 ) {
+			sync_log(LOG_ERR, "mxIrigbOpen(%d) fail!", cards[i]);
+			continue;
+		}
+
+		if ( !mxIrigbGetHardwareID(irigbCardHandle, &dwHWID) )
+			dwHWID = 0;
+
+		/* Sync Local Time from the RTC of the first IRIG-B card */
+		if( state.device_count == 0 && !mxIrigbSyncTime(irigbCardHandle, TRUE)) {
+			sync_log(LOG_ERR, "mxIrigbSyncTime() fail");
 			mxIrigbClose(irigbCardHandle);
-			return 0;
+			continue;
 		}
-	}
 
-	/* For DA-682A DA-IRIGB-4DIO-PCI104, DA-820 IRIG-B module */
-	if( pps_width ) {
-		fprintf(stderr,"Set PPS Width: {%d} ms\n", pps_width);
-		if(!mxIrigbSetPpsWidth(irigbCardHandle, pps_width)) {
-			fprintf(stderr,"mxIrigbSetPpsWidth() pps_width:%d fail\n", pps_width);
+		card_config(&card, &running_config, dwHWID);
+		if ( !setup_card(irigbCardHandle, NULL, &card) ) {
+			sync_log(LOG_ERR, "Card %d is not configured", cards[i]);
 			mxIrigbClose(irigbCardHandle);
-			return 0;
+			continue;
 		}
+
+		/* Sample every card in its own thread */
+		if ( sync_device_start(&state, cards[i], irigbCardHandle, dwHWID, card.time_source, card.failover,
+			card_input_delay(irigbCardHandle, cards[i], &card), card_output_advance(irigbCardHandle, cards[i], &card)) < 0 ) {
+			mxIrigbClose(irigbCardHandle);
+			continue;
+		}
+		applied_card[state.device_count - 1] = card;
+		sync_log(LOG_INFO, "Card %d started, Hardware ID = %lu", cards[i], dwHWID);
 	}
-#endif  /* end of __ENABLE_OUTPUT_FEATURE__ */
 
-	/* Sync Time Source */
-	fprintf(stderr,"Sync Time Source = {%d}\n", time_source);
-	if(!mxIrigbSetSyncTimeSrc(irigbCardHandle, time_source)) {
-		fprintf(stderr,"mxIrigbSetSyncTimeSrc() time_source:%d fail\n", time_source);
-		mxIrigbClose(irigbCardHandle);
+	if ( state.device_count == 0 ) {
+		sync_log(LOG_ERR, "No IRIG-B card to sync the time from");
 		return 0;
 	}
+	state.reload = config_path ? reload_config : NULL;
 
-	struct timeval tv={0,0};
+	/* Report the IRIG-B status to other processes */
+	ipc_fd = sync_ipc_open(socket_path);
+	if ( ipc_fd < 0 ) {
+		sync_log(LOG_ERR, "The status and control socket is unavailable");
+	}
+
+	/* Export the sync health to Prometheus */
+	metrics.fd = -1;
+	if ( metrics_address && sync_metrics_open(&metrics, metrics_address) < 0 ) {
+		sync_log(LOG_ERR, "The metrics exporter is unavailable");
+	}
 
-	/* Stop running when process is killed */
+	/* Publish the time quality of the cards and the system clock to the applications */
+	if ( sync_quality_open(&quality, MXIRIG_QUALITY_SHM) < 0 ) {
+		sync_log(LOG_ERR, "The time quality is not published");
+	}
+
+	struct timeval tv;
+	fd_set rfds;
+
+	clock_gettime(CLOCK_MONOTONIC, &journal_flush);
+
+	/* Stop running when process is killed. The cards are sampled by their
+	 * own threads, serve the status requests meanwhile. */
 	while ( !bStopping ) {
-		fprintf(stderr,"Sync. Time From IRIG RTC...\n");
-		if(!mxIrigbSyncTime(irigbCardHandle, FALSE)) {
-			fprintf(stderr,"mxIrigbSyncTime() fail\n");
+		if ( bReload ) {
+			bReload = 0;
+			if ( reload_config(&state) < 0 )
+				sync_log(LOG_WARNING, "Reload fail, keep the settings not applied");
 		}
 
-/*
-	TODO: Can be get IRIG-B status and report to other process by IPC.
-*/
+		tv.tv_sec = 1;
+		tv.tv_usec = 0;
+
+		FD_ZERO(&rfds);
+		maxfd = ipc_fd;
+		if ( ipc_fd >= 0 )
+			FD_SET(ipc_fd, &rfds);
+		maxfd = sync_metrics_fdset(&metrics, &rfds, maxfd);
+
+		if ( select(maxfd + 1, &rfds, NULL, NULL, &tv) < 0 )
+			continue;
 
-		/* Delay for the time sync interval */
-		tv.tv_sec = time_sync_interval ;
-		select(0, NULL, NULL, NULL, &tv);
+		if ( ipc_fd >= 0 && FD_ISSET(ipc_fd, &rfds) )
+			sync_ipc_process(ipc_fd, &state);
+		sync_metrics_process(&metrics, &rfds, &state);
+
+		if ( archive )
+			sync_archive_update(archive, state.journal);
+		sync_quality_update(&quality, &state);
+
+		/* The journal survives a daemon crash anyway, bound the loss on a power failure */
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ( state.journal && now.tv_sec - journal_flush.tv_sec >= SYNC_JOURNAL_FLUSH_INTERVAL ) {
+			sync_journal_flush(state.journal);
+			journal_flush = now;
+		}
 	}
 
-	fprintf(stderr,"---Services stop\n");
+	sync_log(LOG_NOTICE, "---Services stop");
 
-	mxIrigbClose(irigbCardHandle);
+	sync_metrics_close(&metrics);
+	sync_ipc_close(ipc_fd, socket_path);
+
+	sync_state_stop(&state);
+	sync_journal_stop();
+	sync_quality_close(&quality);
+	if ( archive ) {
+		sync_archive_update(archive, state.journal);
+		sync_archive_close(archive);
+	}
+	if ( state.journal )
+		sync_journal_close(state.journal);
+	sync_log_close();
 
 	return 0;
 }
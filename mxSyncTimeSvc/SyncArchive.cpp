@@ -0,0 +1,847 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncArchive.cpp : compressed long-term archive of the IRIG-B time sync daemon.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "SyncArchive.h"
+#include "SyncLog.h"
+
+#define USEC_PER_MIN			60000000LL
+#define USEC_PER_HOUR			3600000000LL
+#define USEC_PER_DAY			86400000000LL
+#define ARCHIVE_RECORDS_PER_UPDATE	(1 << 20)	/* bound the time of an update */
+
+#pragma pack(push, 1)
+
+/* The resume point, saved after every block written */
+typedef struct _ARCHIVE_STATE {
+	uint32_t magic;			/* SYNC_ARCHIVE_MAGIC */
+	uint32_t version;		/* SYNC_ARCHIVE_VERSION */
+	uint64_t next;			/* the first journal record of an open block or aggregate */
+	int64_t last[SYNC_ARCHIVE_CARDS][ARCHIVE_TIERS];
+} ARCHIVE_STATE;
+
+#pragma pack(pop)
+
+static const char *tier_name[ARCHIVE_TIERS] = { "raw", "minute", "hour" };
+
+/* Value bucket widths, selected by a unary prefix of 0 to 5 one bits */
+static const int bucket_bits[] = { 0, 6, 13, 20, 32, 64 };
+#define BUCKETS				(int)(sizeof(bucket_bits) / sizeof(bucket_bits[0]))
+
+static uint32_t crc32(const uint8_t *data, size_t size)
+{
+	uint32_t crc = 0xffffffff;
+
+	while (size--) {
+		crc ^= *data++;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+		}
+	}
+
+	return ~crc;
+}
+
+static void put_bits(SYNC_BLOCK *b, uint64_t v, int n)
+{
+	while (n > 0) {
+		int room = 8 - (b->bits & 7);
+		int take = n < room ? n : room;
+		uint8_t chunk = (v >> (n - take)) & ((1u << take) - 1);
+
+		b->data[b->bits >> 3] |= chunk << (room - take);
+		b->bits += take;
+		n -= take;
+	}
+}
+
+static int get_bits(SYNC_BLOCK *b, uint64_t *v, int n)
+{
+	if (b->bits + n > (size_t)b->header.size * 8) {
+		return -1;
+	}
+
+	*v = 0;
+	while (n > 0) {
+		int room = 8 - (b->bits & 7);
+		int take = n < room ? n : room;
+		uint8_t chunk = (b->data[b->bits >> 3] >> (room - take)) & ((1u << take) - 1);
+
+		*v = (*v << take) | chunk;
+		b->bits += take;
+		n -= take;
+	}
+
+	return 0;
+}
+
+/* A signed value as zigzag in the narrowest bucket */
+static void put_int(SYNC_BLOCK *b, int64_t v)
+{
+	uint64_t z = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+	int i;
+
+	for (i = 0; i < BUCKETS - 1; i++) {
+		if (z < (1ULL << bucket_bits[i])) {
+			break;
+		}
+	}
+	if (i < BUCKETS - 1) {
+		put_bits(b, (1ULL << (i + 1)) - 2, i + 1);
+	} else {
+		put_bits(b, (1ULL << i) - 1, i);
+	}
+	put_bits(b, z, bucket_bits[i]);
+}
+
+static int get_int(SYNC_BLOCK *b, int64_t *v)
+{
+	uint64_t bit, z = 0;
+	int i;
+
+	for (i = 0; i < BUCKETS - 1; i++) {
+		if (get_bits(b, &bit, 1) < 0) {
+			return -1;
+		}
+		if (!bit) {
+			break;
+		}
+	}
+	if (bucket_bits[i] > 0 && get_bits(b, &z, bucket_bits[i]) < 0) {
+		return -1;
+	}
+	*v = (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+
+	return 0;
+}
+
+static int64_t delta(int64_t a, int64_t b)
+{
+	return (int64_t)((uint64_t)a - (uint64_t)b);
+}
+
+static int64_t undelta(int64_t prev, int64_t d)
+{
+	return (int64_t)((uint64_t)prev + (uint64_t)d);
+}
+
+static void encode_point(SYNC_BLOCK *b, const SYNC_POINT *p)
+{
+	int64_t d;
+
+	/* The time as delta-of-delta, the values as deltas */
+	if (b->header.count == 0) {
+		put_bits(b, (uint64_t)p->time, 64);
+		b->header.first = p->time;
+	} else {
+		d = delta(p->time, b->prev.time);
+		put_int(b, delta(d, b->delta));
+		b->delta = d;
+	}
+	put_int(b, delta(p->offset, b->prev.offset));
+	put_int(b, (int64_t)p->freq - b->prev.freq);
+
+	if (b->header.tier == ARCHIVE_RAW) {
+		if (b->header.count > 0 && p->status == b->prev.status) {
+			put_bits(b, 0, 1);
+		} else {
+			put_bits(b, 1, 1);
+			put_bits(b, p->status, 16);
+		}
+	} else {
+		put_int(b, (int64_t)p->count - b->prev.count);
+		put_int(b, delta(p->min, b->prev.min));
+		put_int(b, delta(p->max, b->prev.max));
+	}
+
+	b->prev = *p;
+	b->header.last = p->time;
+	b->header.count++;
+}
+
+static int decode_point(SYNC_BLOCK *b, SYNC_POINT *p)
+{
+	uint64_t v;
+	int64_t d;
+
+	*p = b->prev;
+	if (b->bits == 0) {
+		if (get_bits(b, &v, 64) < 0) {
+			return -1;
+		}
+		p->time = (int64_t)v;
+	} else {
+		if (get_int(b, &d) < 0) {
+			return -1;
+		}
+		b->delta = undelta(b->delta, d);
+		p->time = undelta(b->prev.time, b->delta);
+	}
+	if (get_int(b, &d) < 0) {
+		return -1;
+	}
+	p->offset = undelta(b->prev.offset, d);
+	if (get_int(b, &d) < 0) {
+		return -1;
+	}
+	p->freq = (int32_t)(b->prev.freq + d);
+
+	if (b->header.tier == ARCHIVE_RAW) {
+		if (get_bits(b, &v, 1) < 0) {
+			return -1;
+		}
+		if (v) {
+			if (get_bits(b, &v, 16) < 0) {
+				return -1;
+			}
+			p->status = (uint16_t)v;
+		}
+		p->count = 1;
+		p->min = p->max = p->offset;
+	} else {
+		if (get_int(b, &d) < 0) {
+			return -1;
+		}
+		p->count = (uint32_t)(b->prev.count + d);
+		if (get_int(b, &d) < 0) {
+			return -1;
+		}
+		p->min = undelta(b->prev.min, d);
+		if (get_int(b, &d) < 0) {
+			return -1;
+		}
+		p->max = undelta(b->prev.max, d);
+	}
+
+	b->prev = *p;
+
+	return 0;
+}
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+	return a / b - (a % b < 0);
+}
+
+/* A block ends with the hour, and with the day for the hour aggregates */
+static int64_t block_period(int tier)
+{
+	return tier == ARCHIVE_HOUR ? USEC_PER_DAY : USEC_PER_HOUR;
+}
+
+static int64_t aggregate_period(int tier)
+{
+	return tier == ARCHIVE_MINUTE ? USEC_PER_MIN : USEC_PER_HOUR;
+}
+
+/* Check the length of a path built by snprintf(), return -1 when it is cut */
+static int path_check(int n, size_t size)
+{
+	return n < 0 || (size_t)n >= size ? -1 : 0;
+}
+
+/* The path of a file in the archive directory, return -1 when it does not fit */
+static int path_join(char *buf, size_t size, const char *dir, const char *name)
+{
+	return path_check(snprintf(buf, size, "%s/%s", dir, name), size);
+}
+
+/* The file of a point, raw-YYYYMMDD.mxa, minute-YYYYMM.mxa or hour-YYYY.mxa, return -1 when it does not fit */
+static int file_name(char *buf, size_t size, const char *dir, int tier, int64_t time)
+{
+	time_t sec = (time_t)floor_div(time, 1000000);
+	struct tm tm;
+	int n;
+
+	gmtime_r(&sec, &tm);
+	if (tier == ARCHIVE_RAW) {
+		n = snprintf(buf, size, "%s/raw-%04d%02d%02d.mxa", dir, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+	} else if (tier == ARCHIVE_MINUTE) {
+		n = snprintf(buf, size, "%s/minute-%04d%02d.mxa", dir, tm.tm_year + 1900, tm.tm_mon + 1);
+	} else {
+		n = snprintf(buf, size, "%s/hour-%04d.mxa", dir, tm.tm_year + 1900);
+	}
+
+	return path_check(n, size);
+}
+
+/* Get the time span of a file of the tier in us, return -1 for another file */
+static int file_span(const char *name, int tier, int64_t *start, int64_t *end)
+{
+	int year = 0, mon = 1, mday = 1, n;
+	char check[NAME_MAX + 1];
+	struct tm tm;
+
+	if (tier == ARCHIVE_RAW) {
+		n = sscanf(name, "raw-%4d%2d%2d.mxa", &year, &mon, &mday) == 3;
+		snprintf(check, sizeof(check), "raw-%04d%02d%02d.mxa", year, mon, mday);
+	} else if (tier == ARCHIVE_MINUTE) {
+		n = sscanf(name, "minute-%4d%2d.mxa", &year, &mon) == 2;
+		snprintf(check, sizeof(check), "minute-%04d%02d.mxa", year, mon);
+	} else {
+		n = sscanf(name, "hour-%4d.mxa", &year) == 1;
+		snprintf(check, sizeof(check), "hour-%04d.mxa", year);
+	}
+	if (!n || strcmp(name, check) != 0) {
+		return -1;
+	}
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = year - 1900;
+	tm.tm_mon = mon - 1;
+	tm.tm_mday = mday;
+	*start = (int64_t)timegm(&tm) * 1000000;
+	if (tier == ARCHIVE_RAW) {
+		tm.tm_mday++;
+	} else if (tier == ARCHIVE_MINUTE) {
+		tm.tm_mon++;
+	} else {
+		tm.tm_year++;
+	}
+	*end = (int64_t)timegm(&tm) * 1000000;
+
+	return 0;
+}
+
+/* The size of the whole blocks of a file, a torn block at the end is cut off */
+static off_t valid_end(int fd)
+{
+	SYNC_BLOCK_HEADER h;
+	struct stat st;
+	off_t end = 0;
+
+	if (fstat(fd, &st) < 0) {
+		return -1;
+	}
+	while (end + (off_t)sizeof(h) <= st.st_size) {
+		if (pread(fd, &h, sizeof(h), end) != sizeof(h) || h.magic != SYNC_ARCHIVE_MAGIC ||
+		    h.version != SYNC_ARCHIVE_VERSION || h.size > SYNC_ARCHIVE_BLOCK_BYTES ||
+		    end + (off_t)sizeof(h) + h.size > st.st_size) {
+			break;
+		}
+		end += sizeof(h) + h.size;
+	}
+	if (end != st.st_size && ftruncate(fd, end) < 0) {
+		return -1;
+	}
+
+	return end;
+}
+
+static void block_reset(SYNC_BLOCK *b, int tier, int card)
+{
+	memset(b->data, 0, (b->bits + 7) / 8);
+	memset(&b->header, 0, sizeof(b->header));
+	memset(&b->prev, 0, sizeof(b->prev));
+	b->header.tier = tier;
+	b->header.card = card;
+	b->bits = 0;
+	b->delta = 0;
+}
+
+/* Append the open block of a tier to its file */
+static void block_flush(SYNC_ARCHIVE *a, int tier, int card)
+{
+	SYNC_BLOCK *b = &a->card[card].block[tier];
+	char path[PATH_MAX];
+	off_t end;
+	int fd;
+
+	if (b->header.count == 0) {
+		return;
+	}
+
+	b->header.magic = SYNC_ARCHIVE_MAGIC;
+	b->header.version = SYNC_ARCHIVE_VERSION;
+	b->header.size = (b->bits + 7) / 8;
+	b->header.crc = crc32(b->data, b->header.size);
+
+	if (file_name(path, sizeof(path), a->dir, tier, b->header.first) < 0) {
+		SYNC_LOG(LOG_ERR, "Archive path under %s is too long", a->dir);
+		block_reset(b, tier, card);
+		return;
+	}
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		SYNC_LOG(LOG_ERR, "Open %s fail: %s", path, strerror(errno));
+		block_reset(b, tier, card);
+		return;
+	}
+
+	/* Check the end of a file once, then trust the appends of this process */
+	end = a->tail_end[tier];
+	if (strcmp(path, a->tail_path[tier]) != 0 || lseek(fd, 0, SEEK_END) != end) {
+		end = valid_end(fd);
+	}
+	if (end < 0 ||
+	    pwrite(fd, &b->header, sizeof(b->header) + b->header.size, end) != (ssize_t)(sizeof(b->header) + b->header.size) ||
+	    fdatasync(fd) < 0) {
+		SYNC_LOG(LOG_ERR, "Write %s fail: %s", path, strerror(errno));
+		a->tail_path[tier][0] = '\0';
+	} else {
+		snprintf(a->tail_path[tier], sizeof(a->tail_path[tier]), "%s", path);
+		a->tail_end[tier] = end + sizeof(b->header) + b->header.size;
+		a->card[card].last[tier] = b->header.last;
+		a->dirty = 1;
+	}
+	close(fd);
+
+	block_reset(b, tier, card);
+}
+
+static void block_add(SYNC_ARCHIVE *a, int tier, int card, const SYNC_POINT *p)
+{
+	SYNC_BLOCK *b = &a->card[card].block[tier];
+
+	if (b->header.count > 0 &&
+	    (floor_div(b->header.first, block_period(tier)) != floor_div(p->time, block_period(tier)) ||
+	     b->header.count >= SYNC_ARCHIVE_BLOCK_POINTS ||
+	     b->bits / 8 + SYNC_ARCHIVE_POINT_BYTES > SYNC_ARCHIVE_BLOCK_BYTES)) {
+		block_flush(a, tier, card);
+	}
+
+	encode_point(b, p);
+}
+
+/* Write the aggregate of a finished minute or hour */
+static void aggregate_flush(SYNC_ARCHIVE *a, int tier, int card)
+{
+	SYNC_AGGREGATE *g = &a->card[card].aggregate[tier];
+	SYNC_POINT p;
+
+	if (g->count == 0) {
+		return;
+	}
+
+	/* Written before a restart, rebuilt from the journal since */
+	if (g->start > a->card[card].last[tier]) {
+		memset(&p, 0, sizeof(p));
+		p.time = g->start;
+		p.offset = llround(g->offset_sum / g->count);
+		p.min = g->min;
+		p.max = g->max;
+		p.freq = (int32_t)lround(g->freq_sum / g->count);
+		p.count = g->count;
+		block_add(a, tier, card, &p);
+	}
+	g->count = 0;
+}
+
+static void aggregate_add(SYNC_ARCHIVE *a, int tier, int card, int64_t time, int64_t offset, int32_t freq)
+{
+	SYNC_AGGREGATE *g = &a->card[card].aggregate[tier];
+	int64_t start = floor_div(time, aggregate_period(tier)) * aggregate_period(tier);
+
+	if (g->count > 0 && g->start != start) {
+		aggregate_flush(a, tier, card);
+	}
+	if (g->count == 0) {
+		g->start = start;
+		g->min = g->max = offset;
+		g->offset_sum = g->freq_sum = 0;
+	}
+
+	g->count++;
+	g->offset_sum += offset;
+	g->freq_sum += freq;
+	if (offset < g->min) {
+		g->min = offset;
+	}
+	if (offset > g->max) {
+		g->max = offset;
+	}
+}
+
+/* Remove the raw and minute files beyond their retention */
+static void prune(SYNC_ARCHIVE *a, int64_t day)
+{
+	int64_t start, end, keep[ARCHIVE_TIERS];
+	char path[PATH_MAX];
+	struct dirent *e;
+	DIR *d;
+
+	keep[ARCHIVE_RAW] = (day - a->raw_days) * USEC_PER_DAY;
+	keep[ARCHIVE_MINUTE] = (day - a->minute_days) * USEC_PER_DAY;
+
+	d = opendir(a->dir);
+	if (d == NULL) {
+		return;
+	}
+	while ((e = readdir(d)) != NULL) {
+		for (int tier = ARCHIVE_RAW; tier < ARCHIVE_HOUR; tier++) {
+			if (file_span(e->d_name, tier, &start, &end) == 0 && end <= keep[tier]) {
+				if (path_join(path, sizeof(path), a->dir, e->d_name) == 0 && unlink(path) == 0) {
+					sync_log(LOG_INFO, "Archive %s expired", path);
+				}
+			}
+		}
+	}
+	closedir(d);
+
+	a->pruned_day = day;
+}
+
+static void archive_record(SYNC_ARCHIVE *a, const SYNC_RECORD *r)
+{
+	SYNC_ARCHIVE_CARD *c;
+	int64_t time, day;
+	SYNC_POINT p;
+
+	if (!(r->flags & SYNC_RECORD_RTC_VALID) || r->card >= SYNC_ARCHIVE_CARDS) {
+		return;
+	}
+
+	c = &a->card[r->card];
+	time = (r->t1 + r->latency / 2) / 1000;
+
+	/* Everything open belongs to the previous day, write it before resuming from the new day */
+	day = floor_div(time, USEC_PER_DAY);
+	if (day != c->day || c->day_seq == 0) {
+		aggregate_flush(a, ARCHIVE_MINUTE, r->card);
+		aggregate_flush(a, ARCHIVE_HOUR, r->card);
+		for (int tier = ARCHIVE_RAW; tier < ARCHIVE_TIERS; tier++) {
+			block_flush(a, tier, r->card);
+		}
+		c->day = day;
+		c->day_seq = r->seq;
+		if (day > a->pruned_day) {
+			prune(a, day);
+		}
+	}
+
+	if (time > c->last[ARCHIVE_RAW]) {
+		memset(&p, 0, sizeof(p));
+		p.time = time;
+		p.offset = p.min = p.max = SYNC_RECORD_OFFSET(r);
+		p.freq = r->freq;
+		p.count = 1;
+		p.status = r->flags << 8 | r->signal_status;
+		block_add(a, ARCHIVE_RAW, r->card, &p);
+	}
+	aggregate_add(a, ARCHIVE_MINUTE, r->card, time, SYNC_RECORD_OFFSET(r), r->freq);
+	aggregate_add(a, ARCHIVE_HOUR, r->card, time, SYNC_RECORD_OFFSET(r), r->freq);
+}
+
+/* Resume from the first journal record of the open blocks and aggregates */
+static void save_state(SYNC_ARCHIVE *a)
+{
+	char path[PATH_MAX], tmp[PATH_MAX];
+	ARCHIVE_STATE s;
+	int fd;
+
+	memset(&s, 0, sizeof(s));
+	s.magic = SYNC_ARCHIVE_MAGIC;
+	s.version = SYNC_ARCHIVE_VERSION;
+	s.next = a->next;
+	for (int card = 0; card < SYNC_ARCHIVE_CARDS; card++) {
+		if (a->card[card].day_seq != 0 && a->card[card].day_seq < s.next) {
+			s.next = a->card[card].day_seq;
+		}
+		memcpy(s.last[card], a->card[card].last, sizeof(s.last[card]));
+	}
+
+	if (path_join(path, sizeof(path), a->dir, SYNC_ARCHIVE_STATE) < 0 ||
+	    path_check(snprintf(tmp, sizeof(tmp), "%s.tmp", path), sizeof(tmp)) < 0) {
+		SYNC_LOG(LOG_ERR, "Archive path under %s is too long", a->dir);
+		return;
+	}
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		SYNC_LOG(LOG_ERR, "Open %s fail: %s", tmp, strerror(errno));
+		return;
+	}
+	if (write(fd, &s, sizeof(s)) != sizeof(s) || fdatasync(fd) < 0) {
+		SYNC_LOG(LOG_ERR, "Write %s fail: %s", tmp, strerror(errno));
+		close(fd);
+		return;
+	}
+	close(fd);
+	if (rename(tmp, path) < 0) {
+		SYNC_LOG(LOG_ERR, "rename(%s) fail: %s", path, strerror(errno));
+		return;
+	}
+
+	a->dirty = 0;
+}
+
+SYNC_ARCHIVE *sync_archive_open(const char *dir, int raw_days, int minute_days)
+{
+	char path[PATH_MAX];
+	SYNC_ARCHIVE *a;
+	ARCHIVE_STATE s;
+	int fd;
+
+	/* The temporary state file is the longest path, the archive files are no longer */
+	if (path_check(snprintf(path, sizeof(path), "%s/%s.tmp", dir, SYNC_ARCHIVE_STATE), sizeof(path)) < 0) {
+		sync_log(LOG_ERR, "Archive directory %s is too long", dir);
+		return NULL;
+	}
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+		sync_log(LOG_ERR, "mkdir(%s) fail: %s", dir, strerror(errno));
+		return NULL;
+	}
+
+	/* About 800 KB of open blocks, allocated once */
+	a = (SYNC_ARCHIVE *)calloc(1, sizeof(*a));
+	if (a == NULL) {
+		return NULL;
+	}
+	snprintf(a->dir, sizeof(a->dir), "%s", dir);
+	a->raw_days = raw_days;
+	a->minute_days = minute_days;
+	for (int card = 0; card < SYNC_ARCHIVE_CARDS; card++) {
+		for (int tier = ARCHIVE_RAW; tier < ARCHIVE_TIERS; tier++) {
+			block_reset(&a->card[card].block[tier], tier, card);
+		}
+	}
+
+	path_join(path, sizeof(path), dir, SYNC_ARCHIVE_STATE);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd >= 0) {
+		if (read(fd, &s, sizeof(s)) == sizeof(s) && s.magic == SYNC_ARCHIVE_MAGIC &&
+		    s.version == SYNC_ARCHIVE_VERSION) {
+			a->next = s.next;
+			for (int card = 0; card < SYNC_ARCHIVE_CARDS; card++) {
+				memcpy(a->card[card].last, s.last[card], sizeof(a->card[card].last));
+			}
+		}
+		close(fd);
+	}
+
+	return a;
+}
+
+void sync_archive_update(SYNC_ARCHIVE *a, SYNC_JOURNAL *j)
+{
+	uint64_t head = sync_journal_head(j);
+	uint64_t capacity = j->header->capacity;
+	SYNC_RECORD r;
+	int n = 0;
+
+	/* A new journal starts over, a lapped one lost the records in between */
+	if (a->next == 0 || a->next > head) {
+		a->next = head > capacity ? head - capacity : 1;
+	} else if (head - a->next > capacity) {
+		sync_log(LOG_WARNING, "Archive: %llu journal records lost",
+			(unsigned long long)(head - capacity - a->next));
+		a->next = head - capacity;
+	}
+
+	while (a->next < head && n++ < ARCHIVE_RECORDS_PER_UPDATE) {
+		if (sync_journal_read(j, a->next, &r) == 0) {
+			archive_record(a, &r);
+		}
+		a->next++;
+	}
+
+	if (a->dirty) {
+		save_state(a);
+	}
+}
+
+void sync_archive_close(SYNC_ARCHIVE *a)
+{
+	for (int card = 0; card < SYNC_ARCHIVE_CARDS; card++) {
+		for (int tier = ARCHIVE_RAW; tier < ARCHIVE_TIERS; tier++) {
+			block_flush(a, tier, card);
+		}
+	}
+	save_state(a);
+
+	free(a);
+}
+
+int sync_archive_tier(const char *name)
+{
+	for (int tier = ARCHIVE_RAW; tier < ARCHIVE_TIERS; tier++) {
+		if (strcmp(name, tier_name[tier]) == 0) {
+			return tier;
+		}
+	}
+
+	return -1;
+}
+
+static int name_compare(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* Decode the overlapping blocks of a file */
+static long long query_file(const char *path, int tier, int card, int64_t from, int64_t to,
+	SYNC_ARCHIVE_CALLBACK cb, void *arg, SYNC_ARCHIVE_STATS *stats, SYNC_BLOCK *b, int *stop)
+{
+	SYNC_BLOCK_HEADER h;
+	long long count = 0;
+	SYNC_POINT p;
+	off_t pos = 0;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return 0;
+	}
+	stats->files++;
+
+	/* Walk the block headers, read the payload of the overlapping ones only */
+	while (!*stop && pread(fd, &h, sizeof(h), pos) == sizeof(h)) {
+		if (h.magic != SYNC_ARCHIVE_MAGIC || h.version != SYNC_ARCHIVE_VERSION || h.size > SYNC_ARCHIVE_BLOCK_BYTES) {
+			break;
+		}
+		pos += sizeof(h);
+		if (h.tier != tier || (card >= 0 && h.card != card) || h.last < from || h.first > to) {
+			pos += h.size;
+			continue;
+		}
+
+		if (pread(fd, b->data, h.size, pos) != (ssize_t)h.size || crc32(b->data, h.size) != h.crc) {
+			fprintf(stderr, "%s: damaged block at %lld\n", path, (long long)(pos - sizeof(h)));
+			pos += h.size;
+			continue;
+		}
+		pos += h.size;
+		stats->blocks++;
+		stats->bytes += sizeof(h) + h.size;
+
+		b->header = h;
+		b->bits = 0;
+		b->delta = 0;
+		memset(&b->prev, 0, sizeof(b->prev));
+		for (uint32_t i = 0; i < h.count && !*stop; i++) {
+			if (decode_point(b, &p) < 0) {
+				fprintf(stderr, "%s: truncated block\n", path);
+				break;
+			}
+			stats->points++;
+			if (p.time < from || p.time > to) {
+				continue;
+			}
+			count++;
+			if (cb(h.card, tier, &p, arg) != 0) {
+				*stop = 1;
+			}
+		}
+	}
+	close(fd);
+
+	return count;
+}
+
+long long sync_archive_query(const char *dir, int tier, int card, int64_t from, int64_t to,
+	SYNC_ARCHIVE_CALLBACK cb, void *arg, SYNC_ARCHIVE_STATS *stats)
+{
+	SYNC_ARCHIVE_STATS unused;
+	char path[PATH_MAX];
+	char **names = NULL;
+	int n = 0, max = 0, stop = 0;
+	int64_t start, end;
+	long long count = 0;
+	struct dirent *e;
+	SYNC_BLOCK *b;
+	DIR *d;
+
+	if (tier < 0 || tier >= ARCHIVE_TIERS) {
+		return -1;
+	}
+	if (stats == NULL) {
+		stats = &unused;
+	}
+	memset(stats, 0, sizeof(*stats));
+
+	d = opendir(dir);
+	if (d == NULL) {
+		fprintf(stderr, "Open %s fail: %s\n", dir, strerror(errno));
+		return -1;
+	}
+
+	/* The files of the tier within the range, named in time order */
+	while ((e = readdir(d)) != NULL) {
+		if (file_span(e->d_name, tier, &start, &end) < 0 || end <= from || start > to) {
+			continue;
+		}
+		if (n == max) {
+			max = max ? max * 2 : 64;
+			names = (char **)realloc(names, max * sizeof(*names));
+		}
+		names[n++] = strdup(e->d_name);
+	}
+	closedir(d);
+	if (n > 0) {
+		qsort(names, n, sizeof(*names), name_compare);
+	}
+
+	b = (SYNC_BLOCK *)malloc(sizeof(*b));
+	for (int i = 0; i < n; i++) {
+		if (path_join(path, sizeof(path), dir, names[i]) < 0) {
+			fprintf(stderr, "Archive path under %s is too long\n", dir);
+		} else if (b != NULL) {
+			count += query_file(path, tier, card, from, to, cb, arg, stats, b, &stop);
+		}
+		free(names[i]);
+	}
+	free(names);
+	free(b);
+
+	return count;
+}
+
+static int dump_point(int card, int tier, const SYNC_POINT *p, void *arg)
+{
+	FILE *fp = (FILE *)arg;
+
+	if (tier == ARCHIVE_RAW) {
+		fprintf(fp, "%d,%lld.%06lld,%lld,%.3f,%u,%u,%d,%d,%d\n", card,
+			(long long)floor_div(p->time, 1000000), (long long)(p->time - floor_div(p->time, 1000000) * 1000000),
+			(long long)p->offset, p->freq / 1000.0, p->status & 0xf, (p->status >> 4) & 0xf,
+			(p->status >> 8 & SYNC_RECORD_HEALTHY) ? 1 : 0,
+			(p->status >> 8 & SYNC_RECORD_REFERENCE) ? 1 : 0,
+			(p->status >> 8 & SYNC_RECORD_ALARM) ? 1 : 0);
+	} else {
+		fprintf(fp, "%d,%lld,%u,%lld,%lld,%lld,%.3f\n", card, (long long)floor_div(p->time, 1000000),
+			p->count, (long long)p->offset, (long long)p->min, (long long)p->max, p->freq / 1000.0);
+	}
+
+	return 0;
+}
+
+long long sync_archive_dump(const char *dir, int tier, int64_t from, int64_t to, FILE *fp)
+{
+	SYNC_ARCHIVE_STATS stats;
+	long long count;
+
+	if (tier == ARCHIVE_RAW) {
+		fprintf(fp, "card,time,offset_ns,freq_ppb,fiber_status,port1_status,healthy,reference,alarm\n");
+	} else {
+		fprintf(fp, "card,time,count,offset_mean_ns,offset_min_ns,offset_max_ns,freq_ppb\n");
+	}
+
+	count = sync_archive_query(dir, tier, -1, from, to, dump_point, fp, &stats);
+	if (count >= 0 && stats.points > 0) {
+		fprintf(stderr, "%lld points in %lld blocks of %lld files, %lld bytes, %.2f bytes a point",
+			stats.points, stats.blocks, stats.files, stats.bytes, (double)stats.bytes / stats.points);
+		if (tier == ARCHIVE_RAW) {
+			fprintf(stderr, ", %.1f times smaller than the journal",
+				(double)stats.points * sizeof(SYNC_RECORD) / stats.bytes);
+		}
+		fprintf(stderr, "\n");
+	}
+
+	return count;
+}
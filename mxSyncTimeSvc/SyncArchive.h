@@ -0,0 +1,184 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncArchive.h : compressed long-term archive of the IRIG-B time sync daemon.
+ *
+ * The archive follows the sample journal and keeps three tiers per card: the
+ * raw samples, and the per minute and per hour minimum, maximum and mean. Each
+ * tier is a series of append-only files of self-describing blocks, one file a
+ * day for the raw samples, a month for the minutes and a year for the hours.
+ * A block encodes the time with delta-of-delta and every value with a zigzag
+ * delta in variable bit width buckets, Gorilla style. The block headers are
+ * the index, a range query reads only the payload of the blocks it overlaps.
+ * The raw and minute files older than their retention are removed.
+ */
+
+#ifndef __SYNCARCHIVE_H_
+#define __SYNCARCHIVE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/types.h>
+#include "SyncJournal.h"
+
+#define SYNC_ARCHIVE_MAGIC		0x4241584d	/* "MXAB" */
+#define SYNC_ARCHIVE_VERSION		1
+#define SYNC_ARCHIVE_CARDS		8		/* MXIRIG_MAX_DEVICES */
+#define SYNC_ARCHIVE_BLOCK_POINTS	4096		/* points per block at most */
+#define SYNC_ARCHIVE_BLOCK_BYTES	32768		/* payload per block at most */
+#define SYNC_ARCHIVE_POINT_BYTES	56		/* the longest encoded point */
+#define SYNC_ARCHIVE_STATE		"archive.state"
+#define DEFAULT_ARCHIVE_RAW_DAYS	31
+#define DEFAULT_ARCHIVE_MINUTE_DAYS	366
+#define MAX_ARCHIVE_DAYS		36500
+
+enum _SYNC_ARCHIVE_TIER_
+{
+	ARCHIVE_RAW = 0,		/* every sample, blocks end at the hour, a file a day */
+	ARCHIVE_MINUTE,			/* a point a minute, blocks end at the hour, a file a month */
+	ARCHIVE_HOUR,			/* a point an hour, blocks end at the day, a file a year */
+	ARCHIVE_TIERS
+};
+
+#pragma pack(push, 1)
+
+typedef struct _SYNC_BLOCK_HEADER {
+	uint32_t magic;			/* SYNC_ARCHIVE_MAGIC */
+	uint8_t version;		/* SYNC_ARCHIVE_VERSION */
+	uint8_t tier;			/* one of _SYNC_ARCHIVE_TIER_ */
+	uint8_t card;			/* card index */
+	uint8_t reserved;
+	uint32_t count;			/* points in the block */
+	uint32_t size;			/* payload bytes after the header */
+	int64_t first;			/* time of the first point in us since the Epoch */
+	int64_t last;			/* time of the last point in us since the Epoch */
+	uint32_t crc;			/* CRC-32 of the payload */
+	uint32_t reserved2;
+} SYNC_BLOCK_HEADER;
+
+#pragma pack(pop)
+
+/* A decoded point. The aggregates are stamped with the start of their minute or hour. */
+typedef struct _SYNC_POINT {
+	int64_t time;			/* us since the Epoch */
+	int64_t offset;			/* RTC time minus system time in ns, the mean of an aggregate */
+	int64_t min;			/* the least offset of an aggregate in ns */
+	int64_t max;			/* the greatest offset of an aggregate in ns */
+	int32_t freq;			/* system clock frequency adjustment in ppb/1000, the mean of an aggregate */
+	uint32_t count;			/* samples in an aggregate, 1 for a raw sample */
+	uint16_t status;		/* raw sample SYNC_RECORD flags << 8 | signal_status */
+} SYNC_POINT;
+
+/* Block encoder and decoder state */
+typedef struct _SYNC_BLOCK {
+	SYNC_BLOCK_HEADER header;
+	uint8_t data[SYNC_ARCHIVE_BLOCK_BYTES];	/* follows the header, written together */
+	size_t bits;			/* bits encoded or decoded */
+	SYNC_POINT prev;		/* the previous point */
+	int64_t delta;			/* the previous time delta */
+} SYNC_BLOCK;
+
+/* Running minimum, maximum and mean of a minute or an hour */
+typedef struct _SYNC_AGGREGATE {
+	int64_t start;			/* start of the period in us */
+	uint32_t count;
+	int64_t min;
+	int64_t max;
+	double offset_sum;
+	double freq_sum;
+} SYNC_AGGREGATE;
+
+typedef struct _SYNC_ARCHIVE_CARD {
+	SYNC_BLOCK block[ARCHIVE_TIERS];	/* the open block of each tier */
+	SYNC_AGGREGATE aggregate[ARCHIVE_TIERS];	/* the open minute and hour */
+	int64_t last[ARCHIVE_TIERS];	/* time of the last point written to the files in us */
+	int64_t day;			/* UTC day of the open points */
+	uint64_t day_seq;		/* the first journal record of the day, 0 if none */
+} SYNC_ARCHIVE_CARD;
+
+typedef struct _SYNC_ARCHIVE {
+	char dir[PATH_MAX];
+	int raw_days;			/* retention of the raw files */
+	int minute_days;		/* retention of the minute files */
+	uint64_t next;			/* the next journal record to archive */
+	int dirty;			/* blocks written since the state was saved */
+	int64_t pruned_day;		/* the day the retention was applied last */
+	char tail_path[ARCHIVE_TIERS][PATH_MAX];	/* the last file appended to */
+	off_t tail_end[ARCHIVE_TIERS];	/* its size after the last append */
+	SYNC_ARCHIVE_CARD card[SYNC_ARCHIVE_CARDS];
+} SYNC_ARCHIVE;
+
+/* Statistics of a query */
+typedef struct _SYNC_ARCHIVE_STATS {
+	long long files;		/* files scanned */
+	long long blocks;		/* blocks decoded */
+	long long bytes;		/* bytes of the decoded blocks with the headers */
+	long long points;		/* points decoded */
+} SYNC_ARCHIVE_STATS;
+
+/* Called for every point of a query in time order per block, a nonzero return stops the query */
+typedef int (*SYNC_ARCHIVE_CALLBACK)(int card, int tier, const SYNC_POINT *p, void *arg);
+
+/**
+ * Open the archive directory and resume after the last archived journal record
+ * @param  [in] dir - the archive directory, created if missing
+ * @param  [in] raw_days - the days the raw samples are kept
+ * @param  [in] minute_days - the days the minute aggregates are kept
+ * @return The archive, NULL on failure
+ */
+SYNC_ARCHIVE *sync_archive_open(const char *dir, int raw_days, int minute_days);
+
+/**
+ * Archive the journal records written since the last call
+ * @param  [in] a - the archive
+ * @param  [in] j - the sample journal
+ * @return None
+ */
+void sync_archive_update(SYNC_ARCHIVE *a, SYNC_JOURNAL *j);
+
+/**
+ * Write the open blocks and free the archive. The open aggregates are rebuilt from the journal on the next open.
+ * @param  [in] a - the archive
+ * @return None
+ */
+void sync_archive_close(SYNC_ARCHIVE *a);
+
+/**
+ * Get the tier of a name
+ * @param  [in] name - raw, minute or hour
+ * @return One of _SYNC_ARCHIVE_TIER_, -1 for an unknown name
+ */
+int sync_archive_tier(const char *name);
+
+/**
+ * Call back for the points of a tier within a time range
+ * @param  [in] dir - the archive directory
+ * @param  [in] tier - one of _SYNC_ARCHIVE_TIER_
+ * @param  [in] card - the card index, -1 for all the cards
+ * @param  [in] from - the first time in us since the Epoch
+ * @param  [in] to - the last time in us since the Epoch
+ * @param  [in] cb - called for every point
+ * @param  [in] arg - passed to cb
+ * @param  [out] stats - the work done, NULL if not needed
+ * @return The number of points passed to cb. Return -1 on failure.
+ */
+long long sync_archive_query(const char *dir, int tier, int card, int64_t from, int64_t to,
+	SYNC_ARCHIVE_CALLBACK cb, void *arg, SYNC_ARCHIVE_STATS *stats);
+
+/**
+ * Print the points of a tier within a time range as CSV, and the compression to stderr
+ * @param  [in] dir - the archive directory
+ * @param  [in] tier - one of _SYNC_ARCHIVE_TIER_
+ * @param  [in] from - the first time in us since the Epoch
+ * @param  [in] to - the last time in us since the Epoch
+ * @param  [in] fp - the output
+ * @return The number of points printed. Return -1 on failure.
+ */
+long long sync_archive_dump(const char *dir, int tier, int64_t from, int64_t to, FILE *fp);
+
+#endif  // __SYNCARCHIVE_H_
@@ -0,0 +1,183 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncConfig.cpp : configuration file of the IRIG-B time sync daemon.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stddef.h>
+
+#include "../mxirig/mxirig.h"
+#include "SyncConfig.h"
+#include "SyncState.h"
+#include "SyncLog.h"
+
+#define CONFIG_LINE_SIZE		256
+
+typedef struct _CONFIG_KEY {
+	const char *name;
+	size_t offset;			/* offset of the int field in SYNC_CONFIG */
+	long min;
+	long max;
+} CONFIG_KEY;
+
+static const CONFIG_KEY keys[] = {
+	{ "phase", offsetof(SYNC_CONFIG, phase), MIN_SAMPLE_PHASE, MAX_SAMPLE_PHASE },
+	{ "rate", offsetof(SYNC_CONFIG, rate), 0, MAX_SAMPLE_RATE },
+	{ "decimation", offsetof(SYNC_CONFIG, decimation), 1, MAX_DECIMATION },
+	{ "signal_type", offsetof(SYNC_CONFIG, signal_type), TYPE_TTL, TYPE_DIFFERENTIAL },
+	{ "inverse", offsetof(SYNC_CONFIG, inverse), 0, 1 },
+	{ "time_source", offsetof(SYNC_CONFIG, time_source), TIMESRC_FREERUN, TIMESRC_PPS },
+	{ "pps_port", offsetof(SYNC_CONFIG, pps_port), PORT_FIBER, PORT_1 },
+	{ "pps_hold", offsetof(SYNC_CONFIG, pps_hold), 0, MAX_PPS_HOLD },
+	{ "pps_timeout", offsetof(SYNC_CONFIG, pps_timeout), 0, MAX_PPS_TIMEOUT },
+	{ "input_delay", offsetof(SYNC_CONFIG, input_delay), 0, MAX_INPUT_DELAY },
+	{ "loopback_port", offsetof(SYNC_CONFIG, loopback_port), 0, PORT_4 },
+	{ "output_delay_1", offsetof(SYNC_CONFIG, output_delay[0]), -MAX_OUTPUT_DELAY, MAX_OUTPUT_DELAY },
+	{ "output_delay_2", offsetof(SYNC_CONFIG, output_delay[1]), -MAX_OUTPUT_DELAY, MAX_OUTPUT_DELAY },
+	{ "output_delay_3", offsetof(SYNC_CONFIG, output_delay[2]), -MAX_OUTPUT_DELAY, MAX_OUTPUT_DELAY },
+	{ "output_delay_4", offsetof(SYNC_CONFIG, output_delay[3]), -MAX_OUTPUT_DELAY, MAX_OUTPUT_DELAY },
+	{ "parity", offsetof(SYNC_CONFIG, parity_mode), 0, 2 },
+	{ "failover", offsetof(SYNC_CONFIG, failover), 0, 1 },
+	{ "accuracy", offsetof(SYNC_CONFIG, accuracy), 0, MAX_MONITOR_LIMIT },
+	{ "tai_offset", offsetof(SYNC_CONFIG, tai_offset), 0, MAX_TAI_OFFSET },
+#ifdef __ENABLE_OUTPUT_FEATURE__
+	{ "output_port", offsetof(SYNC_CONFIG, port_to_output), 1, 4 },
+	{ "output_from", offsetof(SYNC_CONFIG, from_port), 0, 3 },
+	{ "pps_width", offsetof(SYNC_CONFIG, pps_width), 0, 1000 },
+#endif  /* end of __ENABLE_OUTPUT_FEATURE__ */
+};
+
+static char *trim(char *s)
+{
+	char *end;
+
+	while (isspace((unsigned char)*s)) {
+		s++;
+	}
+
+	end = s + strlen(s);
+	while (end > s && isspace((unsigned char)end[-1])) {
+		end--;
+	}
+	*end = '\0';
+
+	return s;
+}
+
+static int parse_line(char *line, SYNC_CONFIG *cfg)
+{
+	char *key, *value, *end;
+	long v;
+	int i;
+
+	value = strchr(line, '=');
+	if (value == NULL) {
+		return -1;
+	}
+	*value++ = '\0';
+	key = trim(line);
+	value = trim(value);
+
+	errno = 0;
+	v = strtol(value, &end, 0);
+	if (errno || end == value || *end != '\0') {
+		return -1;
+	}
+
+	if (strcmp(key, "interval") == 0) {
+		if (v < MIN_TIME_SYNC_INTERVAL || v > MAX_TIME_SYNC_INTERVAL) {
+			return -1;
+		}
+		cfg->interval = v;
+		return 0;
+	}
+
+	for (i = 0; i < (int)(sizeof(keys) / sizeof(keys[0])); i++) {
+		if (strcmp(key, keys[i].name) == 0) {
+			if (v < keys[i].min || v > keys[i].max) {
+				return -1;
+			}
+			*(int *)((char *)cfg + keys[i].offset) = (int)v;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int sync_config_load(const char *path, SYNC_CONFIG *cfg)
+{
+	char line[CONFIG_LINE_SIZE];
+	SYNC_CONFIG tmp = *cfg;
+	char *p;
+	FILE *fp;
+	int n = 0, ret = 0;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		sync_log(LOG_ERR, "Open %s fail: %s", path, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		n++;
+
+		p = strchr(line, '#');
+		if (p != NULL) {
+			*p = '\0';
+		}
+		p = trim(line);
+		if (*p == '\0') {
+			continue;
+		}
+
+		if (parse_line(p, &tmp) < 0) {
+			sync_log(LOG_ERR, "%s:%d: invalid setting", path, n);
+			ret = -1;
+		}
+	}
+	fclose(fp);
+
+	if (ret < 0) {
+		return ret;
+	}
+
+	/* TIMESRC_PPS comes after TIMESRC_UNKNOWN */
+	if (tmp.time_source == TIMESRC_UNKNOWN) {
+		sync_log(LOG_ERR, "%s: time_source %d is unknown", path, TIMESRC_UNKNOWN);
+		return -1;
+	}
+	if (tmp.time_source == TIMESRC_PPS) {
+		tmp.time_source_interface = tmp.pps_port;
+	} else {
+		tmp.time_source_interface = (tmp.time_source == TIMESRC_FIBER) ? PORT_FIBER : PORT_1;
+	}
+
+	/* The Fiber port only accepts the TTL signal */
+	if (tmp.time_source != TIMESRC_FREERUN && tmp.time_source_interface == PORT_FIBER && tmp.signal_type != TYPE_TTL) {
+		sync_log(LOG_ERR, "%s: the Fiber port needs signal_type = 0", path);
+		return -1;
+	}
+	/* The pulses come a second apart */
+	if (tmp.pps_timeout > 0 && tmp.pps_timeout <= 1000) {
+		sync_log(LOG_ERR, "%s: pps_timeout must be over 1000 ms", path);
+		return -1;
+	}
+	/* The samples must fall on the same ns of every second */
+	if (tmp.rate > 0 && 1000000000 % tmp.rate != 0) {
+		sync_log(LOG_ERR, "%s: rate must divide a second in whole ns", path);
+		return -1;
+	}
+	*cfg = tmp;
+
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncConfig.h : configuration file of the IRIG-B time sync daemon.
+ *
+ * The file holds one "key = value" setting per line, '#' starts a comment.
+ * Missing keys keep the value given on the command line. Keys:
+ *   interval     - time sync interval in seconds
+ *   phase        - sample the cards this many ms after the second
+ *   rate         - samples per second, 0 for one sample per interval
+ *   decimation   - samples of rate averaged into one servo update
+ *   signal_type  - 0: TTL, 1: DIFF
+ *   inverse      - 0: normal, 1: inverse the signal
+ *   time_source  - 0: FREERUN, 1: Fiber port, 2: IRIG-B port, 4: PPS
+ *   pps_port     - the port of the PPS input, 0: Fiber port, 1: IRIG-B port
+ *   pps_hold     - PPS input hold time in ms, 0: keep the card setting
+ *   pps_timeout  - PPS input timeout in ms, 0: keep the card setting
+ *   input_delay  - cable delay of the time source in ns, added to the RTC offsets
+ *   loopback_port - measure the input delay in a loopback from this output port, 1 ~ 4, 0: use input_delay
+ *   output_delay_1 ~ output_delay_4 - cable delay of the output ports in ns, a free running RTC leads by their middle
+ *   parity       - 0: EVEN, 1: ODD, 2: NONE
+ *   failover     - 0: disabled, 1: switch between the Fiber and IRIG-B port
+ *   accuracy     - offset limit of the accuracy compliance alarm in ns, 0: no alarm
+ *   tai_offset   - TAI minus UTC in seconds set in the kernel, 0: keep the kernel offset
+ *   output_port, output_from, pps_width - with __ENABLE_OUTPUT_FEATURE__ only
+ */
+
+#ifndef __SYNCCONFIG_H_
+#define __SYNCCONFIG_H_
+
+#define SYNC_CONFIG_PATH		"/etc/ServiceSyncTime.conf"
+#define SYNC_OUTPUT_PORTS		4	/* output ports 1 ~ 4 */
+
+typedef struct _SYNC_CONFIG {
+	long interval;			/* time sync interval in seconds */
+	int phase;			/* sample phase in ms after the second */
+	int rate;			/* samples per second, 0 for one sample per interval */
+	int decimation;			/* samples averaged into one servo update */
+	int signal_type;		/* one of _SIGNAL_TYPE_ */
+	int inverse;
+	int time_source;		/* one of _RTC_SYNC_SOURCE_ */
+	int time_source_interface;	/* the input port of time_source, one of _PORT_LIST_ */
+	int pps_port;			/* the input port of TIMESRC_PPS, PORT_FIBER or PORT_1 */
+	int pps_hold;			/* PPS input hold time in ms, 0 to keep the card setting */
+	int pps_timeout;		/* PPS input timeout in ms, 0 to keep the card setting */
+	int input_delay;		/* cable delay of the time source in ns */
+	int loopback_port;		/* output port of the input delay loopback, 0 to use input_delay */
+	int output_delay[SYNC_OUTPUT_PORTS];	/* cable delay of the output ports 1 ~ 4 in ns */
+	int parity_mode;
+	int failover;			/* switch between the Fiber port and IRIG-B port 1 */
+	int accuracy;			/* offset limit of the compliance alarm in ns, 0 for no alarm */
+	int tai_offset;			/* TAI minus UTC in seconds, 0 to keep the kernel offset */
+#ifdef __ENABLE_OUTPUT_FEATURE__
+	int port_to_output;
+	int from_port;
+	int pps_width;
+#endif  /* end of __ENABLE_OUTPUT_FEATURE__ */
+} SYNC_CONFIG;
+
+/**
+ * Read the configuration file over a configuration
+ * @param  [in] path - the configuration file
+ * @param  [in,out] cfg - the configuration, keys missing in the file are kept
+ * @return If the file is valid, the return value is zero. cfg is unchanged on failure.
+ */
+int sync_config_load(const char *path, SYNC_CONFIG *cfg);
+
+#endif  // __SYNCCONFIG_H_
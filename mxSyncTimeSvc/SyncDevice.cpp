@@ -0,0 +1,1184 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncDevice.cpp : per card sampling threads of the IRIG-B time sync daemon.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/timex.h>
+
+#include "SyncDevice.h"
+#include "SyncMetrics.h"
+#include "SyncLog.h"
+
+#define SYNC_STACK_SIZE			(256 * 1024)	/* stack of a sampling thread */
+#define SYNC_STACK_PREFAULT		(64 * 1024)	/* stack touched before sampling */
+#define LEAP_WINDOW			60		/* IEEE 1344 announces a leap second up to 59 s ahead */
+#define LEAP_SETTLE			2		/* seconds after the leap second the announcement may linger */
+
+const char *sync_status_bit_name[IRIGB_STATUS_BITS] = {
+	"fiber_off_line", "fiber_frame_error", "fiber_parity_error", "fiber_done",
+	"port1_off_line", "port1_frame_error", "port1_parity_error", "port1_done",
+	"pps_timeout", "pps_done", "irig_encoder_done", "pps_encoder_done"
+};
+
+typedef struct _SYNC_SAMPLE {
+	DWORD signal_status[SYNC_INPUT_MAX];
+	BOOL decoders_valid;
+	IRIGB_DECODERS decoders;	/* the frames and counters of both decoders */
+	long long decoders_local;	/* system time of the decoder read in ns */
+	DWORD pps_status;		/* the PPS decoder, one of _IRIG_SIGNAL_STATUS_ */
+	int read_errors;
+	DWORD tears;			/* RTC reads discarded for straddling a second */
+	BOOL rtc_valid;
+	RTCTIME rtctime;		/* the RTC time, its time quality and leap second bits */
+	long long rtc;			/* RTC time in ns */
+	long long t1;			/* system time before the RTC read in ns */
+	long long local;		/* system time of the RTC read in ns */
+	long long offset;		/* RTC time minus system time in ns */
+	long long latency;		/* RTC read ioctl duration in ns */
+	struct timespec t2;		/* system time after the RTC read */
+} SYNC_SAMPLE;
+
+long long timespec_to_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+/* Days since 1970-01-01 of a proleptic Gregorian date */
+static long long days_from_civil(int year, int mon, int mday)
+{
+	long long era, yoe, doy, doe;
+
+	year -= (mon <= 2);
+	era = (year >= 0 ? year : year - 399) / 400;
+	yoe = year - era * 400;
+	doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + mday - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+/* Convert the IRIG-B RTC time, which keeps the local time, into system time in ns.
+ * The time zone offset only changes on an hour, mktime() runs once per RTC hour. */
+static long long rtc_to_ns(SYNC_DEVICE *dev, PRTCTIME rtc)
+{
+	long long local;
+	struct tm tm;
+	time_t utc;
+
+	/* The inserted leap second 23:59:60 is a second 23:59:59 in the kernel */
+	local = days_from_civil(rtc->year, rtc->mon, rtc->mday) * 86400LL +
+		rtc->hour * 3600 + rtc->min * 60 + (rtc->sec < 60 ? rtc->sec : 59);
+
+	if (local / 3600 != dev->tz_hour) {
+		memset(&tm, 0, sizeof(tm));
+		tm.tm_year = rtc->year - 1900;
+		tm.tm_mon = rtc->mon - 1;
+		tm.tm_mday = rtc->mday;
+		tm.tm_hour = rtc->hour;
+		tm.tm_isdst = -1;
+		utc = mktime(&tm);
+		dev->tz_hour = local / 3600;
+		dev->tz_offset = (long)(dev->tz_hour * 3600 - utc);
+	}
+
+	return (local - dev->tz_offset) * NSEC_PER_SEC + rtc->nanosec;
+}
+
+double sync_get_frequency(void)
+{
+	struct timex tx;
+
+	memset(&tx, 0, sizeof(tx));
+	if (adjtimex(&tx) < 0) {
+		return 0.0;
+	}
+
+	return tx.freq / 65.536;
+}
+
+/* Set the frequency adjustment of the system clock in ppb */
+static int set_frequency(double ppb)
+{
+	struct timex tx;
+
+	memset(&tx, 0, sizeof(tx));
+	tx.modes = ADJ_FREQUENCY;
+	tx.freq = (long)(ppb * 65.536);
+
+	return adjtimex(&tx);
+}
+
+/* Arm or disarm the leap second of the kernel, return the TAI offset it keeps */
+static int set_leap(int leap, int *tai)
+{
+	struct timex tx;
+
+	memset(&tx, 0, sizeof(tx));
+	if (adjtimex(&tx) < 0) {
+		return -1;
+	}
+	tx.modes = ADJ_STATUS;
+	tx.status = (tx.status & ~(STA_INS | STA_DEL)) | leap;
+	if (adjtimex(&tx) < 0) {
+		return -1;
+	}
+	*tai = tx.tai;
+
+	return 0;
+}
+
+/* Step the system clock by offset ns */
+static int step_clock(long long offset)
+{
+	struct timespec ts;
+	long long now;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	now = timespec_to_ns(&ts) + offset;
+	ts.tv_sec = now / NSEC_PER_SEC;
+	ts.tv_nsec = now % NSEC_PER_SEC;
+	if (ts.tv_nsec < 0) {
+		ts.tv_sec--;
+		ts.tv_nsec += NSEC_PER_SEC;
+	}
+
+	return clock_settime(CLOCK_REALTIME, &ts);
+}
+
+/* Read the frames and signal status of both decoders without holding the state lock */
+static void read_status(HANDLE hDev, SYNC_SAMPLE *s)
+{
+	struct timespec t1, t2;
+
+	s->read_errors = 0;
+	clock_gettime(CLOCK_REALTIME, &t1);
+	s->decoders_valid = mxIrigbGetDecoders(hDev, &s->decoders);
+	clock_gettime(CLOCK_REALTIME, &t2);
+	s->decoders_local = timespec_to_ns(&t1) + (timespec_to_ns(&t2) - timespec_to_ns(&t1)) / 2;
+	if (!s->decoders_valid) {
+		s->signal_status[SYNC_INPUT_FIBER] = IRIG_STATUS_UNKNOWN;
+		s->signal_status[SYNC_INPUT_PORT1] = IRIG_STATUS_UNKNOWN;
+		s->pps_status = IRIG_STATUS_UNKNOWN;
+		s->read_errors++;
+		return;
+	}
+	s->signal_status[SYNC_INPUT_FIBER] = s->decoders.status[SYNC_INPUT_FIBER];
+	s->signal_status[SYNC_INPUT_PORT1] = s->decoders.status[SYNC_INPUT_PORT1];
+	s->pps_status = s->decoders.ppsStatus;
+}
+
+/* Read the RTC without holding the state lock */
+static void read_rtc(SYNC_DEVICE *dev, SYNC_SAMPLE *s)
+{
+	struct timespec t1;
+
+	/* Bracket the RTC read with the system time */
+	s->tears = 0;
+	clock_gettime(CLOCK_REALTIME, &t1);
+	s->rtc_valid = mxIrigbGetTimeEx(dev->hDev, &s->rtctime, &s->tears);
+	clock_gettime(CLOCK_REALTIME, &s->t2);
+	if (!s->rtc_valid) {
+		SYNC_LOG(LOG_ERR, "mxIrigbGetTimeEx() fail");
+		s->read_errors++;
+		return;
+	}
+
+	s->t1 = timespec_to_ns(&t1);
+	s->latency = timespec_to_ns(&s->t2) - s->t1;
+	s->local = s->t1 + s->latency / 2;
+	s->rtc = rtc_to_ns(dev, &s->rtctime);
+	s->offset = s->rtc - s->local;
+}
+
+static void holdover_end(SYNC_STATE *state)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	state->holdover_total += (now.tv_sec - state->holdover_start.tv_sec) +
+		(now.tv_nsec - state->holdover_start.tv_nsec) / 1e9;
+}
+
+/* Relearn the offset but keep the frequency estimate */
+static void restart_servo(SYNC_STATE *state)
+{
+	if (state->servo.state == SERVO_HOLDOVER) {
+		holdover_end(state);
+	}
+	servo_reset(&state->servo);
+	state->decimator.count = 0;
+}
+
+/* The servo interval in seconds, the time between two servo updates */
+static double servo_interval(SYNC_STATE *state)
+{
+	if (state->rate > 0) {
+		return (double)state->decimation / state->rate;
+	}
+
+	return state->interval;
+}
+
+/* The time between two RTC samples in ns */
+static long long sample_period(SYNC_STATE *state)
+{
+	if (state->rate > 0) {
+		return NSEC_PER_SEC / state->rate;
+	}
+
+	return state->interval * NSEC_PER_SEC;
+}
+
+/* Sum a sample, return nonzero with the mean offset and time once factor samples are summed */
+static int decimate(SYNC_DECIMATOR *d, int factor, const SYNC_SAMPLE *s, long long *offset, long long *local)
+{
+	if (d->count == 0) {
+		d->offset_sum = 0;
+		d->local_first = s->local;
+		d->local_sum = 0;
+	}
+
+	d->offset_sum += s->offset;
+	d->local_sum += s->local - d->local_first;
+	if (++d->count < factor) {
+		return 0;
+	}
+
+	*offset = d->offset_sum / d->count;
+	*local = d->local_first + d->local_sum / d->count;
+	d->count = 0;
+
+	return 1;
+}
+
+/* Keep the reference while it is healthy, else take the first healthy card */
+static void select_reference(SYNC_STATE *state)
+{
+	int i, reference = state->reference;
+
+	if (reference >= 0 && state->device[reference].healthy) {
+		return;
+	}
+
+	for (i = 0; i < state->device_count; i++) {
+		if (state->device[i].healthy) {
+			reference = i;
+			break;
+		}
+	}
+
+	if (reference == state->reference) {
+		return;
+	}
+
+	if (state->reference >= 0) {
+		SYNC_LOG(LOG_NOTICE, "Reference changes from card %d to card %d",
+			state->device[state->reference].index, state->device[reference].index);
+		state->reference_changes++;
+	}
+	state->reference = reference;
+
+	/* The new card has its own phase, relearn the offset */
+	restart_servo(state);
+}
+
+/* Arm the kernel for the leap second the reference announces. The kernel repeats or
+ * skips 23:59:59 at the end of the UTC day on time, the servo sees no offset step. */
+static void schedule_leap(SYNC_STATE *state, SYNC_DEVICE *dev, SYNC_SAMPLE *s)
+{
+	long long day_sec;
+	int leap, tai;
+
+	if (!s->rtc_valid) {
+		return;
+	}
+
+	day_sec = (s->rtc / NSEC_PER_SEC) % 86400;
+	if (day_sec >= 86400 - LEAP_WINDOW) {
+		/* Keep an armed leap second through a signal loss in the last minute */
+		if (!dev->healthy) {
+			return;
+		}
+		leap = !s->rtctime.lsp ? 0 : (s->rtctime.ls ? STA_DEL : STA_INS);
+	} else if (day_sec < LEAP_SETTLE) {
+		return;
+	} else {
+		leap = 0;
+	}
+
+	if (leap == state->leap) {
+		return;
+	}
+	if (set_leap(leap, &tai) < 0) {
+		SYNC_LOG(LOG_ERR, "adjtimex() fail");
+		state->sync_errors++;
+		return;
+	}
+
+	if (leap) {
+		SYNC_LOG(LOG_NOTICE, "Leap second %s at the end of the UTC day is scheduled",
+			leap == STA_INS ? "insertion" : "deletion");
+	} else if (day_sec >= 86400 - LEAP_WINDOW) {
+		SYNC_LOG(LOG_NOTICE, "Leap second is cancelled by card %d", dev->index);
+	} else {
+		SYNC_LOG(LOG_NOTICE, "Leap second %s is done, TAI - UTC = %d s",
+			state->leap == STA_INS ? "insertion" : "deletion", tai);
+	}
+	state->leap = leap;
+	state->tai_offset = tai;
+}
+
+/* Discipline the system clock with the reference sample */
+static void discipline(SYNC_STATE *state, SYNC_DEVICE *dev, SYNC_SAMPLE *s)
+{
+	int holdover = !dev->healthy;
+	long long offset, local;
+	double ppb;
+
+	schedule_leap(state, dev, s);
+
+	/* Without the IRIG-B signal the RTC is free running, keep the last frequency.
+	 * An unreadable RTC is not healthy either. */
+	if (holdover && state->servo.state != SERVO_HOLDOVER) {
+		clock_gettime(CLOCK_MONOTONIC, &state->holdover_start);
+	} else if (!holdover && state->servo.state == SERVO_HOLDOVER) {
+		holdover_end(state);
+	}
+
+	servo_holdover(&state->servo, holdover);
+	if (holdover) {
+		state->decimator.count = 0;
+		return;
+	}
+
+	/* Average the samples of a high rate into one servo update */
+	if (!decimate(&state->decimator, state->rate > 0 ? state->decimation : 1, s, &offset, &local)) {
+		return;
+	}
+
+	ppb = servo_sample(&state->servo, offset, local);
+
+	if (state->servo.state == SERVO_JUMP) {
+		if (step_clock(offset) < 0) {
+			SYNC_LOG(LOG_ERR, "clock_settime() fail");
+			state->sync_errors++;
+			return;
+		}
+		state->steps++;
+	}
+
+	if (set_frequency(ppb) < 0) {
+		SYNC_LOG(LOG_ERR, "adjtimex() fail");
+		state->sync_errors++;
+		return;
+	}
+	state->freq = ppb;
+	state->last_sync = s->t2;
+}
+
+/* The RTC follows a normal input, or runs free on purpose */
+static int source_healthy(SYNC_DEVICE *dev)
+{
+	if (dev->time_source == TIMESRC_FIBER || dev->time_source == TIMESRC_PORT1) {
+		return dev->signal_status[SOURCE_INPUT(dev->time_source)] == IRIG_STATUS_NORMAL;
+	}
+	if (dev->time_source == TIMESRC_PPS) {
+		return dev->pps_status == IRIG_STATUS_NORMAL;
+	}
+
+	return 1;
+}
+
+/* The reference RTC changes its phase, relearn the offset but keep the frequency */
+static void reset_reference(SYNC_STATE *state, SYNC_DEVICE *dev)
+{
+	if (state->reference < 0 || &state->device[state->reference] != dev) {
+		return;
+	}
+
+	restart_servo(state);
+}
+
+/* Switch the RTC to the best decoder, called with the state lock held */
+static void select_source(SYNC_STATE *state, SYNC_DEVICE *dev, SYNC_SAMPLE *s)
+{
+	struct timespec now;
+	int src;
+
+	dev->signal_status[SYNC_INPUT_FIBER] = s->signal_status[SYNC_INPUT_FIBER];
+	dev->signal_status[SYNC_INPUT_PORT1] = s->signal_status[SYNC_INPUT_PORT1];
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	src = source_update(&dev->source, s->signal_status, &now);
+	if (src == dev->time_source) {
+		return;
+	}
+
+	/* A single RTCCON write, keep it under the lock */
+	if (!mxIrigbSetSyncTimeSrc(dev->hDev, src)) {
+		SYNC_LOG(LOG_ERR, "Card %d: mxIrigbSetSyncTimeSrc() time_source:%d fail", dev->index, src);
+		dev->read_errors++;
+		return;
+	}
+
+	SYNC_LOG(LOG_NOTICE, "Card %d: time source changes from %d to %d", dev->index, dev->time_source, src);
+	source_switched(&dev->source, src, &now);
+	dev->time_source = src;
+	dev->healthy = source_healthy(dev);
+
+	/* The RTC phase follows the new decoder, relearn the offset */
+	reset_reference(state, dev);
+}
+
+/* Supervise the PPS input the RTC follows, called with the state lock held */
+static void pps_check(SYNC_DEVICE *dev, SYNC_SAMPLE *s)
+{
+	dev->pps_status = s->pps_status;
+	if (dev->time_source != TIMESRC_PPS) {
+		dev->pps_lost = 0;
+		return;
+	}
+
+	if (s->pps_status == IRIG_STATUS_OFF_LINE && !dev->pps_lost) {
+		dev->pps_lost = 1;
+		dev->pps_timeouts++;
+		SYNC_LOG(LOG_WARNING, "Card %d: the PPS input timed out", dev->index);
+	} else if (s->pps_status == IRIG_STATUS_NORMAL && dev->pps_lost) {
+		dev->pps_lost = 0;
+		SYNC_LOG(LOG_NOTICE, "Card %d: the PPS input is back", dev->index);
+	}
+}
+
+/* The pulse only gives the RTC its phase, the seconds are the ones of the system time.
+ * Set the RTC seconds when they are whole seconds off, the sample keeps the phase of the pulse.
+ * A sample whose seconds cannot be set is dropped: the servo would step the system time onto
+ * RTC seconds without a source, and the error would never show again.
+ * Called with the state lock held, so no reload changes the time source meanwhile. */
+static void pps_seconds(SYNC_DEVICE *dev, SYNC_SAMPLE *s)
+{
+	RTCTIME rtc;
+	struct tm tm;
+	time_t t;
+	long long k;
+
+	if (dev->time_source != TIMESRC_PPS || !s->rtc_valid || llabs(s->offset) < PPS_SECONDS_LIMIT) {
+		return;
+	}
+	/* The write must land in the RTC second it is computed for, a leap second waits */
+	if (s->rtctime.nanosec > PPS_SECONDS_WINDOW || s->rtctime.sec > 59) {
+		SYNC_LOG(LOG_INFO, "Card %d: RTC seconds off by %lld ns, the sample is dropped until they are set",
+			dev->index, s->offset);
+		s->rtc_valid = 0;
+		return;
+	}
+
+	k = (s->offset + (s->offset > 0 ? NSEC_PER_SEC : -NSEC_PER_SEC) / 2) / NSEC_PER_SEC;
+	t = (time_t)(days_from_civil(s->rtctime.year, s->rtctime.mon, s->rtctime.mday) * 86400LL +
+		s->rtctime.hour * 3600 + s->rtctime.min * 60 + s->rtctime.sec - k);
+	gmtime_r(&t, &tm);
+
+	rtc = s->rtctime;
+	rtc.year = tm.tm_year + 1900;
+	rtc.mon = tm.tm_mon + 1;
+	rtc.mday = tm.tm_mday;
+	rtc.hour = tm.tm_hour;
+	rtc.min = tm.tm_min;
+	rtc.sec = tm.tm_sec;
+	if (!mxIrigbSetTime(dev->hDev, &rtc)) {
+		SYNC_LOG(LOG_ERR, "Card %d: mxIrigbSetTime() fail", dev->index);
+		s->read_errors++;
+		s->rtc_valid = 0;
+		return;
+	}
+
+	dev->pps_seconds_set++;
+	SYNC_LOG(LOG_NOTICE, "Card %d: RTC seconds set %+lld s from the system time", dev->index, -k);
+	s->rtctime = rtc;
+	s->rtc -= k * NSEC_PER_SEC;
+	s->offset -= k * NSEC_PER_SEC;
+}
+
+/* The signal time of a decoder at the read in ns, -1 without a valid frame */
+static long long signal_time(const IRIGB_DECODERS *d, int input)
+{
+	if (d->status[input] != IRIG_STATUS_NORMAL || !d->frameValid[input] || d->frame[input].elapsed < 0) {
+		return -1;
+	}
+
+	/* The frame started a second before the reference marker the counter runs from */
+	return (d->frame[input].epoch + 1) * NSEC_PER_SEC + d->frame[input].elapsed;
+}
+
+/* Compare the signal times of the Fiber and port 1 decoders, called with the state lock held.
+ * Both counters are read in one ioctl, so a frame latched by one decoder only still
+ * compares right; a mismatch takes DECODER_MISMATCH_COUNT consecutive polls. */
+static void compare_decoders(SYNC_STATE *state, SYNC_DEVICE *dev, SYNC_SAMPLE *s)
+{
+	long long fiber, port1, limit;
+
+	fiber = s->decoders_valid ? signal_time(&s->decoders, SYNC_INPUT_FIBER) : -1;
+	port1 = s->decoders_valid ? signal_time(&s->decoders, SYNC_INPUT_PORT1) : -1;
+	dev->decoder_elapsed[SYNC_INPUT_FIBER] = s->decoders_valid ? s->decoders.frame[SYNC_INPUT_FIBER].elapsed : -1;
+	dev->decoder_elapsed[SYNC_INPUT_PORT1] = s->decoders_valid ? s->decoders.frame[SYNC_INPUT_PORT1].elapsed : -1;
+
+	/* Without both references there is nothing to cross-check */
+	dev->decoder_valid = (fiber >= 0 && port1 >= 0);
+	if (!dev->decoder_valid) {
+		dev->decoder_bad = 0;
+		return;
+	}
+
+	limit = (state->accuracy > 0) ? state->accuracy : DECODER_MISMATCH_LIMIT;
+	dev->decoder_diff = port1 - fiber;
+	if (llabs(dev->decoder_diff) <= limit) {
+		dev->decoder_bad = 0;
+		if (dev->decoder_mismatch) {
+			dev->decoder_mismatch = 0;
+			SYNC_LOG(LOG_NOTICE, "Card %d: the Fiber and port 1 decoders agree again", dev->index);
+		}
+		return;
+	}
+
+	if (++dev->decoder_bad >= DECODER_MISMATCH_COUNT && !dev->decoder_mismatch) {
+		dev->decoder_mismatch = 1;
+		dev->decoder_mismatches++;
+		SYNC_LOG(LOG_WARNING, "Card %d: the port 1 decoder is %lld ns from the Fiber decoder, limit %lld ns",
+			dev->index, dev->decoder_diff, limit);
+	}
+}
+
+/* Measure the RTC against the decoder it follows, called with the state lock held */
+static void decoder_phase(SYNC_DEVICE *dev, SYNC_SAMPLE *s)
+{
+	long long t;
+
+	dev->decoder_phase_valid = 0;
+	if (!s->rtc_valid || !s->decoders_valid ||
+		(dev->time_source != TIMESRC_FIBER && dev->time_source != TIMESRC_PORT1)) {
+		return;
+	}
+	t = signal_time(&s->decoders, SOURCE_INPUT(dev->time_source));
+	if (t < 0) {
+		return;
+	}
+
+	/* Both are relative to the system clock, read apart */
+	dev->decoder_phase = s->offset - dev->input_delay - (t - s->decoders_local);
+	dev->decoder_phase_valid = 1;
+}
+
+/* Queue a sample for the journal writer, called with the state lock held */
+static void journal_sample(SYNC_STATE *state, SYNC_DEVICE *dev, SYNC_SAMPLE *s)
+{
+	SYNC_RECORD r;
+
+	memset(&r, 0, sizeof(r));
+	r.card = dev->index;
+	r.signal_status = (s->signal_status[SYNC_INPUT_FIBER] & 0xf) | ((s->signal_status[SYNC_INPUT_PORT1] & 0xf) << 4);
+	r.servo_state = state->servo.state;
+	r.time_source = dev->time_source;
+	r.freq = (int32_t)(state->freq * 1000);
+	if (dev->healthy) {
+		r.flags |= SYNC_RECORD_HEALTHY;
+	}
+	if (state->reference >= 0 && &state->device[state->reference] == dev) {
+		r.flags |= SYNC_RECORD_REFERENCE;
+	}
+	if (dev->monitor.alarm) {
+		r.flags |= SYNC_RECORD_ALARM;
+	}
+	if (s->rtc_valid) {
+		r.flags |= SYNC_RECORD_RTC_VALID;
+		r.rtc = s->rtc;
+		r.t1 = s->t1;
+		r.latency = (int32_t)s->latency;
+		r.tq = s->rtctime.tq;
+	}
+
+	sync_journal_queue(&r);
+}
+
+/* Check the sample against the accuracy limit, called with the state lock held */
+static void monitor_check(SYNC_STATE *state, SYNC_DEVICE *dev, SYNC_SAMPLE *s)
+{
+	struct timespec now;
+	int changed;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	changed = monitor_sample(&dev->monitor, timespec_to_ns(&now), s->rtc_valid, dev->healthy, s->offset, state->accuracy);
+	if (changed == 0) {
+		return;
+	}
+
+	if (dev->monitor.alarm & changed) {
+		SYNC_LOG(LOG_WARNING, "Card %d: accuracy alarm, %s, limit %lld ns", dev->index,
+			(dev->monitor.alarm & changed & MONITOR_ALARM_SOURCE) ? "no valid time source" : "offset beyond the limit",
+			state->accuracy);
+	} else if (dev->monitor.alarm == 0) {
+		SYNC_LOG(LOG_NOTICE, "Card %d: accuracy alarm cleared, max |offset| %lld ns in %d s", dev->index,
+			monitor_max_abs(&dev->monitor, 1), sync_monitor_windows[1]);
+	}
+}
+
+/* Account a sample, called with the state lock held */
+static void apply_sample(SYNC_STATE *state, SYNC_DEVICE *dev, SYNC_SAMPLE *s)
+{
+	int healthy;
+
+	dev->signal_status[SYNC_INPUT_FIBER] = s->signal_status[SYNC_INPUT_FIBER];
+	dev->signal_status[SYNC_INPUT_PORT1] = s->signal_status[SYNC_INPUT_PORT1];
+	dev->status_count[SYNC_INPUT_FIBER][s->signal_status[SYNC_INPUT_FIBER]]++;
+	dev->status_count[SYNC_INPUT_PORT1][s->signal_status[SYNC_INPUT_PORT1]]++;
+	dev->read_errors += s->read_errors;
+	dev->rtc_tears += s->tears;
+
+	if (!s->rtc_valid) {
+		healthy = 0;
+	} else {
+		/* The RTC follows the input edge, which arrives the cable delay late.
+		 * Running free it leads by the output advance, the encoder outputs arrive on time. */
+		if (dev->time_source != TIMESRC_FREERUN) {
+			s->rtc += dev->input_delay;
+			s->offset += dev->input_delay;
+		} else {
+			s->rtc -= dev->output_advance;
+			s->offset -= dev->output_advance;
+		}
+
+		dev->samples++;
+		dev->offset = s->offset;
+		dev->last_sample = s->t2;
+		dev->rtc = s->rtctime;
+		sync_histogram_add(&dev->latency_hist, sync_latency_bounds, s->latency / 1e9);
+		sync_histogram_add(&dev->offset_hist, sync_offset_bounds, llabs(s->offset) / 1e9);
+
+		healthy = source_healthy(dev);
+	}
+	decoder_phase(dev, s);
+	dev->rtc_valid = s->rtc_valid;
+
+	/* The holdover of the card starts when its time source is lost */
+	if (healthy) {
+		dev->synced = 1;
+	} else if (dev->healthy || dev->lost_since.tv_sec == 0) {
+		clock_gettime(CLOCK_MONOTONIC, &dev->lost_since);
+	}
+	dev->healthy = healthy;
+
+	select_reference(state);
+
+	/* An unhealthy reference means no card is healthy, discipline() holds over */
+	if (state->reference >= 0 && &state->device[state->reference] == dev) {
+		discipline(state, dev, s);
+	}
+
+	monitor_check(state, dev, s);
+
+	if (state->journal) {
+		journal_sample(state, dev, s);
+	}
+}
+
+/* Take a new input delay, called with the state lock held */
+static void set_input_delay(SYNC_STATE *state, SYNC_DEVICE *dev, long long input_delay)
+{
+	if (dev->input_delay != input_delay) {
+		sync_log(LOG_NOTICE, "Card %d: input delay changes from %lld to %lld ns", dev->index,
+			dev->input_delay, input_delay);
+		dev->input_delay = input_delay;
+		reset_reference(state, dev);
+	}
+}
+
+/* Run the requested loopback without the lock, the card is not sampled meanwhile */
+static void device_loopback(SYNC_STATE *state, SYNC_DEVICE *dev)
+{
+	int port = dev->loopback_port;
+	DWORD input = dev->loopback_input;
+	long long fallback = dev->loopback_fallback;
+	long long input_delay;
+
+	dev->loopback_port = 0;
+	pthread_mutex_unlock(&state->lock);
+	input_delay = sync_device_loopback(dev->hDev, dev->index, port, input, fallback);
+	pthread_mutex_lock(&state->lock);
+
+	set_input_delay(state, dev, input_delay);
+}
+
+/* Touch the stack once, a real-time thread must not page fault while sampling */
+static void prefault_stack(void)
+{
+	volatile char stack[SYNC_STACK_PREFAULT];
+
+	memset((char *)stack, 0, sizeof(stack));
+}
+
+/* The monotonic time of the next multiple of period in system time, plus the phase.
+ * The wait runs on CLOCK_MONOTONIC to stay interruptible by a resync, the phase follows
+ * the disciplined clock and is computed again for every wait. */
+static void next_phase(const struct timespec *mono, const struct timespec *real,
+	long long period, long phase, struct timespec *deadline)
+{
+	long long now = timespec_to_ns(real);
+	long long target;
+
+	target = now - (now - phase) % period;
+	/* A wake up a little early must not take the same period twice */
+	while (target < now + period / 2) {
+		target += period;
+	}
+
+	target += timespec_to_ns(mono) - now;
+	deadline->tv_sec = target / NSEC_PER_SEC;
+	deadline->tv_nsec = target % NSEC_PER_SEC;
+}
+
+static void *device_thread(void *arg)
+{
+	SYNC_DEVICE *dev = (SYNC_DEVICE *)arg;
+	SYNC_STATE *state = dev->state;
+	struct timespec now, real, next_sample, next_poll, *deadline;
+	SYNC_SAMPLE sample;
+	long long late;
+	int sample_due, timed_out;
+
+	prefault_stack();
+
+	clock_gettime(CLOCK_MONOTONIC, &next_sample);
+	next_poll = next_sample;
+
+	pthread_mutex_lock(&state->lock);
+	while (!state->stopping) {
+		/* Delay for the time sync interval unless a resync is requested.
+		 * The failover and the PPS supervision poll the decoders more often. */
+		deadline = &next_sample;
+		if ((dev->source.enabled || dev->time_source == TIMESRC_PPS) &&
+			timespec_to_ns(&next_poll) < timespec_to_ns(&next_sample)) {
+			deadline = &next_poll;
+		}
+		timed_out = 0;
+		while (!state->stopping && !dev->resync_request && !dev->loopback_port) {
+			if (pthread_cond_timedwait(&state->wakeup, &state->lock, deadline) == ETIMEDOUT) {
+				timed_out = 1;
+				break;
+			}
+		}
+		if (state->stopping) {
+			break;
+		}
+
+		/* The samples resume right after the loopback */
+		if (dev->loopback_port) {
+			device_loopback(state, dev);
+			continue;
+		}
+
+		/* How late the scheduler let the thread run after its deadline */
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (timed_out) {
+			late = timespec_to_ns(&now) - timespec_to_ns(deadline);
+			if (late < 0) {
+				late = 0;
+			}
+			sync_histogram_add(&dev->wakeup_hist, sync_wakeup_bounds, late / 1e9);
+			if (late > dev->wakeup_max) {
+				dev->wakeup_max = late;
+			}
+		}
+		sample_due = dev->resync_request || timespec_to_ns(&now) >= timespec_to_ns(&next_sample);
+		dev->resync_request = 0;
+		pthread_mutex_unlock(&state->lock);
+
+		read_status(dev->hDev, &sample);
+		if (sample_due) {
+			read_rtc(dev, &sample);
+		}
+
+		pthread_mutex_lock(&state->lock);
+		if (sample.decoders_valid) {
+			mxIrigbCountStatus(sample.decoders.intsts, &dev->status_events);
+		}
+		select_source(state, dev, &sample);
+		compare_decoders(state, dev, &sample);
+		pps_check(dev, &sample);
+		if (sample_due) {
+			pps_seconds(dev, &sample);
+			apply_sample(state, dev, &sample);
+		} else {
+			dev->read_errors += sample.read_errors;
+		}
+
+		/* Both schedules share the phase, a poll and a sample in the same second wake once */
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		clock_gettime(CLOCK_REALTIME, &real);
+		if (sample_due) {
+			next_phase(&now, &real, sample_period(state), state->phase, &next_sample);
+		}
+		next_phase(&now, &real, SOURCE_POLL_INTERVAL * NSEC_PER_SEC, state->phase, &next_poll);
+	}
+	pthread_mutex_unlock(&state->lock);
+
+	return NULL;
+}
+
+int sync_state_init(SYNC_STATE *state, long interval)
+{
+	pthread_mutexattr_t mattr;
+	pthread_condattr_t attr;
+
+	memset(state, 0, sizeof(*state));
+	state->interval = interval;
+	state->decimation = 1;
+	state->phase = DEFAULT_SAMPLE_PHASE * 1000000L;
+	state->reference = -1;
+	state->freq = sync_get_frequency();
+	servo_init(&state->servo, state->freq, servo_interval(state));
+
+	/* A real-time sampling thread must not wait behind a preempted reporter */
+	pthread_mutexattr_init(&mattr);
+	pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
+	if (pthread_mutex_init(&state->lock, &mattr) != 0) {
+		pthread_mutexattr_destroy(&mattr);
+		return -1;
+	}
+	pthread_mutexattr_destroy(&mattr);
+
+	/* The sampling schedule must not follow the system clock it adjusts */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	if (pthread_cond_init(&state->wakeup, &attr) != 0) {
+		pthread_condattr_destroy(&attr);
+		pthread_mutex_destroy(&state->lock);
+		return -1;
+	}
+	pthread_condattr_destroy(&attr);
+
+	return 0;
+}
+
+void sync_state_snapshot(SYNC_STATE *state, SYNC_STATE *copy)
+{
+	pthread_mutex_lock(&state->lock);
+	memcpy(copy, state, sizeof(*copy));
+	pthread_mutex_unlock(&state->lock);
+}
+
+int sync_state_set_interval(SYNC_STATE *state, long interval)
+{
+	if (interval < MIN_TIME_SYNC_INTERVAL || interval > MAX_TIME_SYNC_INTERVAL) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&state->lock);
+	state->interval = interval;
+	servo_set_interval(&state->servo, servo_interval(state));
+	pthread_mutex_unlock(&state->lock);
+
+	/* Let the sampling threads reschedule from now */
+	sync_state_resync(state);
+
+	return 0;
+}
+
+int sync_state_set_rate(SYNC_STATE *state, int rate, int decimation)
+{
+	/* The samples must fall on the same ns of every second */
+	if (rate < 0 || rate > MAX_SAMPLE_RATE || (rate > 0 && NSEC_PER_SEC % rate != 0)) {
+		return -1;
+	}
+	if (decimation < 1 || decimation > MAX_DECIMATION) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&state->lock);
+	state->rate = rate;
+	state->decimation = decimation;
+	state->decimator.count = 0;
+	servo_set_interval(&state->servo, servo_interval(state));
+	pthread_mutex_unlock(&state->lock);
+
+	/* Let the sampling threads reschedule from now */
+	sync_state_resync(state);
+
+	return 0;
+}
+
+int sync_state_set_phase(SYNC_STATE *state, long phase)
+{
+	if (phase < MIN_SAMPLE_PHASE || phase > MAX_SAMPLE_PHASE) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&state->lock);
+	state->phase = phase * 1000000L;
+	pthread_mutex_unlock(&state->lock);
+
+	/* Let the sampling threads align to the new phase */
+	sync_state_resync(state);
+
+	return 0;
+}
+
+int sync_state_set_accuracy(SYNC_STATE *state, long long limit)
+{
+	if (limit < 0 || limit > MAX_MONITOR_LIMIT) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&state->lock);
+	state->accuracy = limit;
+	pthread_mutex_unlock(&state->lock);
+
+	return 0;
+}
+
+int sync_state_set_tai(SYNC_STATE *state, int tai)
+{
+	struct timex tx;
+	int current;
+
+	if (tai < 0 || tai > MAX_TAI_OFFSET) {
+		return -1;
+	}
+
+	memset(&tx, 0, sizeof(tx));
+	if (adjtimex(&tx) < 0) {
+		return -1;
+	}
+	current = tx.tai;
+
+	/* The kernel counts the leap seconds it applies, a stale configuration is behind */
+	if (tai > current) {
+		tx.modes = ADJ_TAI;
+		tx.constant = tai;
+		if (adjtimex(&tx) < 0) {
+			return -1;
+		}
+		sync_log(LOG_INFO, "TAI - UTC changes from %d s to %d s", current, tai);
+		current = tai;
+	}
+
+	pthread_mutex_lock(&state->lock);
+	state->tai_offset = current;
+	pthread_mutex_unlock(&state->lock);
+
+	return 0;
+}
+
+void sync_state_resync(SYNC_STATE *state)
+{
+	int i;
+
+	pthread_mutex_lock(&state->lock);
+	for (i = 0; i < state->device_count; i++) {
+		state->device[i].resync_request = 1;
+	}
+	pthread_cond_broadcast(&state->wakeup);
+	pthread_mutex_unlock(&state->lock);
+}
+
+static int create_thread(SYNC_STATE *state, SYNC_DEVICE *dev)
+{
+	pthread_attr_t attr;
+	struct sched_param param;
+	int ret;
+
+	/* A small fixed stack, mlockall() locks all of it */
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, SYNC_STACK_SIZE);
+	if (state->rt_priority > 0) {
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = state->rt_priority;
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &param);
+	}
+	if (CPU_COUNT(&state->rt_cpus) > 0) {
+		pthread_attr_setaffinity_np(&attr, sizeof(state->rt_cpus), &state->rt_cpus);
+	}
+
+	ret = pthread_create(&dev->thread, &attr, device_thread, dev);
+	pthread_attr_destroy(&attr);
+
+	return ret;
+}
+
+int sync_device_start(SYNC_STATE *state, int index, HANDLE hDev, DWORD hwid, int time_source, int failover,
+	long long input_delay, long long output_advance)
+{
+	SYNC_DEVICE *dev;
+	sigset_t all, old;
+	int ret;
+
+	pthread_mutex_lock(&state->lock);
+	if (state->device_count >= SYNC_MAX_DEVICES) {
+		pthread_mutex_unlock(&state->lock);
+		return -1;
+	}
+
+	dev = &state->device[state->device_count];
+	memset(dev, 0, sizeof(*dev));
+	dev->state = state;
+	dev->index = index;
+	dev->hDev = hDev;
+	dev->hwid = hwid;
+	dev->tz_hour = -1;
+	dev->time_source = time_source;
+	dev->input_delay = input_delay;
+	dev->output_advance = output_advance;
+	source_init(&dev->source, time_source, failover);
+	monitor_init(&dev->monitor);
+	dev->resync_request = 1;
+	dev->signal_status[SYNC_INPUT_FIBER] = IRIG_STATUS_UNKNOWN;
+	dev->signal_status[SYNC_INPUT_PORT1] = IRIG_STATUS_UNKNOWN;
+
+	/* The signals are handled by the main thread only */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	ret = create_thread(state, dev);
+	if (ret == EPERM && state->rt_priority > 0) {
+		/* No CAP_SYS_NICE or RLIMIT_RTPRIO, keep syncing at the normal priority */
+		sync_log(LOG_WARNING, "SCHED_FIFO priority %d is not permitted, use the normal scheduling",
+			state->rt_priority);
+		state->rt_priority = 0;
+		ret = create_thread(state, dev);
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (ret != 0) {
+		sync_log(LOG_ERR, "pthread_create() fail: %s", strerror(ret));
+		pthread_mutex_unlock(&state->lock);
+		return -1;
+	}
+
+	state->device_count++;
+	pthread_mutex_unlock(&state->lock);
+
+	return 0;
+}
+
+void sync_device_set_source(SYNC_STATE *state, SYNC_DEVICE *dev, int time_source, int failover)
+{
+	unsigned long long switches = dev->source.switches;
+
+	source_init(&dev->source, time_source, failover);
+	dev->source.switches = switches;
+	if (dev->time_source == time_source) {
+		return;
+	}
+
+	dev->time_source = time_source;
+	dev->healthy = source_healthy(dev);
+	reset_reference(state, dev);
+
+	dev->resync_request = 1;
+	pthread_cond_broadcast(&state->wakeup);
+}
+
+void sync_device_set_delay(SYNC_STATE *state, SYNC_DEVICE *dev, long long input_delay, long long output_advance)
+{
+	pthread_mutex_lock(&state->lock);
+	if (input_delay >= 0) {
+		set_input_delay(state, dev, input_delay);
+	}
+	if (dev->output_advance != output_advance) {
+		sync_log(LOG_NOTICE, "Card %d: output advance changes from %lld to %lld ns", dev->index,
+			dev->output_advance, output_advance);
+		dev->output_advance = output_advance;
+		reset_reference(state, dev);
+	}
+	pthread_mutex_unlock(&state->lock);
+}
+
+long long sync_device_loopback(HANDLE hDev, int index, int port, DWORD input, long long fallback)
+{
+	IRIGB_LOOPBACK loopback;
+
+	sync_log(LOG_NOTICE, "Card %d: output port %d is interrupted for %d loopback runs", index, port, LOOPBACK_RUNS);
+	if (!mxIrigbMeasureLoopback(hDev, port, input, LOOPBACK_RUNS, &loopback)) {
+		sync_log(LOG_ERR, "Card %d: mxIrigbMeasureLoopback() port:%d fail, %lu of %d runs came back, keep the input delay %lld ns",
+			index, port, loopback.runs, LOOPBACK_RUNS, fallback);
+		return fallback;
+	}
+
+	/* The loopback runs the cable both ways */
+	sync_log(LOG_NOTICE, "Card %d: loopback round trip %lld ns, std. dev. %lld ns, min %lld ns, max %lld ns, %lu failures",
+		index, loopback.mean, loopback.stddev, loopback.min, loopback.max, loopback.failures);
+	return loopback.mean / 2;
+}
+
+void sync_device_request_loopback(SYNC_STATE *state, SYNC_DEVICE *dev, int port, DWORD input, long long fallback)
+{
+	pthread_mutex_lock(&state->lock);
+	dev->loopback_port = port;
+	dev->loopback_input = input;
+	dev->loopback_fallback = fallback;
+	pthread_cond_broadcast(&state->wakeup);
+	pthread_mutex_unlock(&state->lock);
+}
+
+int sync_state_set_realtime(SYNC_STATE *state, int priority, const cpu_set_t *cpus)
+{
+	if (priority < 0 || priority > sched_get_priority_max(SCHED_FIFO)) {
+		return -1;
+	}
+
+	state->rt_priority = priority;
+	if (cpus != NULL) {
+		state->rt_cpus = *cpus;
+	}
+
+	return 0;
+}
+
+int sync_state_lock_memory(void)
+{
+	/* Only the pages mapped so far, the journal mapped next stays out */
+	if (mlockall(MCL_CURRENT) < 0) {
+		sync_log(LOG_ERR, "mlockall() fail: %s", strerror(errno));
+		return -1;
+	}
+
+	prefault_stack();
+
+	return 0;
+}
+
+int sync_state_lock_future(void)
+{
+	/* MCL_FUTURE alone leaves the pages mapped so far as they are */
+	if (mlockall(MCL_FUTURE) < 0) {
+		sync_log(LOG_ERR, "mlockall() fail: %s", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+void sync_state_stop(SYNC_STATE *state)
+{
+	int i;
+
+	pthread_mutex_lock(&state->lock);
+	state->stopping = 1;
+	pthread_cond_broadcast(&state->wakeup);
+	pthread_mutex_unlock(&state->lock);
+
+	for (i = 0; i < state->device_count; i++) {
+		pthread_join(state->device[i].thread, NULL);
+		mxIrigbClose(state->device[i].hDev);
+	}
+}
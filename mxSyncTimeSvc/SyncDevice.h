@@ -0,0 +1,207 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncDevice.h : per card sampling threads of the IRIG-B time sync daemon.
+ *
+ * Every card runs its own sampling thread, so a slow or failing card never
+ * delays the others. After each sample the thread selects the reference:
+ * the current reference is kept while its RTC follows a valid time source,
+ * otherwise the first healthy card takes over. Only the reference thread
+ * disciplines the system clock.
+ *
+ * The samples are taken at a fixed phase after the second of the system time,
+ * on a multiple of the interval, so they are equally spaced and never read the
+ * RTC registers while they roll over.
+ *
+ * A leap second announced by the reference in the last minute of the UTC day is
+ * armed in the kernel with STA_INS or STA_DEL, which applies it at midnight.
+ */
+
+#ifndef __SYNCDEVICE_H_
+#define __SYNCDEVICE_H_
+
+#include "SyncState.h"
+
+#define NSEC_PER_SEC			1000000000LL
+
+/* Names of the status word bits, _IRIGB_STATUS_BIT_ */
+extern const char *sync_status_bit_name[IRIGB_STATUS_BITS];
+
+/**
+ * Convert a timespec into ns
+ * @param  [in] ts - the time
+ * @return The time in ns
+ */
+long long timespec_to_ns(const struct timespec *ts);
+
+/**
+ * Get the frequency adjustment of the system clock
+ * @return The frequency adjustment in ppb
+ */
+double sync_get_frequency(void);
+
+/**
+ * Initialize the daemon state, no card is attached yet
+ * @param  [in] state - the daemon state
+ * @param  [in] interval - the time sync interval in seconds
+ * @return If the operation completes successfully, the return value is zero.
+ */
+int sync_state_init(SYNC_STATE *state, long interval);
+
+/**
+ * Copy the daemon state for reporting
+ * @param  [in] state - the daemon state
+ * @param  [out] copy - receives a consistent copy, its lock must not be used
+ * @return None
+ */
+void sync_state_snapshot(SYNC_STATE *state, SYNC_STATE *copy);
+
+/**
+ * Change the time sync interval of every card
+ * @param  [in] state - the daemon state
+ * @param  [in] interval - the time sync interval in seconds
+ * @return If the interval is in range, the return value is zero.
+ */
+int sync_state_set_interval(SYNC_STATE *state, long interval);
+
+/**
+ * Sample the cards several times a second
+ * @param  [in] state - the daemon state
+ * @param  [in] rate - RTC samples per second, 0 for one sample per time sync interval
+ * @param  [in] decimation - samples averaged into one servo update when rate is nonzero
+ * @return If the rate divides a second in whole ns and both are in range, the return value is zero.
+ */
+int sync_state_set_rate(SYNC_STATE *state, int rate, int decimation);
+
+/**
+ * Change when the cards are sampled within the second of the system time
+ * @param  [in] state - the daemon state
+ * @param  [in] phase - the delay after the second in ms
+ * @return If the phase is in range, the return value is zero.
+ */
+int sync_state_set_phase(SYNC_STATE *state, long phase);
+
+/**
+ * Change the offset limit of the accuracy compliance alarm
+ * @param  [in] state - the daemon state
+ * @param  [in] limit - the limit in ns, 0 for no alarm
+ * @return If the limit is in range, the return value is zero.
+ */
+int sync_state_set_accuracy(SYNC_STATE *state, long long limit);
+
+/**
+ * Set the TAI offset of the kernel, the kernel keeps it across the leap seconds it applies
+ * @param  [in] state - the daemon state
+ * @param  [in] tai - TAI minus UTC in seconds, 0 to keep the offset of the kernel.
+ *         An offset behind the kernel is ignored.
+ * @return If the offset is in range and set, the return value is zero.
+ */
+int sync_state_set_tai(SYNC_STATE *state, int tai);
+
+/**
+ * Let every card sample now
+ * @param  [in] state - the daemon state
+ * @return None
+ */
+void sync_state_resync(SYNC_STATE *state);
+
+/**
+ * Select the scheduling of the sampling threads started afterwards
+ * @param  [in] state - the daemon state
+ * @param  [in] priority - SCHED_FIFO priority, 0 for the normal scheduling
+ * @param  [in] cpus - the CPUs to run the sampling threads on, NULL or empty for any CPU
+ * @return If the priority is valid, the return value is zero.
+ */
+int sync_state_set_realtime(SYNC_STATE *state, int priority, const cpu_set_t *cpus);
+
+/**
+ * Lock the daemon memory mapped so far, before the journal and the archive are mapped.
+ * The steady state allocates nothing, so no page fault delays a sample.
+ * @return If the operation completes successfully, the return value is zero.
+ */
+int sync_state_lock_memory(void);
+
+/**
+ * Lock the memory mapped from now on, the stacks of the sampling threads,
+ * once the journal and the archive are mapped
+ * @return If the operation completes successfully, the return value is zero.
+ */
+int sync_state_lock_future(void);
+
+/**
+ * Attach an opened card and start its sampling thread
+ * @param  [in] state - the daemon state
+ * @param  [in] index - the card index of mxIrigbOpen
+ * @param  [in] hDev - the card handle, closed by "sync_state_stop" function
+ * @param  [in] hwid - the card hardware ID
+ * @param  [in] time_source - the card time source, one of _RTC_SYNC_SOURCE_
+ * @param  [in] failover - nonzero to switch between the Fiber port and IRIG-B port 1
+ * @param  [in] input_delay - the cable delay of the time source in ns
+ * @param  [in] output_advance - the time a free running RTC leads for the output cables in ns
+ * @return If the operation completes successfully, the return value is zero.
+ */
+int sync_device_start(SYNC_STATE *state, int index, HANDLE hDev, DWORD hwid, int time_source, int failover,
+	long long input_delay, long long output_advance);
+
+/**
+ * Make a card follow another time source, called with the state lock held.
+ * The servo only relearns the offset when the time source really changes.
+ * @param  [in] state - the daemon state
+ * @param  [in] dev - the card, RTCCON is already written
+ * @param  [in] time_source - the new time source, one of _RTC_SYNC_SOURCE_
+ * @param  [in] failover - nonzero to switch between the Fiber port and IRIG-B port 1
+ * @return None
+ */
+void sync_device_set_source(SYNC_STATE *state, SYNC_DEVICE *dev, int time_source, int failover);
+
+/**
+ * Change the cable delays of a card.
+ * The servo relearns the offset of the reference when a delay changes.
+ * @param  [in] state - the daemon state
+ * @param  [in] dev - the card
+ * @param  [in] input_delay - the delay of the time source in ns, added to the RTC time unless the RTC runs free,
+ *         -1 to keep it
+ * @param  [in] output_advance - the time a free running RTC leads for the output cables in ns,
+ *         taken off the RTC time, so the system time follows the RTC that much behind
+ * @return None
+ */
+void sync_device_set_delay(SYNC_STATE *state, SYNC_DEVICE *dev, long long input_delay, long long output_advance);
+
+/**
+ * Measure the cable delay of the time source, half the round trip of a loopback.
+ * The output port stops sending its signal and the input carries the loopback pulses for about a
+ * millisecond a run, so the card must not be sampled meanwhile.
+ * @param  [in] hDev - the card
+ * @param  [in] index - the card index, for the log
+ * @param  [in] port - the output port sending the loopback pulse, PORT_1 ~ PORT_4
+ * @param  [in] input - the input port of the time source, PORT_FIBER or PORT_1
+ * @param  [in] fallback - the delay in ns returned when the loopback fails
+ * @return The input delay in ns
+ */
+long long sync_device_loopback(HANDLE hDev, int index, int port, DWORD input, long long fallback);
+
+/**
+ * Measure the cable delay of the time source of a running card in its sampling thread.
+ * The card takes no sample during the loopback, about a second, then the servo relearns
+ * the offset of the reference if the delay changed.
+ * @param  [in] state - the daemon state
+ * @param  [in] dev - the card
+ * @param  [in] port - the output port sending the loopback pulse, PORT_1 ~ PORT_4
+ * @param  [in] input - the input port of the time source, PORT_FIBER or PORT_1
+ * @param  [in] fallback - the delay in ns kept when the loopback fails
+ * @return None
+ */
+void sync_device_request_loopback(SYNC_STATE *state, SYNC_DEVICE *dev, int port, DWORD input, long long fallback);
+
+/**
+ * Stop the sampling threads and close the cards
+ * @param  [in] state - the daemon state
+ * @return None
+ */
+void sync_state_stop(SYNC_STATE *state);
+
+#endif  // __SYNCDEVICE_H_
@@ -0,0 +1,382 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncIpc.cpp : status and control server of the IRIG-B time sync daemon.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/timex.h>
+#include <sys/un.h>
+
+#include "SyncIpc.h"
+#include "SyncDevice.h"
+#include "SyncLog.h"
+
+#define SYNCIPC_BACKLOG			4
+#define SYNCIPC_RECV_TIMEOUT		200000	/* 200 ms */
+#define SYNCIPC_REQUEST_SIZE		256
+#define SYNCIPC_REPLY_SIZE		16384	/* the status of SYNC_MAX_DEVICES cards */
+
+static const char *strSignalStatus[] = {
+	"normal",
+	"off_line",
+	"frame_error",
+	"parity_error",
+	"unknown"
+};
+
+static const char *signal_status_name(DWORD status)
+{
+	if (status > IRIG_STATUS_UNKNOWN) {
+		status = IRIG_STATUS_UNKNOWN;
+	}
+
+	return strSignalStatus[status];
+}
+
+int sync_ipc_open(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		sync_log(LOG_ERR, "Socket path %s too long", path);
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		sync_log(LOG_ERR, "socket() fail: %s", strerror(errno));
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	/* Remove the socket left by a previous instance */
+	unlink(path);
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		sync_log(LOG_ERR, "bind(%s) fail: %s", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	/* Only root may control the daemon */
+	chmod(path, 0600);
+
+	if (listen(fd, SYNCIPC_BACKLOG) < 0) {
+		sync_log(LOG_ERR, "listen(%s) fail: %s", path, strerror(errno));
+		close(fd);
+		unlink(path);
+		return -1;
+	}
+
+	return fd;
+}
+
+void sync_ipc_close(int fd, const char *path)
+{
+	if (fd < 0) {
+		return;
+	}
+
+	close(fd);
+	unlink(path);
+}
+
+static int fill_status(SYNC_STATE *state, char *buf)
+{
+	SYNCIPC_STATUS *status = (SYNCIPC_STATUS *)buf;
+	SYNCIPC_DEVICE *device = (SYNCIPC_DEVICE *)(buf + sizeof(*status));
+	SYNC_DEVICE *dev;
+	int i;
+
+	memset(status, 0, sizeof(*status));
+	status->servo_state = state->servo.state;
+	status->reference = (state->reference >= 0) ? state->device[state->reference].index : -1;
+	status->device_count = state->device_count;
+	status->interval = state->interval;
+	status->offset = (state->reference >= 0) ? state->device[state->reference].offset : 0;
+	status->freq = (int64_t)(state->freq * 1000.0);
+	status->last_sync_sec = state->last_sync.tv_sec;
+	status->last_sync_nsec = state->last_sync.tv_nsec;
+	status->sync_errors = state->sync_errors;
+	status->steps = state->steps;
+	status->reference_changes = state->reference_changes;
+
+	for (i = 0; i < state->device_count; i++) {
+		dev = &state->device[i];
+		memset(&device[i], 0, sizeof(device[i]));
+		device[i].index = dev->index;
+		device[i].time_source = dev->time_source;
+		device[i].signal_status[SYNC_INPUT_FIBER] = dev->signal_status[SYNC_INPUT_FIBER];
+		device[i].signal_status[SYNC_INPUT_PORT1] = dev->signal_status[SYNC_INPUT_PORT1];
+		device[i].healthy = dev->healthy;
+		device[i].alarm = dev->monitor.alarm;
+		device[i].hwid = dev->hwid;
+		device[i].offset = dev->offset;
+		device[i].samples = dev->samples;
+		device[i].read_errors = dev->read_errors;
+	}
+
+	return sizeof(*status) + state->device_count * sizeof(SYNCIPC_DEVICE);
+}
+
+/* The windows, percentiles and alarm of a card */
+static int format_monitor_json(SYNC_MONITOR *m, char *buf, int size)
+{
+	int w, len;
+
+	len = snprintf(buf, size,
+		"\"monitor\":{\"alarm\":%s,\"offset_alarm\":%s,\"source_alarm\":%s,\"alarms\":%llu,"
+		"\"alarm_since\":%lld.%09ld,\"abs_offset_ns\":{\"p50\":%lld,\"p95\":%lld,\"p99\":%lld},\"windows\":[",
+		m->alarm ? "true" : "false",
+		(m->alarm & MONITOR_ALARM_OFFSET) ? "true" : "false",
+		(m->alarm & MONITOR_ALARM_SOURCE) ? "true" : "false",
+		m->alarms, (long long)m->alarm_since.tv_sec, m->alarm_since.tv_nsec,
+		monitor_percentile(m, 0.50), monitor_percentile(m, 0.95), monitor_percentile(m, 0.99));
+
+	for (w = 0; w < MONITOR_WINDOWS && len < size; w++) {
+		len += snprintf(buf + len, size - len,
+			"%s{\"window_s\":%d,\"max_abs_ns\":%lld,\"peak_to_peak_ns\":%lld,\"mtie_ns\":%lld}",
+			w ? "," : "", sync_monitor_windows[w], monitor_max_abs(m, w),
+			monitor_peak_to_peak(m, w), m->window[w].mtie);
+	}
+	if (len < size) {
+		len += snprintf(buf + len, size - len, "]}");
+	}
+
+	return len;
+}
+
+/* The polls per status word bit of a card */
+static int format_events_json(IRIGB_STATUS_COUNTERS *c, char *buf, int size)
+{
+	int i, len;
+
+	len = snprintf(buf, size, "\"status_events\":{\"polls\":%lu", (unsigned long)c->polls);
+	for (i = 0; i < IRIGB_STATUS_BITS && len < size; i++) {
+		len += snprintf(buf + len, size - len, ",\"%s\":%lu", sync_status_bit_name[i], (unsigned long)c->bit[i]);
+	}
+	if (len < size) {
+		len += snprintf(buf + len, size - len, "},");
+	}
+
+	return len;
+}
+
+static int format_status_json(SYNC_STATE *state, char *buf, int size)
+{
+	char status_buf[sizeof(SYNCIPC_STATUS) + SYNC_MAX_DEVICES * sizeof(SYNCIPC_DEVICE)];
+	SYNCIPC_STATUS *status = (SYNCIPC_STATUS *)status_buf;
+	SYNCIPC_DEVICE *device = (SYNCIPC_DEVICE *)(status_buf + sizeof(*status));
+	char phase[24];
+	int i, len;
+
+	fill_status(state, status_buf);
+
+	len = snprintf(buf, size,
+		"{\"result\":%d,\"version\":%d,\"interval\":%d,\"rate\":%d,\"decimation\":%d,\"phase_ms\":%ld,\"rt_priority\":%d,"
+		"\"accuracy_ns\":%lld,\"accuracy_class\":\"%s\","
+		"\"leap\":\"%s\",\"tai_offset\":%d,"
+		"\"servo_state\":\"%s\",\"reference\":%d,\"offset_ns\":%lld,"
+		"\"freq_ppb\":%.3f,\"last_sync\":%lld.%09d,"
+		"\"counters\":{\"sync_errors\":%llu,\"steps\":%llu,"
+		"\"reference_changes\":%llu},\"devices\":[",
+		SYNCIPC_OK, SYNCIPC_VERSION, status->interval, state->rate, state->decimation, state->phase / 1000000L, state->rt_priority,
+		state->accuracy, monitor_class_name(state->accuracy),
+		state->leap == STA_INS ? "insert" : (state->leap == STA_DEL ? "delete" : "none"), state->tai_offset,
+		servo_state_name(status->servo_state), status->reference,
+		(long long)status->offset, status->freq / 1000.0,
+		(long long)status->last_sync_sec, status->last_sync_nsec,
+		(unsigned long long)status->sync_errors,
+		(unsigned long long)status->steps,
+		(unsigned long long)status->reference_changes);
+
+	for (i = 0; i < status->device_count && len < size; i++) {
+		if (state->device[i].decoder_phase_valid) {
+			snprintf(phase, sizeof(phase), "%lld", state->device[i].decoder_phase);
+		} else {
+			strcpy(phase, "null");
+		}
+		len += snprintf(buf + len, size - len,
+			"%s{\"card\":%u,\"hwid\":%u,\"time_source\":%u,"
+			"\"healthy\":%s,\"failover\":%s,\"offset_ns\":%lld,\"input_delay_ns\":%lld,\"output_advance_ns\":%lld,"
+			"\"signal\":{\"fiber\":\"%s\",\"port1\":\"%s\"},"
+			"\"wakeup_max_ns\":%lld,"
+			"\"counters\":{\"samples\":%llu,\"read_errors\":%llu,"
+			"\"rtc_tears\":%llu,\"source_switches\":%llu},"
+			"\"decoders\":{\"compared\":%s,\"mismatch\":%s,\"diff_ns\":%lld,"
+			"\"mismatches\":%llu,\"elapsed_ns\":[%lld,%lld],\"rtc_phase_ns\":%s},"
+			"\"pps\":{\"signal\":\"%s\",\"timeouts\":%llu,\"seconds_set\":%llu},",
+			i ? "," : "", device[i].index, device[i].hwid, device[i].time_source,
+			device[i].healthy ? "true" : "false",
+			state->device[i].source.enabled ? "true" : "false",
+			(long long)device[i].offset,
+			state->device[i].input_delay,
+			state->device[i].output_advance,
+			signal_status_name(device[i].signal_status[SYNC_INPUT_FIBER]),
+			signal_status_name(device[i].signal_status[SYNC_INPUT_PORT1]),
+			state->device[i].wakeup_max,
+			(unsigned long long)device[i].samples,
+			(unsigned long long)device[i].read_errors,
+			state->device[i].rtc_tears,
+			state->device[i].source.switches,
+			state->device[i].decoder_valid ? "true" : "false",
+			state->device[i].decoder_mismatch ? "true" : "false",
+			state->device[i].decoder_diff,
+			state->device[i].decoder_mismatches,
+			state->device[i].decoder_elapsed[SYNC_INPUT_FIBER],
+			state->device[i].decoder_elapsed[SYNC_INPUT_PORT1],
+			phase,
+			signal_status_name(state->device[i].pps_status),
+			state->device[i].pps_timeouts,
+			state->device[i].pps_seconds_set);
+		if (len < size) {
+			len += format_events_json(&state->device[i].status_events, buf + len, size - len);
+		}
+		if (len < size) {
+			len += format_monitor_json(&state->device[i].monitor, buf + len, size - len);
+		}
+		if (len < size) {
+			len += snprintf(buf + len, size - len, "}");
+		}
+	}
+
+	if (len < size) {
+		len += snprintf(buf + len, size - len, "]}\n");
+	}
+
+	return len;
+}
+
+static int do_command(SYNC_STATE *state, int command, long long arg)
+{
+	switch (command) {
+	case SYNCIPC_CMD_STATUS:
+		return SYNCIPC_OK;
+	case SYNCIPC_CMD_SET_INTERVAL:
+		if (sync_state_set_interval(state, (long)arg) < 0) {
+			return SYNCIPC_ERR_ARGUMENT;
+		}
+		return SYNCIPC_OK;
+	case SYNCIPC_CMD_RESYNC:
+		sync_state_resync(state);
+		return SYNCIPC_OK;
+	case SYNCIPC_CMD_RELOAD:
+		if (state->reload == NULL || state->reload(state) < 0) {
+			return SYNCIPC_ERR_CONFIG;
+		}
+		return SYNCIPC_OK;
+	}
+
+	return SYNCIPC_ERR_COMMAND;
+}
+
+static int process_binary(SYNC_STATE *state, SYNCIPC_REQUEST *req, char *buf)
+{
+	SYNCIPC_REPLY *reply = (SYNCIPC_REPLY *)buf;
+	int len = sizeof(*reply);
+
+	reply->magic = SYNCIPC_MAGIC;
+	reply->version = SYNCIPC_VERSION;
+	reply->command = req->command;
+	reply->length = 0;
+
+	if (req->version != SYNCIPC_VERSION) {
+		reply->result = SYNCIPC_ERR_VERSION;
+		return len;
+	}
+
+	reply->result = do_command(state, req->command, req->arg);
+	if (reply->result == SYNCIPC_OK && req->command == SYNCIPC_CMD_STATUS) {
+		SYNC_STATE snapshot;
+
+		sync_state_snapshot(state, &snapshot);
+		reply->length = fill_status(&snapshot, buf + len);
+		len += reply->length;
+	}
+
+	return len;
+}
+
+static int process_text(SYNC_STATE *state, char *line, char *buf, int size)
+{
+	char *cmd, *arg;
+	int result;
+
+	cmd = strtok(line, " \t\r\n");
+	arg = strtok(NULL, " \t\r\n");
+
+	if (cmd == NULL) {
+		result = SYNCIPC_ERR_COMMAND;
+	} else if (strcmp(cmd, "status") == 0) {
+		SYNC_STATE snapshot;
+
+		sync_state_snapshot(state, &snapshot);
+		return format_status_json(&snapshot, buf, size);
+	} else if (strcmp(cmd, "interval") == 0) {
+		result = (arg == NULL) ? SYNCIPC_ERR_ARGUMENT :
+			do_command(state, SYNCIPC_CMD_SET_INTERVAL, atoll(arg));
+	} else if (strcmp(cmd, "resync") == 0) {
+		result = do_command(state, SYNCIPC_CMD_RESYNC, 0);
+	} else if (strcmp(cmd, "reload") == 0) {
+		result = do_command(state, SYNCIPC_CMD_RELOAD, 0);
+	} else {
+		result = SYNCIPC_ERR_COMMAND;
+	}
+
+	return snprintf(buf, size, "{\"result\":%d}\n", result);
+}
+
+void sync_ipc_process(int fd, SYNC_STATE *state)
+{
+	char request[SYNCIPC_REQUEST_SIZE];
+	char reply[SYNCIPC_REPLY_SIZE];
+	struct timeval tv = { 0, SYNCIPC_RECV_TIMEOUT };
+	int client, len;
+
+	client = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+	if (client < 0) {
+		return;
+	}
+
+	/* A stalled client must not hold up the sync loop */
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	len = recv(client, request, sizeof(request) - 1, 0);
+	if (len <= 0) {
+		close(client);
+		return;
+	}
+
+	if (len >= (int)sizeof(SYNCIPC_REQUEST) &&
+		((SYNCIPC_REQUEST *)request)->magic == SYNCIPC_MAGIC) {
+		len = process_binary(state, (SYNCIPC_REQUEST *)request, reply);
+	} else {
+		request[len] = '\0';
+		len = process_text(state, request, reply, sizeof(reply));
+		if (len >= (int)sizeof(reply)) {
+			len = sizeof(reply) - 1;
+		}
+	}
+
+	send(client, reply, len, MSG_NOSIGNAL);
+	close(client);
+}
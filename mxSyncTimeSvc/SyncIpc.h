@@ -0,0 +1,131 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncIpc.h : status and control protocol of the IRIG-B time sync daemon.
+ *
+ * The daemon listens on a local stream socket. Each connection carries one
+ * request and one reply, the daemon closes the connection after replying.
+ *
+ * Two encodings are accepted, chosen by the first bytes of the request:
+ *  - Binary: a SYNCIPC_REQUEST starting with SYNCIPC_MAGIC. The reply is a
+ *    SYNCIPC_REPLY header followed by "length" bytes of payload.
+ *    SYNCIPC_CMD_STATUS returns a SYNCIPC_STATUS payload followed by
+ *    "device_count" SYNCIPC_DEVICE records, one per card.
+ *  - Text: a single command line, the reply is a single line JSON object.
+ *      status               - report the daemon status and the accuracy compliance of every card
+ *      interval <seconds>   - change the time sync interval
+ *      resync               - sample every card now
+ *      reload               - read the configuration file again
+ *
+ * All binary fields are in host byte order, the socket is local only.
+ */
+
+#ifndef __SYNCIPC_H_
+#define __SYNCIPC_H_
+
+#include <stdint.h>
+
+#define SYNCIPC_SOCKET_PATH		"/var/run/ServiceSyncTime.sock"
+#define SYNCIPC_MAGIC			0x5953584d	/* "MXSY" */
+#define SYNCIPC_VERSION			2
+
+enum _SYNCIPC_COMMAND_
+{
+	SYNCIPC_CMD_STATUS = 1,
+	SYNCIPC_CMD_SET_INTERVAL,	/* arg: interval in seconds */
+	SYNCIPC_CMD_RESYNC,
+	SYNCIPC_CMD_RELOAD,		/* read the configuration file again */
+
+	SYNCIPC_CMD_MAX
+};
+
+enum _SYNCIPC_RESULT_
+{
+	SYNCIPC_OK = 0,
+	SYNCIPC_ERR_COMMAND = -1,	/* Unknown command */
+	SYNCIPC_ERR_ARGUMENT = -2,	/* Argument out of range */
+	SYNCIPC_ERR_VERSION = -3,	/* Unsupported protocol version */
+	SYNCIPC_ERR_CONFIG = -4		/* No or invalid configuration file */
+};
+
+#pragma pack(push, 1)
+
+typedef struct _SYNCIPC_REQUEST {
+	uint32_t magic;			/* SYNCIPC_MAGIC */
+	uint16_t version;		/* SYNCIPC_VERSION */
+	uint16_t command;		/* one of _SYNCIPC_COMMAND_ */
+	int64_t arg;			/* command argument */
+} SYNCIPC_REQUEST;
+
+typedef struct _SYNCIPC_REPLY {
+	uint32_t magic;			/* SYNCIPC_MAGIC */
+	uint16_t version;		/* SYNCIPC_VERSION */
+	uint16_t command;		/* the requested command */
+	int32_t result;			/* one of _SYNCIPC_RESULT_ */
+	uint32_t length;		/* payload length following the header */
+} SYNCIPC_REPLY;
+
+typedef struct _SYNCIPC_STATUS {
+	uint8_t servo_state;		/* one of _SERVO_STATE_ */
+	int8_t reference;		/* card index disciplining the system clock, -1 if none */
+	uint8_t device_count;		/* number of SYNCIPC_DEVICE records following */
+	uint8_t reserved;
+	int32_t interval;		/* time sync interval in seconds */
+	int64_t offset;			/* reference RTC time minus system time in ns */
+	int64_t freq;			/* system clock frequency adjustment in ppb/1000 */
+	int64_t last_sync_sec;		/* system time of the last successful sync */
+	int32_t last_sync_nsec;
+	uint64_t sync_errors;
+	uint64_t steps;
+	uint64_t reference_changes;
+} SYNCIPC_STATUS;
+
+typedef struct _SYNCIPC_DEVICE {
+	uint8_t index;			/* card index */
+	uint8_t time_source;		/* one of _RTC_SYNC_SOURCE_ */
+	uint8_t signal_status[2];	/* fiber, port 1: one of _IRIG_SIGNAL_STATUS_ */
+	uint8_t healthy;		/* the RTC follows a valid time source */
+	uint8_t alarm;			/* _MONITOR_ALARM_ bits of the accuracy compliance alarm */
+	uint8_t reserved[2];
+	uint32_t hwid;			/* one of _IRIGB_BOARD_HWID_ */
+	int64_t offset;			/* RTC time minus system time in ns */
+	uint64_t samples;
+	uint64_t read_errors;
+} SYNCIPC_DEVICE;
+
+#pragma pack(pop)
+
+#ifndef SYNCIPC_CLIENT_ONLY
+
+#include "SyncState.h"
+
+/**
+ * Create the listening socket of the status and control server
+ * @param  [in] path - the socket path
+ * @return The listening socket. Return -1 on failure.
+ */
+int sync_ipc_open(const char *path);
+
+/**
+ * Close the listening socket and remove the socket file
+ * @param  [in] fd - the socket return from "sync_ipc_open" function
+ * @param  [in] path - the socket path
+ * @return None
+ */
+void sync_ipc_close(int fd, const char *path);
+
+/**
+ * Accept and serve one client connection
+ * @param  [in] fd - the socket return from "sync_ipc_open" function
+ * @param  [in] state - the daemon state to report and to control
+ * @return None
+ */
+void sync_ipc_process(int fd, SYNC_STATE *state);
+
+#endif  /* end of SYNCIPC_CLIENT_ONLY */
+
+#endif  // __SYNCIPC_H_
@@ -0,0 +1,338 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncJournal.cpp : binary sample journal of the IRIG-B time sync daemon.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "SyncJournal.h"
+#include "SyncLog.h"
+
+/* The records of the sampling threads on their way to the writer, in the locked memory */
+static SYNC_RECORD queue[SYNC_JOURNAL_QUEUE];
+static unsigned int queue_head;		/* next record to fill, owned by the sampling threads */
+static unsigned int queue_tail;		/* next record to write, owned by the writer */
+static unsigned long long queue_dropped;	/* records lost to a full queue */
+static SYNC_JOURNAL *queue_journal;
+static pthread_t writer;
+static int running;			/* the writer thread runs */
+static int stopping;
+
+static int header_valid(const SYNC_JOURNAL_HEADER *h)
+{
+	return memcmp(h->magic, SYNC_JOURNAL_MAGIC, sizeof(h->magic)) == 0 &&
+		h->version == SYNC_JOURNAL_VERSION &&
+		h->record_size == sizeof(SYNC_RECORD) &&
+		h->capacity >= MIN_JOURNAL_RECORDS && h->capacity <= MAX_JOURNAL_RECORDS;
+}
+
+/* A slot holds a committed record when its sequence number maps to it */
+static int record_valid(const SYNC_RECORD *record, uint64_t capacity, uint64_t slot)
+{
+	uint64_t seq = __atomic_load_n(&record[slot].seq, __ATOMIC_ACQUIRE);
+
+	return seq != 0 && (seq - 1) % capacity == slot;
+}
+
+int sync_journal_open(SYNC_JOURNAL *j, const char *path, uint64_t capacity)
+{
+	SYNC_JOURNAL_HEADER h;
+	int err;
+
+	if (capacity < MIN_JOURNAL_RECORDS || capacity > MAX_JOURNAL_RECORDS) {
+		return -1;
+	}
+
+	j->size = SYNC_JOURNAL_HEADER_SIZE + capacity * sizeof(SYNC_RECORD);
+	j->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (j->fd < 0) {
+		sync_log(LOG_ERR, "Open %s fail: %s", path, strerror(errno));
+		return -1;
+	}
+
+	/* Keep the history of the same journal, start over on any other file */
+	memset(&h, 0, sizeof(h));
+	if (pread(j->fd, &h, sizeof(h), 0) != sizeof(h) || !header_valid(&h) || h.capacity != capacity) {
+		if (ftruncate(j->fd, 0) < 0) {
+			sync_log(LOG_ERR, "ftruncate(%s) fail: %s", path, strerror(errno));
+			close(j->fd);
+			return -1;
+		}
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, SYNC_JOURNAL_MAGIC, sizeof(h.magic));
+		h.version = SYNC_JOURNAL_VERSION;
+		h.record_size = sizeof(SYNC_RECORD);
+		h.capacity = capacity;
+		h.head = 1;
+	}
+
+	/* Reserve the blocks now, a full disk must not fault a later write */
+	err = posix_fallocate(j->fd, 0, j->size);
+	if (err != 0) {
+		sync_log(LOG_ERR, "posix_fallocate(%s) fail: %s", path, strerror(err));
+		close(j->fd);
+		return -1;
+	}
+
+	j->header = (SYNC_JOURNAL_HEADER *)mmap(NULL, j->size, PROT_READ | PROT_WRITE, MAP_SHARED, j->fd, 0);
+	if (j->header == MAP_FAILED) {
+		sync_log(LOG_ERR, "mmap(%s) fail: %s", path, strerror(errno));
+		close(j->fd);
+		return -1;
+	}
+	memcpy(j->header, &h, sizeof(h));
+	j->record = (SYNC_RECORD *)((char *)j->header + SYNC_JOURNAL_HEADER_SIZE);
+
+	/* The header head is advisory, continue after the newest committed record */
+	for (uint64_t slot = 0; slot < capacity; slot++) {
+		if (record_valid(j->record, capacity, slot) && j->record[slot].seq >= j->header->head) {
+			j->header->head = j->record[slot].seq + 1;
+		}
+	}
+
+	return 0;
+}
+
+void sync_journal_write(SYNC_JOURNAL *j, SYNC_RECORD *r)
+{
+	uint64_t seq = j->header->head;
+	SYNC_RECORD *slot = &j->record[(seq - 1) % j->header->capacity];
+
+	/* Invalidate the slot first, a crash in the middle leaves it empty; the fence keeps the copy after it */
+	__atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	r->seq = 0;
+	memcpy(slot, r, sizeof(*slot));
+	r->seq = seq;
+	__atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+
+	__atomic_store_n(&j->header->head, seq + 1, __ATOMIC_RELEASE);
+}
+
+int sync_journal_queue(const SYNC_RECORD *r)
+{
+	unsigned int pos = __atomic_load_n(&queue_head, __ATOMIC_RELAXED);
+
+	if (pos - __atomic_load_n(&queue_tail, __ATOMIC_ACQUIRE) >= SYNC_JOURNAL_QUEUE) {
+		__atomic_add_fetch(&queue_dropped, 1, __ATOMIC_RELAXED);
+		return -1;
+	}
+
+	queue[pos % SYNC_JOURNAL_QUEUE] = *r;
+	__atomic_store_n(&queue_head, pos + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/* Write the queued records in order */
+static void drain(void)
+{
+	unsigned int head = __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE);
+	SYNC_RECORD r;
+
+	while (queue_tail != head) {
+		r = queue[queue_tail % SYNC_JOURNAL_QUEUE];
+		__atomic_store_n(&queue_tail, queue_tail + 1, __ATOMIC_RELEASE);
+		sync_journal_write(queue_journal, &r);
+	}
+}
+
+static void *journal_writer(void *arg)
+{
+	unsigned long long reported = 0, lost;
+	struct timespec ts;
+
+	(void)arg;
+	ts.tv_sec = 0;
+	ts.tv_nsec = SYNC_JOURNAL_DRAIN_INTERVAL * 1000000L;
+	while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+		drain();
+
+		lost = __atomic_load_n(&queue_dropped, __ATOMIC_RELAXED);
+		if (lost != reported) {
+			sync_log(LOG_WARNING, "%llu journal records dropped, the writer is behind", lost - reported);
+			reported = lost;
+		}
+		nanosleep(&ts, NULL);
+	}
+	drain();
+
+	return NULL;
+}
+
+int sync_journal_start(SYNC_JOURNAL *j)
+{
+	sigset_t all, old;
+	int ret;
+
+	queue_journal = j;
+	queue_head = queue_tail = 0;
+
+	/* The signals are handled by the main thread only */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	ret = pthread_create(&writer, NULL, journal_writer, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (ret != 0) {
+		sync_log(LOG_ERR, "pthread_create() fail: %s", strerror(ret));
+		return -1;
+	}
+
+	running = 1;
+
+	return 0;
+}
+
+void sync_journal_stop(void)
+{
+	if (!running) {
+		return;
+	}
+
+	__atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+	pthread_join(writer, NULL);
+	running = 0;
+}
+
+uint64_t sync_journal_head(SYNC_JOURNAL *j)
+{
+	return __atomic_load_n(&j->header->head, __ATOMIC_ACQUIRE);
+}
+
+int sync_journal_read(SYNC_JOURNAL *j, uint64_t seq, SYNC_RECORD *r)
+{
+	SYNC_RECORD *slot = &j->record[(seq - 1) % j->header->capacity];
+
+	/* The slot is rewritten when its sequence number changes during the copy */
+	if (seq == 0 || __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq) {
+		return -1;
+	}
+	memcpy(r, slot, sizeof(*r));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq || r->seq != seq) {
+		return -1;
+	}
+
+	return 0;
+}
+
+void sync_journal_flush(SYNC_JOURNAL *j)
+{
+	msync(j->header, j->size, MS_ASYNC);
+}
+
+void sync_journal_close(SYNC_JOURNAL *j)
+{
+	msync(j->header, j->size, MS_SYNC);
+	munmap(j->header, j->size);
+	close(j->fd);
+}
+
+long long sync_journal_scan(const char *path, SYNC_JOURNAL_CALLBACK cb, void *arg)
+{
+	const SYNC_JOURNAL_HEADER *h;
+	const SYNC_RECORD *record;
+	uint64_t capacity, slot, seq, last = 0;
+	SYNC_RECORD r;
+	long long count = 0;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "Open %s fail: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < SYNC_JOURNAL_HEADER_SIZE) {
+		fprintf(stderr, "%s is not a sample journal\n", path);
+		close(fd);
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "mmap(%s) fail: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	h = (const SYNC_JOURNAL_HEADER *)map;
+	capacity = h->capacity;
+	if (!header_valid(h) ||
+	    (uint64_t)st.st_size < SYNC_JOURNAL_HEADER_SIZE + capacity * sizeof(SYNC_RECORD)) {
+		fprintf(stderr, "%s is not a sample journal version %d\n", path, SYNC_JOURNAL_VERSION);
+		munmap(map, st.st_size);
+		return -1;
+	}
+	record = (const SYNC_RECORD *)((const char *)map + SYNC_JOURNAL_HEADER_SIZE);
+
+	/* Find the newest committed record, the header may be behind after a crash */
+	for (slot = 0; slot < capacity; slot++) {
+		if (record_valid(record, capacity, slot) && record[slot].seq > last) {
+			last = record[slot].seq;
+		}
+	}
+
+	/* Pages already read are not needed again */
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	for (seq = (last > capacity) ? last - capacity + 1 : 1; seq <= last; seq++) {
+		slot = (seq - 1) % capacity;
+		if (!record_valid(record, capacity, slot) || record[slot].seq != seq) {
+			continue;
+		}
+
+		/* The daemon may rewrite the slot during the copy, as in sync_journal_read() */
+		memcpy(&r, &record[slot], sizeof(r));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&record[slot].seq, __ATOMIC_RELAXED) != seq || r.seq != seq) {
+			continue;
+		}
+
+		count++;
+		if (cb(&r, arg) != 0) {
+			break;
+		}
+	}
+
+	munmap(map, st.st_size);
+
+	return count;
+}
+
+static int dump_record(const SYNC_RECORD *r, void *arg)
+{
+	FILE *fp = (FILE *)arg;
+
+	fprintf(fp, "%llu,%u,%lld,%lld,%d,%lld,%.3f,%u,%u,%u,%u,%u,%d,%d,%d,%d\n",
+		(unsigned long long)r->seq, r->card, (long long)r->rtc, (long long)r->t1,
+		r->latency, (long long)SYNC_RECORD_OFFSET(r), r->freq / 1000.0,
+		r->servo_state, r->time_source, r->signal_status & 0xf, r->signal_status >> 4, r->tq,
+		(r->flags & SYNC_RECORD_RTC_VALID) ? 1 : 0,
+		(r->flags & SYNC_RECORD_HEALTHY) ? 1 : 0,
+		(r->flags & SYNC_RECORD_REFERENCE) ? 1 : 0,
+		(r->flags & SYNC_RECORD_ALARM) ? 1 : 0);
+
+	return 0;
+}
+
+long long sync_journal_dump(const char *path, FILE *fp)
+{
+	fprintf(fp, "seq,card,rtc_ns,t1_ns,latency_ns,offset_ns,freq_ppb,servo_state,time_source,"
+		"fiber_status,port1_status,tq,rtc_valid,healthy,reference,alarm\n");
+
+	return sync_journal_scan(path, dump_record, fp);
+}
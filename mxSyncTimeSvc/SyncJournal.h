@@ -0,0 +1,168 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncJournal.h : binary sample journal of the IRIG-B time sync daemon.
+ *
+ * Every RTC sample is recorded in a preallocated file mapped into memory, used
+ * as a ring of fixed size records after a one page header. Writing a record is
+ * a memory copy without a system call. The sequence number of a record is
+ * stored last, a slot is valid when its sequence number maps to the slot, so
+ * the journal stays readable after a crash of the daemon.
+ *
+ * The sampling threads only queue their records in memory, a writer thread of
+ * the normal scheduling copies them into the file, so a page fault on the file
+ * never delays a sample and the file needs not be locked in memory.
+ */
+
+#ifndef __SYNCJOURNAL_H_
+#define __SYNCJOURNAL_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define SYNC_JOURNAL_MAGIC		"MXIRJRNL"
+#define SYNC_JOURNAL_VERSION		1
+#define SYNC_JOURNAL_HEADER_SIZE	4096
+#define DEFAULT_JOURNAL_RECORDS		2592000		/* 30 days at 1 Hz, 100 MB */
+#define MIN_JOURNAL_RECORDS		60
+#define MAX_JOURNAL_RECORDS		100000000
+#define SYNC_JOURNAL_FLUSH_INTERVAL	60		/* seconds between the write backs */
+#define SYNC_JOURNAL_QUEUE		4096		/* records queued for the writer, 16 s of 8 cards at 32 Hz */
+#define SYNC_JOURNAL_DRAIN_INTERVAL	100		/* ms between the runs of the writer */
+
+/* SYNC_RECORD flags */
+#define SYNC_RECORD_RTC_VALID		(1<<0)	/* the RTC read succeeded */
+#define SYNC_RECORD_HEALTHY		(1<<1)	/* the RTC follows a valid time source */
+#define SYNC_RECORD_REFERENCE		(1<<2)	/* the card disciplines the system clock */
+#define SYNC_RECORD_ALARM		(1<<3)	/* the accuracy compliance alarm of the card is raised */
+
+#pragma pack(push, 1)
+
+typedef struct _SYNC_JOURNAL_HEADER {
+	char magic[8];			/* SYNC_JOURNAL_MAGIC */
+	uint32_t version;		/* SYNC_JOURNAL_VERSION */
+	uint32_t record_size;		/* sizeof(SYNC_RECORD) */
+	uint64_t capacity;		/* records in the ring */
+	uint64_t head;			/* sequence number of the next record, advisory after a crash */
+} SYNC_JOURNAL_HEADER;
+
+typedef struct _SYNC_RECORD {
+	uint64_t seq;			/* sequence number from 1, written last, 0 for an empty slot */
+	int64_t rtc;			/* card time in ns since the Epoch */
+	int64_t t1;			/* system time before the RTC read in ns */
+	int32_t latency;		/* system time after the RTC read minus t1 in ns */
+	int32_t freq;			/* servo output, system clock frequency adjustment in ppb/1000 */
+	uint8_t card;			/* card index */
+	uint8_t flags;			/* SYNC_RECORD_* */
+	uint8_t signal_status;		/* Fiber port in bits 0..3, IRIG-B port in bits 4..7 */
+	uint8_t tq;			/* IRIG-B time quality */
+	uint8_t servo_state;		/* one of _SERVO_STATE_ */
+	uint8_t time_source;		/* one of _RTC_SYNC_SOURCE_ */
+	uint8_t reserved[2];
+} SYNC_RECORD;
+
+#pragma pack(pop)
+
+/* The offset of a record, the RTC time minus the system time in the middle of the read */
+#define SYNC_RECORD_OFFSET(r)		((r)->rtc - (r)->t1 - (r)->latency / 2)
+
+/* Called for every valid record of a scan, the oldest first, a nonzero return stops the scan */
+typedef int (*SYNC_JOURNAL_CALLBACK)(const SYNC_RECORD *r, void *arg);
+
+typedef struct _SYNC_JOURNAL {
+	int fd;
+	size_t size;			/* mapped bytes */
+	SYNC_JOURNAL_HEADER *header;
+	SYNC_RECORD *record;		/* header->capacity records */
+} SYNC_JOURNAL;
+
+/**
+ * Open or create the journal file. A valid journal of the same capacity is appended to.
+ * @param  [out] j - the journal
+ * @param  [in] path - the journal file
+ * @param  [in] capacity - records in the ring
+ * @return If the operation completes successfully, the return value is zero.
+ */
+int sync_journal_open(SYNC_JOURNAL *j, const char *path, uint64_t capacity);
+
+/**
+ * Start the writer thread copying the queued records into the journal
+ * @param  [in] j - the journal
+ * @return If the operation completes successfully, the return value is zero.
+ */
+int sync_journal_start(SYNC_JOURNAL *j);
+
+/**
+ * Queue a record for the writer thread, no system call and no access to the file.
+ * The callers must be serialized.
+ * @param  [in] r - the record
+ * @return Zero, -1 if the queue is full and the record is dropped.
+ */
+int sync_journal_queue(const SYNC_RECORD *r);
+
+/**
+ * Write the queued records and stop the writer thread
+ * @return None
+ */
+void sync_journal_stop(void);
+
+/**
+ * Append a record, no system call. The writers must be serialized by the caller.
+ * @param  [in] j - the journal
+ * @param  [in] r - the record, its seq is assigned
+ * @return None
+ */
+void sync_journal_write(SYNC_JOURNAL *j, SYNC_RECORD *r);
+
+/**
+ * Get the sequence number of the next record
+ * @param  [in] j - the journal
+ * @return The sequence number the next sync_journal_write() assigns
+ */
+uint64_t sync_journal_head(SYNC_JOURNAL *j);
+
+/**
+ * Copy a record while the sampling threads keep writing
+ * @param  [in] j - the journal
+ * @param  [in] seq - the sequence number of the record
+ * @param  [out] r - the record
+ * @return If the record is still in the ring, the return value is zero.
+ */
+int sync_journal_read(SYNC_JOURNAL *j, uint64_t seq, SYNC_RECORD *r);
+
+/**
+ * Let the kernel write the dirty pages back
+ * @param  [in] j - the journal
+ * @return None
+ */
+void sync_journal_flush(SYNC_JOURNAL *j);
+
+/**
+ * Write back and unmap the journal
+ * @param  [in] j - the journal
+ * @return None
+ */
+void sync_journal_close(SYNC_JOURNAL *j);
+
+/**
+ * Call back for the valid records of a journal file, the oldest first
+ * @param  [in] path - the journal file
+ * @param  [in] cb - called for every record
+ * @param  [in] arg - passed to cb
+ * @return The number of records passed to cb. Return -1 on failure.
+ */
+long long sync_journal_scan(const char *path, SYNC_JOURNAL_CALLBACK cb, void *arg);
+
+/**
+ * Print the valid records of a journal file as CSV, the oldest first
+ * @param  [in] path - the journal file
+ * @param  [in] fp - the output
+ * @return The number of records printed. Return -1 on failure.
+ */
+long long sync_journal_dump(const char *path, FILE *fp);
+
+#endif  // __SYNCJOURNAL_H_
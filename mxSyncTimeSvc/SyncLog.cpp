@@ -0,0 +1,237 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncLog.cpp : asynchronous logging of the IRIG-B time sync daemon.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "SyncLog.h"
+
+#define SYNC_LOG_MASK			(SYNC_LOG_SLOTS - 1)
+
+/* A slot is free for the writer position p when seq == p, and filled when seq == p + 1 */
+typedef struct _LOG_SLOT {
+	unsigned int seq;
+	int level;
+	char msg[SYNC_LOG_MSG_SIZE];
+} LOG_SLOT;
+
+static LOG_SLOT ring[SYNC_LOG_SLOTS];
+static unsigned int head;		/* next slot to fill, shared by the producers */
+static unsigned int tail;		/* next slot to write, owned by the writer */
+static unsigned long long dropped;	/* messages lost to a full ring */
+static sem_t ready;			/* posted for every queued message */
+static pthread_t writer;
+static int running;			/* the writer thread runs */
+static int stopping;
+static int log_syslog;
+static int log_level = DEFAULT_LOG_LEVEL;
+
+static void write_message(int level, const char *msg)
+{
+	if (log_syslog) {
+		syslog(level, "%s", msg);
+	} else {
+		fprintf(stderr, "%s\n", msg);
+	}
+}
+
+static void log_queue(int level, int suppressed, const char *fmt, va_list ap)
+{
+	char msg[SYNC_LOG_MSG_SIZE];
+	unsigned int pos, seq;
+	LOG_SLOT *slot;
+	int len;
+
+	if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+		/* No writer yet, the daemon is starting */
+		vsnprintf(msg, sizeof(msg), fmt, ap);
+		write_message(level, msg);
+		return;
+	}
+
+	/* Claim a free slot, drop the message when the writer is behind */
+	pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &ring[pos & SYNC_LOG_MASK];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq == pos) {
+			if (__atomic_compare_exchange_n(&head, &pos, pos + 1, 0,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if ((int)(seq - pos) < 0) {
+			__atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+			return;
+		} else {
+			pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->level = level;
+	len = vsnprintf(slot->msg, sizeof(slot->msg), fmt, ap);
+	if (suppressed && len >= 0 && len < (int)sizeof(slot->msg)) {
+		snprintf(slot->msg + len, sizeof(slot->msg) - len,
+			" (%d similar messages suppressed)", suppressed);
+	}
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+	sem_post(&ready);
+}
+
+/* Write the filled slots in order */
+static void drain(void)
+{
+	LOG_SLOT *slot;
+	char *end;
+
+	for (;;) {
+		slot = &ring[tail & SYNC_LOG_MASK];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != tail + 1) {
+			break;
+		}
+
+		end = slot->msg + strlen(slot->msg);
+		if (end > slot->msg && end[-1] == '\n') {
+			end[-1] = '\0';
+		}
+		write_message(slot->level, slot->msg);
+
+		__atomic_store_n(&slot->seq, tail + SYNC_LOG_SLOTS, __ATOMIC_RELEASE);
+		tail++;
+	}
+}
+
+static void *log_writer(void *arg)
+{
+	unsigned long long reported = 0, lost;
+	char msg[SYNC_LOG_MSG_SIZE];
+
+	(void)arg;
+	while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+		if (sem_wait(&ready) < 0 && errno != EINTR) {
+			break;
+		}
+		drain();
+
+		lost = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+		if (lost != reported) {
+			snprintf(msg, sizeof(msg), "%llu log messages dropped", lost - reported);
+			write_message(LOG_WARNING, msg);
+			reported = lost;
+		}
+	}
+	drain();
+
+	return NULL;
+}
+
+int sync_log_open(int use_syslog, int level)
+{
+	sigset_t all, old;
+	unsigned int i;
+	int ret;
+
+	log_syslog = use_syslog;
+	log_level = level;
+	if (log_syslog) {
+		openlog("ServiceSyncTime", LOG_PID, LOG_DAEMON);
+	}
+
+	for (i = 0; i < SYNC_LOG_SLOTS; i++) {
+		ring[i].seq = i;
+	}
+	head = tail = 0;
+	if (sem_init(&ready, 0, 0) < 0) {
+		return -1;
+	}
+
+	/* The signals are handled by the main thread only */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	ret = pthread_create(&writer, NULL, log_writer, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (ret != 0) {
+		fprintf(stderr, "pthread_create() fail: %s\n", strerror(ret));
+		sem_destroy(&ready);
+		return -1;
+	}
+
+	__atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+void sync_log_close(void)
+{
+	if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+
+	__atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+	sem_post(&ready);
+	pthread_join(writer, NULL);
+	__atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+	sem_destroy(&ready);
+
+	if (log_syslog) {
+		closelog();
+	}
+}
+
+void sync_log(int level, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (level > log_level) {
+		return;
+	}
+
+	va_start(ap, fmt);
+	log_queue(level, 0, fmt, ap);
+	va_end(ap);
+}
+
+void sync_log_limited(SYNC_LOG_LIMIT *limit, int level, const char *fmt, ...)
+{
+	struct timespec now;
+	int suppressed = 0;
+	long window;
+	va_list ap;
+
+	if (level > log_level) {
+		return;
+	}
+
+	/* A new window reports how many messages the previous one dropped */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	window = now.tv_sec / SYNC_LOG_WINDOW;
+	if (__atomic_exchange_n(&limit->window, window, __ATOMIC_RELAXED) != window) {
+		suppressed = __atomic_exchange_n(&limit->suppressed, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&limit->count, 0, __ATOMIC_RELAXED);
+	}
+
+	if (__atomic_add_fetch(&limit->count, 1, __ATOMIC_RELAXED) > SYNC_LOG_BURST) {
+		__atomic_add_fetch(&limit->suppressed, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	va_start(ap, fmt);
+	log_queue(level, suppressed, fmt, ap);
+	va_end(ap);
+}
+
+unsigned long long sync_log_dropped(void)
+{
+	return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
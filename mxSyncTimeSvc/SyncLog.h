@@ -0,0 +1,77 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncLog.h : asynchronous logging of the IRIG-B time sync daemon.
+ *
+ * A message is formatted into a slot of a lock-free ring and written by a
+ * background thread to syslog or stderr, so a sampling thread never blocks
+ * on the console or the journal. A full ring drops the message and counts it.
+ * SYNC_LOG limits every call site to a burst of messages per time window.
+ */
+
+#ifndef __SYNCLOG_H_
+#define __SYNCLOG_H_
+
+#include <syslog.h>
+
+#define SYNC_LOG_SLOTS			256	/* ring size, a power of 2 */
+#define SYNC_LOG_MSG_SIZE		160	/* message size with the '\0' */
+#define SYNC_LOG_BURST			5	/* messages per call site and window */
+#define SYNC_LOG_WINDOW			60	/* rate limit window in seconds */
+#define DEFAULT_LOG_LEVEL		LOG_INFO
+
+/* Rate limit state of a call site */
+typedef struct _SYNC_LOG_LIMIT {
+	long window;			/* the current window number */
+	int count;			/* messages in the current window */
+	int suppressed;			/* messages dropped in the current window */
+} SYNC_LOG_LIMIT;
+
+/* Log a message at most SYNC_LOG_BURST times per SYNC_LOG_WINDOW from this call site */
+#define SYNC_LOG(level, ...)	do { \
+		static SYNC_LOG_LIMIT _sync_log_limit; \
+		sync_log_limited(&_sync_log_limit, level, __VA_ARGS__); \
+	} while (0)
+
+/**
+ * Start the log writer thread. Before it, the messages are written to stderr directly.
+ * @param  [in] use_syslog - nonzero to write to syslog, else to stderr
+ * @param  [in] level - the least important level written, LOG_ERR ~ LOG_DEBUG
+ * @return If the operation completes successfully, the return value is zero.
+ */
+int sync_log_open(int use_syslog, int level);
+
+/**
+ * Write the queued messages and stop the log writer thread
+ * @return None
+ */
+void sync_log_close(void);
+
+/**
+ * Queue a message, never blocks
+ * @param  [in] level - the syslog level of the message
+ * @param  [in] fmt - printf format of the message
+ * @return None
+ */
+void sync_log(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * Queue a message unless its call site exceeded the rate limit
+ * @param  [in] limit - the call site rate limit state
+ * @param  [in] level - the syslog level of the message
+ * @param  [in] fmt - printf format of the message
+ * @return None
+ */
+void sync_log_limited(SYNC_LOG_LIMIT *limit, int level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+/**
+ * Get the number of messages lost to a full ring
+ * @return The number of dropped messages
+ */
+unsigned long long sync_log_dropped(void);
+
+#endif  // __SYNCLOG_H_
@@ -0,0 +1,637 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncMetrics.cpp : OpenMetrics (Prometheus) exporter of the IRIG-B time sync daemon.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+#include "SyncMetrics.h"
+#include "SyncDevice.h"
+#include "SyncLog.h"
+
+#define SYNCMETRICS_BACKLOG		4
+#define SYNCMETRICS_CLIENT_TIMEOUT	2	/* seconds to wait for the request */
+#define SYNCMETRICS_BODY_SIZE		65536
+#define SYNCMETRICS_HEADER_SIZE		256
+
+const double sync_offset_bounds[SYNC_HIST_BUCKETS] = {
+	100e-9, 1e-6, 10e-6, 100e-6, 1e-3, 10e-3, 100e-3, 1.0
+};
+
+const double sync_latency_bounds[SYNC_HIST_BUCKETS] = {
+	1e-6, 2e-6, 5e-6, 10e-6, 20e-6, 50e-6, 100e-6, 1e-3
+};
+
+const double sync_wakeup_bounds[SYNC_HIST_BUCKETS] = {
+	10e-6, 50e-6, 100e-6, 500e-6, 1e-3, 5e-3, 10e-3, 100e-3
+};
+
+static const char *strInput[SYNC_INPUT_MAX] = {
+	"fiber",
+	"port1"
+};
+
+/* Scrapes are rendered here, nothing is allocated while serving */
+static char body[SYNCMETRICS_BODY_SIZE];
+static char header[SYNCMETRICS_HEADER_SIZE];
+static SYNC_STATE snapshot;
+
+typedef struct _METRICS_BUF {
+	char *buf;
+	int size;
+	int len;
+} METRICS_BUF;
+
+static void emit(METRICS_BUF *b, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	if (b->len >= b->size) {
+		return;
+	}
+
+	va_start(ap, fmt);
+	n = vsnprintf(b->buf + b->len, b->size - b->len, fmt, ap);
+	va_end(ap);
+
+	if (n > 0) {
+		b->len += n;
+	}
+}
+
+void sync_histogram_add(SYNC_HISTOGRAM *h, const double *bounds, double value)
+{
+	int i;
+
+	for (i = 0; i < SYNC_HIST_BUCKETS; i++) {
+		if (value <= bounds[i]) {
+			break;
+		}
+	}
+
+	h->bucket[i]++;
+	h->count++;
+	h->sum += value;
+}
+
+static void emit_histogram_header(METRICS_BUF *b, const char *name, const char *help)
+{
+	emit(b, "# TYPE %s histogram\n# UNIT %s seconds\n# HELP %s %s\n",
+		name, name, name, help);
+}
+
+static void emit_histogram(METRICS_BUF *b, const char *name, int card,
+	SYNC_HISTOGRAM *h, const double *bounds)
+{
+	unsigned long long cumulative = 0;
+	int i;
+
+	for (i = 0; i < SYNC_HIST_BUCKETS; i++) {
+		cumulative += h->bucket[i];
+		emit(b, "%s_bucket{card=\"%d\",le=\"%g\"} %llu\n", name, card, bounds[i], cumulative);
+	}
+	emit(b, "%s_bucket{card=\"%d\",le=\"+Inf\"} %llu\n", name, card, h->count);
+	emit(b, "%s_count{card=\"%d\"} %llu\n%s_sum{card=\"%d\"} %.9f\n",
+		name, card, h->count, name, card, h->sum);
+}
+
+static void emit_counter(METRICS_BUF *b, const char *name, const char *help,
+	unsigned long long value)
+{
+	emit(b, "# TYPE %s counter\n# HELP %s %s\n%s_total %llu\n",
+		name, name, help, name, value);
+}
+
+static int render(SYNC_STATE *state)
+{
+	METRICS_BUF b = { body, sizeof(body), 0 };
+	struct timespec now;
+	double holdover = 0.0;
+	SYNC_DEVICE *dev;
+	int i, n;
+
+	if (state->servo.state == SERVO_HOLDOVER) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		holdover = (now.tv_sec - state->holdover_start.tv_sec) +
+			(now.tv_nsec - state->holdover_start.tv_nsec) / 1e9;
+	}
+
+	/* Per card, the samples of a family must stay together */
+	emit(&b, "# TYPE mxirigb_module info\n# HELP mxirigb_module IRIG-B module information\n");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		emit(&b, "mxirigb_module_info{card=\"%d\",hwid=\"%lu\",time_source=\"%d\"} 1\n",
+			dev->index, dev->hwid, dev->time_source);
+	}
+
+	emit(&b, "# TYPE mxirigb_offset_seconds gauge\n# UNIT mxirigb_offset_seconds seconds\n"
+		"# HELP mxirigb_offset_seconds IRIG-B RTC time minus system time\n");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		emit(&b, "mxirigb_offset_seconds{card=\"%d\"} %.9f\n", dev->index, dev->offset / 1e9);
+	}
+	emit_histogram_header(&b, "mxirigb_offset_abs_seconds",
+		"Absolute offset between the IRIG-B RTC and the system time");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		emit_histogram(&b, "mxirigb_offset_abs_seconds", dev->index,
+			&dev->offset_hist, sync_offset_bounds);
+	}
+
+	emit(&b, "# TYPE mxirigb_reference gauge\n"
+		"# HELP mxirigb_reference 1 for the card disciplining the system clock\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_reference{card=\"%d\"} %d\n",
+			state->device[n].index, n == state->reference);
+	}
+	emit(&b, "# TYPE mxirigb_healthy gauge\n"
+		"# HELP mxirigb_healthy 1 when the card RTC follows a valid time source\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_healthy{card=\"%d\"} %d\n",
+			state->device[n].index, state->device[n].healthy);
+	}
+
+	emit(&b, "# TYPE mxirigb_accuracy_limit_seconds gauge\n# UNIT mxirigb_accuracy_limit_seconds seconds\n"
+		"# HELP mxirigb_accuracy_limit_seconds Offset limit of the accuracy compliance alarm, 0 for no alarm\n"
+		"mxirigb_accuracy_limit_seconds %.9f\n", state->accuracy / 1e9);
+	emit(&b, "# TYPE mxirigb_accuracy_alarm gauge\n"
+		"# HELP mxirigb_accuracy_alarm Accuracy compliance alarm, 0=none 1=offset 2=time source 3=both\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_accuracy_alarm{card=\"%d\"} %d\n",
+			state->device[n].index, state->device[n].monitor.alarm);
+	}
+	emit(&b, "# TYPE mxirigb_accuracy_alarms counter\n"
+		"# HELP mxirigb_accuracy_alarms Accuracy compliance alarms raised\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_accuracy_alarms_total{card=\"%d\"} %llu\n",
+			state->device[n].index, state->device[n].monitor.alarms);
+	}
+	emit(&b, "# TYPE mxirigb_window_offset_abs_max_seconds gauge\n# UNIT mxirigb_window_offset_abs_max_seconds seconds\n"
+		"# HELP mxirigb_window_offset_abs_max_seconds The largest absolute offset in the sliding window\n");
+	for (n = 0; n < state->device_count; n++) {
+		for (i = 0; i < MONITOR_WINDOWS; i++) {
+			emit(&b, "mxirigb_window_offset_abs_max_seconds{card=\"%d\",window=\"%d\"} %.9f\n",
+				state->device[n].index, sync_monitor_windows[i], monitor_max_abs(&state->device[n].monitor, i) / 1e9);
+		}
+	}
+	emit(&b, "# TYPE mxirigb_mtie_seconds gauge\n# UNIT mxirigb_mtie_seconds seconds\n"
+		"# HELP mxirigb_mtie_seconds The worst peak to peak offset in a sliding window of the length\n");
+	for (n = 0; n < state->device_count; n++) {
+		for (i = 0; i < MONITOR_WINDOWS; i++) {
+			emit(&b, "mxirigb_mtie_seconds{card=\"%d\",window=\"%d\"} %.9f\n",
+				state->device[n].index, sync_monitor_windows[i], state->device[n].monitor.window[i].mtie / 1e9);
+		}
+	}
+
+	emit(&b, "# TYPE mxirigb_time_source gauge\n"
+		"# HELP mxirigb_time_source Time source the RTC follows, 0=free run 1=fiber 2=port1 3=pps\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_time_source{card=\"%d\"} %d\n",
+			state->device[n].index, state->device[n].time_source);
+	}
+	emit(&b, "# TYPE mxirigb_source_quality gauge\n"
+		"# HELP mxirigb_source_quality Moving average of the polls with a normal signal\n");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		for (i = 0; i < SYNC_INPUT_MAX; i++) {
+			emit(&b, "mxirigb_source_quality{card=\"%d\",port=\"%s\"} %.3f\n",
+				dev->index, strInput[i], dev->source.input[i].quality);
+		}
+	}
+	emit(&b, "# TYPE mxirigb_source_switches counter\n"
+		"# HELP mxirigb_source_switches Automatic switches between the Fiber port and IRIG-B port 1\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_source_switches_total{card=\"%d\"} %llu\n",
+			state->device[n].index, state->device[n].source.switches);
+	}
+	emit(&b, "# TYPE mxirigb_decoder_mismatch gauge\n"
+		"# HELP mxirigb_decoder_mismatch The Fiber and port 1 decoders disagree on the time\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_decoder_mismatch{card=\"%d\"} %d\n",
+			state->device[n].index, state->device[n].decoder_mismatch);
+	}
+	emit(&b, "# TYPE mxirigb_decoder_diff_seconds gauge\n# UNIT mxirigb_decoder_diff_seconds seconds\n"
+		"# HELP mxirigb_decoder_diff_seconds IRIG-B port 1 signal time minus Fiber signal time\n");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		if (dev->decoder_valid) {
+			emit(&b, "mxirigb_decoder_diff_seconds{card=\"%d\"} %.9f\n", dev->index, dev->decoder_diff / 1e9);
+		}
+	}
+	emit(&b, "# TYPE mxirigb_rtc_decoder_phase_seconds gauge\n# UNIT mxirigb_rtc_decoder_phase_seconds seconds\n"
+		"# HELP mxirigb_rtc_decoder_phase_seconds IRIG-B RTC time minus the signal time of the decoder it follows\n");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		if (dev->decoder_phase_valid) {
+			emit(&b, "mxirigb_rtc_decoder_phase_seconds{card=\"%d\"} %.9f\n", dev->index, dev->decoder_phase / 1e9);
+		}
+	}
+	emit(&b, "# TYPE mxirigb_input_delay_seconds gauge\n# UNIT mxirigb_input_delay_seconds seconds\n"
+		"# HELP mxirigb_input_delay_seconds Cable delay of the time source added to the RTC time\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_input_delay_seconds{card=\"%d\"} %.9f\n",
+			state->device[n].index, state->device[n].input_delay / 1e9);
+	}
+	emit(&b, "# TYPE mxirigb_output_advance_seconds gauge\n# UNIT mxirigb_output_advance_seconds seconds\n"
+		"# HELP mxirigb_output_advance_seconds Time the free running RTC leads for the output cables\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_output_advance_seconds{card=\"%d\"} %.9f\n",
+			state->device[n].index, state->device[n].output_advance / 1e9);
+	}
+	emit(&b, "# TYPE mxirigb_decoder_mismatches counter\n"
+		"# HELP mxirigb_decoder_mismatches Disagreements raised between the Fiber and port 1 decoders\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_decoder_mismatches_total{card=\"%d\"} %llu\n",
+			state->device[n].index, state->device[n].decoder_mismatches);
+	}
+	emit(&b, "# TYPE mxirigb_pps_timeouts counter\n"
+		"# HELP mxirigb_pps_timeouts Time outs of the PPS input the RTC follows\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_pps_timeouts_total{card=\"%d\"} %llu\n",
+			state->device[n].index, state->device[n].pps_timeouts);
+	}
+	emit(&b, "# TYPE mxirigb_pps_seconds_set counter\n"
+		"# HELP mxirigb_pps_seconds_set RTC seconds set from the system time with the PPS input\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_pps_seconds_set_total{card=\"%d\"} %llu\n",
+			state->device[n].index, state->device[n].pps_seconds_set);
+	}
+
+	emit(&b, "# TYPE mxirigb_frequency_adjustment_ppb gauge\n"
+		"# HELP mxirigb_frequency_adjustment_ppb Frequency correction applied to the system clock\n"
+		"mxirigb_frequency_adjustment_ppb %.3f\n", state->freq);
+	emit(&b, "# TYPE mxirigb_servo_state gauge\n"
+		"# HELP mxirigb_servo_state Servo state, 0=unlocked 1=jump 2=locked 3=holdover\n"
+		"mxirigb_servo_state %d\n", state->servo.state);
+	emit(&b, "# TYPE mxirigb_sync_interval_seconds gauge\n# UNIT mxirigb_sync_interval_seconds seconds\n"
+		"# HELP mxirigb_sync_interval_seconds Time sync interval\n"
+		"mxirigb_sync_interval_seconds %ld\n", state->interval);
+	emit(&b, "# TYPE mxirigb_sample_rate_hertz gauge\n# UNIT mxirigb_sample_rate_hertz hertz\n"
+		"# HELP mxirigb_sample_rate_hertz RTC samples per second, 0 for one sample per interval\n"
+		"mxirigb_sample_rate_hertz %d\n", state->rate);
+	emit(&b, "# TYPE mxirigb_decimation gauge\n"
+		"# HELP mxirigb_decimation Samples averaged into one servo update\n"
+		"mxirigb_decimation %d\n", state->rate > 0 ? state->decimation : 1);
+	emit(&b, "# TYPE mxirigb_sample_phase_seconds gauge\n# UNIT mxirigb_sample_phase_seconds seconds\n"
+		"# HELP mxirigb_sample_phase_seconds Delay of the card sampling after the second\n"
+		"mxirigb_sample_phase_seconds %.3f\n", state->phase / 1e9);
+	emit(&b, "# TYPE mxirigb_last_sync_timestamp_seconds gauge\n# UNIT mxirigb_last_sync_timestamp_seconds seconds\n"
+		"# HELP mxirigb_last_sync_timestamp_seconds System time of the last successful sync\n"
+		"mxirigb_last_sync_timestamp_seconds %ld.%09ld\n",
+		(long)state->last_sync.tv_sec, state->last_sync.tv_nsec);
+
+	emit(&b, "# TYPE mxirigb_holdover_seconds gauge\n# UNIT mxirigb_holdover_seconds seconds\n"
+		"# HELP mxirigb_holdover_seconds Duration of the current holdover\n"
+		"mxirigb_holdover_seconds %.3f\n", holdover);
+	emit(&b, "# TYPE mxirigb_holdover_accumulated_seconds counter\n# UNIT mxirigb_holdover_accumulated_seconds seconds\n"
+		"# HELP mxirigb_holdover_accumulated_seconds Time spent in holdover\n"
+		"mxirigb_holdover_accumulated_seconds_total %.3f\n", state->holdover_total + holdover);
+
+	emit(&b, "# TYPE mxirigb_signal_status gauge\n"
+		"# HELP mxirigb_signal_status Signal status, 0=normal 1=off line 2=frame error 3=parity error 4=unknown\n");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		for (i = 0; i < SYNC_INPUT_MAX; i++) {
+			emit(&b, "mxirigb_signal_status{card=\"%d\",port=\"%s\"} %lu\n",
+				dev->index, strInput[i], dev->signal_status[i]);
+		}
+	}
+
+	emit(&b, "# TYPE mxirigb_signal_off_line_samples counter\n"
+		"# HELP mxirigb_signal_off_line_samples Samples with the signal off line\n");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		for (i = 0; i < SYNC_INPUT_MAX; i++) {
+			emit(&b, "mxirigb_signal_off_line_samples_total{card=\"%d\",port=\"%s\"} %llu\n",
+				dev->index, strInput[i], dev->status_count[i][IRIG_STATUS_OFF_LINE]);
+		}
+	}
+	emit(&b, "# TYPE mxirigb_frame_errors counter\n"
+		"# HELP mxirigb_frame_errors Samples with an IRIG-B frame error\n");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		for (i = 0; i < SYNC_INPUT_MAX; i++) {
+			emit(&b, "mxirigb_frame_errors_total{card=\"%d\",port=\"%s\"} %llu\n",
+				dev->index, strInput[i], dev->status_count[i][IRIG_STATUS_FRAME_ERROR]);
+		}
+	}
+	emit(&b, "# TYPE mxirigb_parity_errors counter\n"
+		"# HELP mxirigb_parity_errors Samples with an IRIG-B parity error\n");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		for (i = 0; i < SYNC_INPUT_MAX; i++) {
+			emit(&b, "mxirigb_parity_errors_total{card=\"%d\",port=\"%s\"} %llu\n",
+				dev->index, strInput[i], dev->status_count[i][IRIG_STATUS_PARITY_ERROR]);
+		}
+	}
+	emit(&b, "# TYPE mxirigb_status_events counter\n"
+		"# HELP mxirigb_status_events Status polls with the status word bit set, whatever the signal status\n");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		for (i = 0; i < IRIGB_STATUS_BITS; i++) {
+			emit(&b, "mxirigb_status_events_total{card=\"%d\",bit=\"%s\"} %lu\n",
+				dev->index, sync_status_bit_name[i], (unsigned long)dev->status_events.bit[i]);
+		}
+	}
+	emit(&b, "# TYPE mxirigb_status_polls counter\n"
+		"# HELP mxirigb_status_polls Status words read\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_status_polls_total{card=\"%d\"} %lu\n",
+			state->device[n].index, (unsigned long)state->device[n].status_events.polls);
+	}
+
+	emit_histogram_header(&b, "mxirigb_rtc_read_latency_seconds",
+		"Duration of the IRIG-B RTC read ioctl");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		emit_histogram(&b, "mxirigb_rtc_read_latency_seconds", dev->index,
+			&dev->latency_hist, sync_latency_bounds);
+	}
+	emit_histogram_header(&b, "mxirigb_wakeup_latency_seconds",
+		"Delay of the sampling thread wake up after its deadline");
+	for (n = 0; n < state->device_count; n++) {
+		dev = &state->device[n];
+		emit_histogram(&b, "mxirigb_wakeup_latency_seconds", dev->index,
+			&dev->wakeup_hist, sync_wakeup_bounds);
+	}
+	emit(&b, "# TYPE mxirigb_wakeup_latency_max_seconds gauge\n# UNIT mxirigb_wakeup_latency_max_seconds seconds\n"
+		"# HELP mxirigb_wakeup_latency_max_seconds The longest sampling thread wake up delay\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_wakeup_latency_max_seconds{card=\"%d\"} %.9f\n",
+			state->device[n].index, state->device[n].wakeup_max / 1e9);
+	}
+	emit(&b, "# TYPE mxirigb_realtime_priority gauge\n"
+		"# HELP mxirigb_realtime_priority SCHED_FIFO priority of the sampling threads, 0 for normal scheduling\n"
+		"mxirigb_realtime_priority %d\n", state->rt_priority);
+
+	emit(&b, "# TYPE mxirigb_samples counter\n# HELP mxirigb_samples IRIG-B RTC samples taken\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_samples_total{card=\"%d\"} %llu\n",
+			state->device[n].index, state->device[n].samples);
+	}
+	emit(&b, "# TYPE mxirigb_read_errors counter\n# HELP mxirigb_read_errors IRIG-B RTC or status read failures\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_read_errors_total{card=\"%d\"} %llu\n",
+			state->device[n].index, state->device[n].read_errors);
+	}
+	emit(&b, "# TYPE mxirigb_rtc_tears counter\n# HELP mxirigb_rtc_tears RTC reads straddling a second and read again\n");
+	for (n = 0; n < state->device_count; n++) {
+		emit(&b, "mxirigb_rtc_tears_total{card=\"%d\"} %llu\n",
+			state->device[n].index, state->device[n].rtc_tears);
+	}
+	emit_counter(&b, "mxirigb_log_dropped", "Log messages lost to a full log ring", sync_log_dropped());
+	emit_counter(&b, "mxirigb_sync_errors", "System clock adjustment failures", state->sync_errors);
+	emit_counter(&b, "mxirigb_steps", "System clock steps", state->steps);
+	emit_counter(&b, "mxirigb_reference_changes", "Switches of the reference card", state->reference_changes);
+
+	emit(&b, "# EOF\n");
+
+	/* A cut body would lose the # EOF */
+	if (b.len >= b.size) {
+		SYNC_LOG(LOG_ERR, "Metrics outgrow the %d bytes body", b.size - 1);
+		return -1;
+	}
+
+	return b.len;
+}
+
+/* Send without waiting for a slow scraper, a short write is logged instead */
+static int send_reply(int client, const char *buf, int len, int flags)
+{
+	int n;
+
+	n = send(client, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT | flags);
+	if (n != len) {
+		SYNC_LOG(LOG_WARNING, "Metrics reply cut at %d of %d bytes: %s", (n < 0) ? 0 : n, len,
+			(n < 0) ? strerror(errno) : "socket buffer full");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void respond(int client, const char *request, SYNC_STATE *state)
+{
+	int hlen, blen, sndbuf;
+
+	if (strncmp(request, "GET ", 4) != 0) {
+		hlen = snprintf(header, sizeof(header),
+			"HTTP/1.0 405 Method Not Allowed\r\nConnection: close\r\n"
+			"Content-Length: 0\r\n\r\n");
+		send_reply(client, header, hlen, 0);
+		return;
+	}
+
+	sync_state_snapshot(state, &snapshot);
+	blen = render(&snapshot);
+	if (blen < 0) {
+		hlen = snprintf(header, sizeof(header),
+			"HTTP/1.0 500 Internal Server Error\r\nConnection: close\r\n"
+			"Content-Length: 0\r\n\r\n");
+		send_reply(client, header, hlen, 0);
+		return;
+	}
+	hlen = snprintf(header, sizeof(header),
+		"HTTP/1.0 200 OK\r\nConnection: close\r\n"
+		"Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+		"Content-Length: %d\r\n\r\n", blen);
+
+	/* A body of many cards outgrows the default send buffer, make the whole reply fit.
+	 * The kernel doubles the size for its bookkeeping, up to net.core.wmem_max. */
+	sndbuf = hlen + blen;
+	if (setsockopt(client, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) < 0) {
+		SYNC_LOG(LOG_WARNING, "setsockopt(SO_SNDBUF) fail: %s", strerror(errno));
+	}
+
+	if (send_reply(client, header, hlen, MSG_MORE) == 0) {
+		send_reply(client, body, blen, 0);
+	}
+}
+
+int sync_metrics_open(SYNC_METRICS *m, const char *address)
+{
+	int i, on = 1;
+
+	memset(m, 0, sizeof(*m));
+	for (i = 0; i < SYNCMETRICS_MAX_CLIENTS; i++) {
+		m->client[i] = -1;
+	}
+
+	if (address[0] == '/') {
+		struct sockaddr_un addr;
+
+		if (strlen(address) >= sizeof(addr.sun_path)) {
+			sync_log(LOG_ERR, "Socket path %s too long", address);
+			m->fd = -1;
+			return -1;
+		}
+
+		m->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (m->fd < 0) {
+			sync_log(LOG_ERR, "socket() fail: %s", strerror(errno));
+			return -1;
+		}
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, address);
+		strcpy(m->path, address);
+		unlink(address);
+
+		if (bind(m->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			sync_log(LOG_ERR, "bind(%s) fail: %s", address, strerror(errno));
+			close(m->fd);
+			m->fd = -1;
+			return -1;
+		}
+	} else {
+		struct sockaddr_in addr;
+		int port = atoi(address);
+
+		if (port <= 0 || port > 65535) {
+			sync_log(LOG_ERR, "Invalid metrics port %s", address);
+			m->fd = -1;
+			return -1;
+		}
+
+		m->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (m->fd < 0) {
+			sync_log(LOG_ERR, "socket() fail: %s", strerror(errno));
+			return -1;
+		}
+		setsockopt(m->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons(port);
+
+		if (bind(m->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			sync_log(LOG_ERR, "bind(%d) fail: %s", port, strerror(errno));
+			close(m->fd);
+			m->fd = -1;
+			return -1;
+		}
+	}
+
+	if (listen(m->fd, SYNCMETRICS_BACKLOG) < 0) {
+		sync_log(LOG_ERR, "listen() fail: %s", strerror(errno));
+		sync_metrics_close(m);
+		return -1;
+	}
+
+	return 0;
+}
+
+void sync_metrics_close(SYNC_METRICS *m)
+{
+	int i;
+
+	for (i = 0; i < SYNCMETRICS_MAX_CLIENTS; i++) {
+		if (m->client[i] >= 0) {
+			close(m->client[i]);
+			m->client[i] = -1;
+		}
+	}
+
+	if (m->fd >= 0) {
+		close(m->fd);
+		m->fd = -1;
+		if (m->path[0]) {
+			unlink(m->path);
+		}
+	}
+}
+
+int sync_metrics_fdset(SYNC_METRICS *m, fd_set *rfds, int maxfd)
+{
+	int i;
+
+	if (m->fd < 0) {
+		return maxfd;
+	}
+
+	FD_SET(m->fd, rfds);
+	if (m->fd > maxfd) {
+		maxfd = m->fd;
+	}
+
+	for (i = 0; i < SYNCMETRICS_MAX_CLIENTS; i++) {
+		if (m->client[i] >= 0) {
+			FD_SET(m->client[i], rfds);
+			if (m->client[i] > maxfd) {
+				maxfd = m->client[i];
+			}
+		}
+	}
+
+	return maxfd;
+}
+
+void sync_metrics_process(SYNC_METRICS *m, fd_set *rfds, SYNC_STATE *state)
+{
+	char request[512];
+	struct timespec now;
+	int i, len;
+
+	if (m->fd < 0) {
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	for (i = 0; i < SYNCMETRICS_MAX_CLIENTS; i++) {
+		if (m->client[i] < 0) {
+			continue;
+		}
+
+		if (FD_ISSET(m->client[i], rfds)) {
+			len = recv(m->client[i], request, sizeof(request) - 1, MSG_DONTWAIT);
+			if (len > 0) {
+				request[len] = '\0';
+				respond(m->client[i], request, state);
+			}
+		} else if (now.tv_sec - m->accepted[i].tv_sec < SYNCMETRICS_CLIENT_TIMEOUT) {
+			continue;
+		}
+
+		/* Answered, closed by the peer or timed out */
+		close(m->client[i]);
+		m->client[i] = -1;
+	}
+
+	if (FD_ISSET(m->fd, rfds)) {
+		int client = accept4(m->fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+
+		if (client < 0) {
+			return;
+		}
+
+		for (i = 0; i < SYNCMETRICS_MAX_CLIENTS; i++) {
+			if (m->client[i] < 0) {
+				m->client[i] = client;
+				m->accepted[i] = now;
+				return;
+			}
+		}
+
+		/* Too many scrapers at the same time */
+		close(client);
+	}
+}
@@ -0,0 +1,79 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncMetrics.h : OpenMetrics (Prometheus) exporter of the IRIG-B time sync daemon.
+ *
+ * The exporter answers every HTTP GET with the OpenMetrics text exposition
+ * of the daemon state. It listens on a TCP port, or on a local socket when
+ * the address starts with '/'.
+ */
+
+#ifndef __SYNCMETRICS_H_
+#define __SYNCMETRICS_H_
+
+#include <sys/select.h>
+#include "SyncState.h"
+
+#define SYNCMETRICS_MAX_CLIENTS		4
+
+typedef struct _SYNC_METRICS {
+	int fd;					/* listening socket */
+	char path[108];				/* local socket path, empty for TCP */
+	int client[SYNCMETRICS_MAX_CLIENTS];	/* connections waiting for a request */
+	struct timespec accepted[SYNCMETRICS_MAX_CLIENTS];
+} SYNC_METRICS;
+
+/* Upper bounds of the offset histogram buckets in seconds */
+extern const double sync_offset_bounds[SYNC_HIST_BUCKETS];
+/* Upper bounds of the RTC read latency histogram buckets in seconds */
+extern const double sync_latency_bounds[SYNC_HIST_BUCKETS];
+/* Upper bounds of the sampling thread wake up delay histogram buckets in seconds */
+extern const double sync_wakeup_bounds[SYNC_HIST_BUCKETS];
+
+/**
+ * Count a value into a histogram
+ * @param  [in] h - the histogram
+ * @param  [in] bounds - the bucket upper bounds
+ * @param  [in] value - the observed value
+ * @return None
+ */
+void sync_histogram_add(SYNC_HISTOGRAM *h, const double *bounds, double value);
+
+/**
+ * Start the exporter
+ * @param  [in] m - the exporter
+ * @param  [in] address - TCP port number or local socket path
+ * @return If the operation completes successfully, the return value is zero.
+ */
+int sync_metrics_open(SYNC_METRICS *m, const char *address);
+
+/**
+ * Stop the exporter
+ * @param  [in] m - the exporter
+ * @return None
+ */
+void sync_metrics_close(SYNC_METRICS *m);
+
+/**
+ * Add the exporter sockets to a select() read set
+ * @param  [in] m - the exporter
+ * @param  [in,out] rfds - the read set
+ * @param  [in] maxfd - the highest descriptor in rfds
+ * @return The highest descriptor in rfds
+ */
+int sync_metrics_fdset(SYNC_METRICS *m, fd_set *rfds, int maxfd);
+
+/**
+ * Accept new connections and answer the pending requests
+ * @param  [in] m - the exporter
+ * @param  [in] rfds - the read set return from select()
+ * @param  [in] state - the daemon state to export
+ * @return None
+ */
+void sync_metrics_process(SYNC_METRICS *m, fd_set *rfds, SYNC_STATE *state);
+
+#endif  // __SYNCMETRICS_H_
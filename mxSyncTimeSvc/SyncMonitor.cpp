@@ -0,0 +1,263 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncMonitor.cpp : online time accuracy compliance monitor of the IRIG-B time sync daemon.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include "SyncMonitor.h"
+
+const int sync_monitor_windows[MONITOR_WINDOWS] = { 1, 10, 100, 1000 };
+
+/* IEC 61850-5 time synchronization classes, the largest time error in ns */
+static const struct {
+	const char *name;
+	long long limit;
+} time_class[] = {
+	{ "T5", 1000 },
+	{ "T4", 4000 },
+	{ "T3", 25000 },
+	{ "T2", 100000 },
+	{ "T1", 1000000 },
+};
+
+#define TIME_CLASSES			(int)(sizeof(time_class) / sizeof(time_class[0]))
+
+/* Bucket b holds |offset| below 2^(b/2) ns, the last one everything above */
+static int hist_index(long long v)
+{
+	int b;
+
+	if (v < 0) {
+		v = -v;
+	}
+	if (v < 1) {
+		return 0;
+	}
+	b = (int)(2 * log2((double)v)) + 1;
+
+	return b < MONITOR_HIST_BUCKETS ? b : MONITOR_HIST_BUCKETS - 1;
+}
+
+/* Start the slots due by now, the oldest slots are cleared */
+static void window_advance(SYNC_MONITOR *m, int w, long long now)
+{
+	MONITOR_WINDOW *win = &m->window[w];
+	long long slot_length = win->length / MONITOR_SLOTS;
+	int i, n;
+
+	if (win->slot_start == 0 || now < win->slot_start) {
+		n = MONITOR_SLOTS;
+	} else {
+		n = (now - win->slot_start) / slot_length;
+		if (n > MONITOR_SLOTS) {
+			n = MONITOR_SLOTS;
+		}
+	}
+	if (n == 0) {
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		win->current = (win->current + 1) % MONITOR_SLOTS;
+		win->slot[win->current].count = 0;
+
+		/* The longest window carries the histogram */
+		if (w == MONITOR_WINDOWS - 1) {
+			for (int b = 0; b < MONITOR_HIST_BUCKETS; b++) {
+				m->hist_sum[b] -= m->hist[win->current][b];
+				m->hist_count -= m->hist[win->current][b];
+				m->hist[win->current][b] = 0;
+			}
+		}
+	}
+	win->slot_start = now - now % slot_length;
+}
+
+static void window_add(SYNC_MONITOR *m, int w, long long now, long long offset)
+{
+	MONITOR_WINDOW *win = &m->window[w];
+	MONITOR_SLOT *slot;
+	long long pp;
+
+	window_advance(m, w, now);
+
+	slot = &win->slot[win->current];
+	if (slot->count == 0 || offset < slot->min) {
+		slot->min = offset;
+	}
+	if (slot->count == 0 || offset > slot->max) {
+		slot->max = offset;
+	}
+	slot->count++;
+
+	if (w == MONITOR_WINDOWS - 1) {
+		int b = hist_index(offset);
+
+		m->hist[win->current][b]++;
+		m->hist_sum[b]++;
+		m->hist_count++;
+	}
+
+	pp = monitor_peak_to_peak(m, w);
+	if (pp > win->mtie) {
+		win->mtie = pp;
+	}
+}
+
+void monitor_init(SYNC_MONITOR *m)
+{
+	int w;
+
+	memset(m, 0, sizeof(*m));
+	for (w = 0; w < MONITOR_WINDOWS; w++) {
+		m->window[w].length = sync_monitor_windows[w] * 1000000000LL;
+	}
+}
+
+int monitor_sample(SYNC_MONITOR *m, long long now, int valid, int healthy, long long offset, long long limit)
+{
+	int w, alarm = m->alarm;
+
+	if (valid) {
+		for (w = 0; w < MONITOR_WINDOWS; w++) {
+			window_add(m, w, now, offset);
+		}
+	}
+
+	if (limit <= 0) {
+		m->alarm = m->bad = m->lost = m->good = 0;
+		return alarm;
+	}
+
+	/* Without a valid time source the offset tells nothing of the time error */
+	m->lost = (!valid || !healthy) ? m->lost + 1 : 0;
+	m->bad = (valid && llabs(offset) > limit) ? m->bad + 1 : 0;
+	m->good = (valid && healthy && llabs(offset) <= limit * MONITOR_CLEAR_RATIO) ? m->good + 1 : 0;
+
+	if (m->lost >= MONITOR_RAISE_COUNT) {
+		m->alarm |= MONITOR_ALARM_SOURCE;
+	}
+	if (m->bad >= MONITOR_RAISE_COUNT) {
+		m->alarm |= MONITOR_ALARM_OFFSET;
+	}
+	if (m->good >= MONITOR_CLEAR_COUNT) {
+		m->alarm = 0;
+	}
+
+	if (m->alarm != alarm) {
+		clock_gettime(CLOCK_REALTIME, &m->alarm_since);
+		if (m->alarm & ~alarm) {
+			m->alarms++;
+		}
+	}
+
+	return m->alarm ^ alarm;
+}
+
+long long monitor_max_abs(const SYNC_MONITOR *m, int w)
+{
+	const MONITOR_WINDOW *win = &m->window[w];
+	long long v = 0;
+	int i;
+
+	for (i = 0; i < MONITOR_SLOTS; i++) {
+		if (win->slot[i].count) {
+			v = llabs(win->slot[i].min) > v ? llabs(win->slot[i].min) : v;
+			v = llabs(win->slot[i].max) > v ? llabs(win->slot[i].max) : v;
+		}
+	}
+
+	return v;
+}
+
+long long monitor_peak_to_peak(const SYNC_MONITOR *m, int w)
+{
+	const MONITOR_WINDOW *win = &m->window[w];
+	long long min = 0, max = 0;
+	int i, n = 0;
+
+	for (i = 0; i < MONITOR_SLOTS; i++) {
+		if (win->slot[i].count == 0) {
+			continue;
+		}
+		if (n == 0 || win->slot[i].min < min) {
+			min = win->slot[i].min;
+		}
+		if (n == 0 || win->slot[i].max > max) {
+			max = win->slot[i].max;
+		}
+		n++;
+	}
+
+	return max - min;
+}
+
+long long monitor_percentile(const SYNC_MONITOR *m, double q)
+{
+	unsigned int target, seen = 0;
+	long long v, max;
+	int b;
+
+	if (m->hist_count == 0) {
+		return 0;
+	}
+	target = (unsigned int)ceil(q * m->hist_count);
+	if (target < 1) {
+		target = 1;
+	}
+
+	for (b = 0; b < MONITOR_HIST_BUCKETS - 1; b++) {
+		seen += m->hist_sum[b];
+		if (seen >= target) {
+			break;
+		}
+	}
+
+	/* The bucket bound may be beyond the samples */
+	v = (long long)ceil(pow(2, b / 2.0));
+	max = monitor_max_abs(m, MONITOR_WINDOWS - 1);
+
+	return v < max ? v : max;
+}
+
+long long monitor_limit(const char *name)
+{
+	char *end;
+	long long v;
+	int i;
+
+	for (i = 0; i < TIME_CLASSES; i++) {
+		if (strcasecmp(name, time_class[i].name) == 0) {
+			return time_class[i].limit;
+		}
+	}
+
+	v = strtoll(name, &end, 0);
+	if (end == name || *end != '\0' || v < 0 || v > MAX_MONITOR_LIMIT) {
+		return -1;
+	}
+
+	return v;
+}
+
+const char *monitor_class_name(long long limit)
+{
+	int i;
+
+	for (i = 0; i < TIME_CLASSES; i++) {
+		if (limit > 0 && limit <= time_class[i].limit) {
+			return time_class[i].name;
+		}
+	}
+
+	return "none";
+}
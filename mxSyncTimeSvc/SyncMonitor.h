@@ -0,0 +1,132 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncMonitor.h : online time accuracy compliance monitor of the IRIG-B time sync daemon.
+ *
+ * Every card keeps sliding windows of 1 s, 10 s, 100 s and 1000 s over its
+ * offsets. A window is a ring of MONITOR_SLOTS slots holding the minimum,
+ * maximum and count of their samples, so a sample costs the same whatever the
+ * rate: the max |offset| and the peak to peak time error (the MTIE of the
+ * window length) are read from the slots, the worst MTIE is kept. The slots of
+ * the longest window also hold a log histogram of |offset| for the running
+ * percentiles.
+ *
+ * With an accuracy limit, e.g. the IEC 61850-5 T4 class of 4 us, the alarm of
+ * a card is raised after MONITOR_RAISE_COUNT consecutive samples beyond the
+ * limit or without a valid time source, and cleared after MONITOR_CLEAR_COUNT
+ * consecutive samples within MONITOR_CLEAR_RATIO of the limit.
+ */
+
+#ifndef __SYNCMONITOR_H_
+#define __SYNCMONITOR_H_
+
+#include <time.h>
+
+#define MONITOR_WINDOWS			4		/* 1 s, 10 s, 100 s and 1000 s */
+#define MONITOR_SLOTS			10		/* slots of a window, the window covers 9 to 10 slots */
+#define MONITOR_HIST_BUCKETS		48		/* |offset| buckets growing by sqrt(2) from 1 ns to 16 ms */
+#define MONITOR_RAISE_COUNT		3		/* consecutive bad samples raising the alarm */
+#define MONITOR_CLEAR_COUNT		10		/* consecutive good samples clearing the alarm */
+#define MONITOR_CLEAR_RATIO		0.8		/* a good sample is within this part of the limit */
+#define MAX_MONITOR_LIMIT		1000000000LL	/* 1 s */
+
+enum _MONITOR_ALARM_
+{
+	MONITOR_ALARM_OFFSET = 1 << 0,		/* |offset| beyond the limit */
+	MONITOR_ALARM_SOURCE = 1 << 1		/* the RTC does not follow a valid time source */
+};
+
+typedef struct _MONITOR_SLOT {
+	long long min;			/* the least offset in ns */
+	long long max;			/* the greatest offset in ns */
+	unsigned int count;		/* samples in the slot */
+} MONITOR_SLOT;
+
+typedef struct _MONITOR_WINDOW {
+	long long length;		/* window length in ns */
+	long long slot_start;		/* monotonic time the current slot started in ns */
+	int current;			/* the slot taking the samples */
+	MONITOR_SLOT slot[MONITOR_SLOTS];
+	long long mtie;			/* the worst peak to peak offset of the window in ns */
+} MONITOR_WINDOW;
+
+typedef struct _SYNC_MONITOR {
+	MONITOR_WINDOW window[MONITOR_WINDOWS];
+	unsigned int hist[MONITOR_SLOTS][MONITOR_HIST_BUCKETS];	/* per slot of the longest window */
+	unsigned int hist_sum[MONITOR_HIST_BUCKETS];	/* the sum of the slots */
+	unsigned int hist_count;
+
+	/* Alarm */
+	int alarm;			/* _MONITOR_ALARM_ bits raised, 0 if none */
+	int bad;			/* consecutive samples beyond the limit */
+	int lost;			/* consecutive samples without a valid time source */
+	int good;			/* consecutive samples within the clear level */
+	struct timespec alarm_since;	/* system time the alarm was raised or cleared last */
+	unsigned long long alarms;	/* alarms raised */
+} SYNC_MONITOR;
+
+/* Lengths of the windows in seconds */
+extern const int sync_monitor_windows[MONITOR_WINDOWS];
+
+/**
+ * Clear the windows and the alarm
+ * @param  [in] m - the monitor
+ * @return None
+ */
+void monitor_init(SYNC_MONITOR *m);
+
+/**
+ * Feed a sample
+ * @param  [in] m - the monitor
+ * @param  [in] now - the monotonic time of the sample in ns
+ * @param  [in] valid - nonzero with an RTC offset
+ * @param  [in] healthy - nonzero if the RTC follows a valid time source
+ * @param  [in] offset - the RTC time minus the system time in ns
+ * @param  [in] limit - the accuracy limit in ns, 0 for no alarm
+ * @return The _MONITOR_ALARM_ bits raised or cleared by this sample, 0 if unchanged
+ */
+int monitor_sample(SYNC_MONITOR *m, long long now, int valid, int healthy, long long offset, long long limit);
+
+/**
+ * Get the largest |offset| of a window
+ * @param  [in] m - the monitor
+ * @param  [in] w - the window index
+ * @return The offset in ns, 0 without samples
+ */
+long long monitor_max_abs(const SYNC_MONITOR *m, int w);
+
+/**
+ * Get the peak to peak offset of a window
+ * @param  [in] m - the monitor
+ * @param  [in] w - the window index
+ * @return The time interval error in ns, 0 without samples
+ */
+long long monitor_peak_to_peak(const SYNC_MONITOR *m, int w);
+
+/**
+ * Get a percentile of |offset| over the longest window
+ * @param  [in] m - the monitor
+ * @param  [in] q - the fraction of the samples at or below the result, 0 ~ 1
+ * @return The upper bound of the bucket in ns, within sqrt(2), 0 without samples
+ */
+long long monitor_percentile(const SYNC_MONITOR *m, double q);
+
+/**
+ * Get the accuracy limit of a class name
+ * @param  [in] name - T1 ~ T5 of IEC 61850-5, or the limit in ns
+ * @return The limit in ns, -1 if invalid
+ */
+long long monitor_limit(const char *name);
+
+/**
+ * Get the best IEC 61850-5 class of a limit
+ * @param  [in] limit - the accuracy limit in ns
+ * @return T1 ~ T5, or "none"
+ */
+const char *monitor_class_name(long long limit);
+
+#endif  // __SYNCMONITOR_H_
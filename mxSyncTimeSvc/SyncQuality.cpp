@@ -0,0 +1,181 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncQuality.cpp : time quality export of the IRIG-B time sync daemon.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "SyncQuality.h"
+#include "SyncLog.h"
+
+static long long elapsed_ns(const struct timespec *since, const struct timespec *now)
+{
+	if (since->tv_sec == 0 && since->tv_nsec == 0) {
+		return 0;
+	}
+
+	return (now->tv_sec - since->tv_sec) * 1000000000LL + (now->tv_nsec - since->tv_nsec);
+}
+
+/* Write a slot, readers retry while the sequence is odd or has changed */
+static void slot_write(TIME_QUALITY_SLOT *slot, TIME_QUALITY *quality, const struct timespec *update)
+{
+	quality->updateSec = update->tv_sec;
+	quality->updateNsec = update->tv_nsec;
+	mxIrigbEvalTimeQuality(quality);
+
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(&slot->quality, quality, sizeof(*quality));
+	__atomic_store_n(&slot->used, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* The RTC of a card: its source tq and the holdover since the source was lost */
+static void device_quality(SYNC_DEVICE *dev, const struct timespec *now, TIME_QUALITY *q)
+{
+	memset(q, 0, sizeof(*q));
+	q->failure = !dev->rtc_valid || dev->samples == 0;
+	q->synchronized = dev->healthy;
+	q->synced = dev->synced;
+	q->tq = dev->rtc.tq;
+	q->lsp = dev->rtc.lsp;
+	q->ls = dev->rtc.ls;
+	q->dst = dev->rtc.dst;
+	if (!dev->healthy) {
+		q->holdover = elapsed_ns(&dev->lost_since, now);
+	}
+}
+
+/* The system clock: the reference RTC plus the offset the servo still has to remove */
+static void system_quality(SYNC_STATE *state, const struct timespec *now, TIME_QUALITY *q)
+{
+	SYNC_DEVICE *ref;
+
+	memset(q, 0, sizeof(*q));
+	if (state->reference < 0 || state->last_sync.tv_sec == 0) {
+		q->failure = 1;
+		return;
+	}
+
+	ref = &state->device[state->reference];
+	q->synchronized = state->servo.state == SERVO_LOCKED && ref->healthy;
+	q->synced = ref->synced;
+	q->tq = ref->rtc.tq;
+	q->lsp = ref->rtc.lsp;
+	q->ls = ref->rtc.ls;
+	q->dst = ref->rtc.dst;
+	q->offset = monitor_max_abs(&ref->monitor, 1);
+	if (state->servo.state == SERVO_HOLDOVER) {
+		q->holdover = elapsed_ns(&state->holdover_start, now);
+	} else if (!ref->healthy) {
+		q->holdover = elapsed_ns(&ref->lost_since, now);
+	}
+}
+
+int sync_quality_open(SYNC_QUALITY *q, const char *name)
+{
+	TIME_QUALITY_TABLE *table;
+	int fd;
+
+	q->table = NULL;
+
+	/* Never unlinked, the readers keep their mapping across restarts */
+	fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+	if (fd < 0) {
+		sync_log(LOG_ERR, "shm_open(%s) fail: %s", name, strerror(errno));
+		return -1;
+	}
+	if (ftruncate(fd, sizeof(*table)) < 0) {
+		sync_log(LOG_ERR, "ftruncate(%s) fail: %s", name, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	table = (TIME_QUALITY_TABLE *)mmap(NULL, sizeof(*table), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (table == MAP_FAILED) {
+		sync_log(LOG_ERR, "mmap(%s) fail: %s", name, strerror(errno));
+		return -1;
+	}
+
+	/* Slots of the cards gone since the last run are not used any more */
+	for (int i = 0; i < MXIRIG_QUALITY_SLOTS; i++) {
+		__atomic_store_n(&table->slot[i].used, 0, __ATOMIC_RELAXED);
+	}
+	table->pid = getpid();
+	table->version = MXIRIG_QUALITY_VERSION;
+	__atomic_store_n(&table->magic, MXIRIG_QUALITY_MAGIC, __ATOMIC_RELEASE);
+
+	q->table = table;
+
+	return 0;
+}
+
+void sync_quality_update(SYNC_QUALITY *q, SYNC_STATE *state)
+{
+	TIME_QUALITY quality[MXIRIG_QUALITY_SLOTS];
+	int index[MXIRIG_QUALITY_SLOTS];
+	struct timespec now, update;
+	int i, n = 0;
+
+	if (q->table == NULL) {
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	clock_gettime(CLOCK_REALTIME, &update);
+
+	/* Collect under the lock, publish after it */
+	pthread_mutex_lock(&state->lock);
+	for (i = 0; i < state->device_count; i++) {
+		SYNC_DEVICE *dev = &state->device[i];
+
+		if (dev->index < 0 || dev->index >= MXIRIG_MAX_DEVICES) {
+			continue;
+		}
+		device_quality(dev, &now, &quality[n]);
+		index[n++] = dev->index;
+	}
+	system_quality(state, &now, &quality[n]);
+	index[n++] = MXIRIG_QUALITY_SYSTEM;
+	pthread_mutex_unlock(&state->lock);
+
+	for (i = 0; i < n; i++) {
+		slot_write(&q->table->slot[index[i]], &quality[i], &update);
+	}
+	__atomic_store_n(&q->table->heartbeat, (long long)now.tv_sec, __ATOMIC_RELEASE);
+}
+
+void sync_quality_close(SYNC_QUALITY *q)
+{
+	TIME_QUALITY quality;
+	struct timespec update;
+
+	if (q->table == NULL) {
+		return;
+	}
+
+	/* Readers see the clocks fail now instead of after MXIRIG_QUALITY_STALE */
+	clock_gettime(CLOCK_REALTIME, &update);
+	for (int i = 0; i < MXIRIG_QUALITY_SLOTS; i++) {
+		if (!q->table->slot[i].used) {
+			continue;
+		}
+		memcpy(&quality, &q->table->slot[i].quality, sizeof(quality));
+		quality.failure = 1;
+		slot_write(&q->table->slot[i], &quality, &update);
+	}
+
+	munmap(q->table, sizeof(*q->table));
+	q->table = NULL;
+}
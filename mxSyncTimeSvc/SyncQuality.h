@@ -0,0 +1,50 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncQuality.h : time quality export of the IRIG-B time sync daemon.
+ *
+ * The IEC 61850 and IEEE C37.118 time quality of every card and of the system
+ * clock is published in the shared memory MXIRIG_QUALITY_SHM, refreshed by
+ * every pass of the main loop. Applications read it with "mxIrigbGetTimeQuality"
+ * without an ioctl or a request to the daemon. The quality of a card follows its
+ * RTC: the source tq, the holdover since its signal was lost and the read errors.
+ * The system clock adds the offset to the reference card and the servo holdover.
+ */
+
+#ifndef __SYNCQUALITY_H_
+#define __SYNCQUALITY_H_
+
+#include "SyncState.h"
+
+typedef struct _SYNC_QUALITY {
+	TIME_QUALITY_TABLE *table;	/* the shared memory, NULL if not published */
+} SYNC_QUALITY;
+
+/**
+ * Create or reuse the shared memory
+ * @param  [out] q - the export
+ * @param  [in] name - the shm_open() name
+ * @return If the operation completes successfully, the return value is zero.
+ */
+int sync_quality_open(SYNC_QUALITY *q, const char *name);
+
+/**
+ * Publish the time quality of the cards and the system clock
+ * @param  [in] q - the export
+ * @param  [in] state - the daemon state
+ * @return None
+ */
+void sync_quality_update(SYNC_QUALITY *q, SYNC_STATE *state);
+
+/**
+ * Mark the clocks failed and unmap the shared memory. It is kept for the next start.
+ * @param  [in] q - the export
+ * @return None
+ */
+void sync_quality_close(SYNC_QUALITY *q);
+
+#endif  // __SYNCQUALITY_H_
@@ -0,0 +1,143 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncServo.cpp : PI clock servo used to discipline the system time to the IRIG-B RTC.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "SyncServo.h"
+
+#define KP_SCALE		0.7
+#define KP_EXPONENT		(-0.3)
+#define KP_NORM_MAX		0.7
+#define KI_SCALE		0.3
+#define KI_EXPONENT		0.4
+#define KI_NORM_MAX		0.3
+
+#define MAX_FREQUENCY		500000.0	/* 500 ppm, the adjtimex() limit */
+#define STEP_THRESHOLD		500000000LL	/* 0.5 second */
+#define FIRST_STEP_THRESHOLD	20000LL		/* 20 micro seconds */
+
+void servo_set_interval(SYNC_SERVO *s, double interval)
+{
+	s->kp = KP_SCALE * pow(interval, KP_EXPONENT);
+	if (s->kp > KP_NORM_MAX / interval) {
+		s->kp = KP_NORM_MAX / interval;
+	}
+
+	s->ki = KI_SCALE * pow(interval, KI_EXPONENT);
+	if (s->ki > KI_NORM_MAX / interval) {
+		s->ki = KI_NORM_MAX / interval;
+	}
+}
+
+void servo_init(SYNC_SERVO *s, double fadj, double interval)
+{
+	s->drift = fadj;
+	s->max_freq = MAX_FREQUENCY;
+	s->step_threshold = STEP_THRESHOLD;
+	s->first_step_threshold = FIRST_STEP_THRESHOLD;
+	s->count = 0;
+	s->state = SERVO_UNLOCKED;
+	servo_set_interval(s, interval);
+}
+
+double servo_sample(SYNC_SERVO *s, long long offset, long long local)
+{
+	double ppb = s->drift;
+	double ki_term;
+
+	switch (s->count) {
+	case 0:
+		s->offset[0] = offset;
+		s->local[0] = local;
+		s->state = SERVO_UNLOCKED;
+		s->count = 1;
+		break;
+	case 1:
+		s->offset[1] = offset;
+		s->local[1] = local;
+
+		/* The two samples must be in order */
+		if (s->local[0] >= s->local[1]) {
+			s->count = 0;
+			break;
+		}
+
+		/* Estimate the frequency error from the first two samples */
+		s->drift += (s->offset[1] - s->offset[0]) * 1e9 /
+			(s->local[1] - s->local[0]);
+		if (s->drift < -s->max_freq) {
+			s->drift = -s->max_freq;
+		} else if (s->drift > s->max_freq) {
+			s->drift = s->max_freq;
+		}
+
+		if (llabs(offset) > s->first_step_threshold) {
+			s->state = SERVO_JUMP;
+		} else {
+			s->state = SERVO_LOCKED;
+		}
+		ppb = s->drift;
+		s->count = 2;
+		break;
+	case 2:
+		if (llabs(offset) > s->step_threshold) {
+			/* Too far away, step the clock and learn again */
+			s->state = SERVO_JUMP;
+			s->count = 0;
+			break;
+		}
+
+		ki_term = s->ki * offset;
+		ppb = s->kp * offset + s->drift + ki_term;
+		if (ppb < -s->max_freq) {
+			ppb = -s->max_freq;
+		} else if (ppb > s->max_freq) {
+			ppb = s->max_freq;
+		} else {
+			s->drift += ki_term;
+		}
+		s->state = SERVO_LOCKED;
+		break;
+	}
+
+	return ppb;
+}
+
+void servo_holdover(SYNC_SERVO *s, int holdover)
+{
+	if (holdover) {
+		s->state = SERVO_HOLDOVER;
+	} else if (s->state == SERVO_HOLDOVER) {
+		/* Relearn the offset but keep the frequency estimate */
+		servo_reset(s);
+	}
+}
+
+void servo_reset(SYNC_SERVO *s)
+{
+	s->count = 0;
+	s->state = SERVO_UNLOCKED;
+}
+
+const char *servo_state_name(int state)
+{
+	static const char *name[] = {
+		"unlocked",
+		"jump",
+		"locked",
+		"holdover"
+	};
+
+	if (state < 0 || state >= SERVO_STATE_UNKNOWN) {
+		return "unknown";
+	}
+
+	return name[state];
+}
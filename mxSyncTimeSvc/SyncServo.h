@@ -0,0 +1,86 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncServo.h : PI clock servo used to discipline the system time to the IRIG-B RTC.
+ */
+
+#ifndef __SYNCSERVO_H_
+#define __SYNCSERVO_H_
+
+enum _SERVO_STATE_
+{
+	SERVO_UNLOCKED = 0,	/* Collecting the first samples */
+	SERVO_JUMP,		/* The system clock must be stepped */
+	SERVO_LOCKED,		/* Tracking the RTC with frequency adjustment */
+	SERVO_HOLDOVER,		/* The time source is lost, keep the last frequency */
+
+	SERVO_STATE_UNKNOWN
+};
+
+typedef struct _SYNC_SERVO {
+	double kp;			/* proportional constant */
+	double ki;			/* integral constant */
+	double drift;			/* integrated frequency offset in ppb */
+	double max_freq;		/* frequency adjustment limit in ppb */
+	long long step_threshold;	/* offset in ns which forces a step */
+	long long first_step_threshold;	/* offset in ns which forces the first step */
+	long long offset[2];		/* the first two samples */
+	long long local[2];		/* system time of the first two samples */
+	int count;			/* number of collected samples */
+	int state;			/* one of _SERVO_STATE_ */
+} SYNC_SERVO;
+
+/**
+ * Initialize the servo
+ * @param  [in] s - the servo
+ * @param  [in] fadj - the frequency adjustment currently applied to the system clock in ppb
+ * @param  [in] interval - the sample interval in seconds
+ * @return None
+ */
+void servo_init(SYNC_SERVO *s, double fadj, double interval);
+
+/**
+ * Update the servo gains after the sample interval was changed
+ * @param  [in] s - the servo
+ * @param  [in] interval - the sample interval in seconds
+ * @return None
+ */
+void servo_set_interval(SYNC_SERVO *s, double interval);
+
+/**
+ * Feed a new sample into the servo
+ * @param  [in] s - the servo
+ * @param  [in] offset - the RTC time minus the system time in ns
+ * @param  [in] local - the system time of the sample in ns
+ * @return The frequency adjustment to apply to the system clock in ppb.
+ *         s->state tells if the system clock must be stepped by offset first.
+ */
+double servo_sample(SYNC_SERVO *s, long long offset, long long local);
+
+/**
+ * Enter or leave the holdover state
+ * @param  [in] s - the servo
+ * @param  [in] holdover - nonzero when the time source is lost
+ * @return None
+ */
+void servo_holdover(SYNC_SERVO *s, int holdover);
+
+/**
+ * Relearn the offset after the time source was replaced, keep the frequency estimate
+ * @param  [in] s - the servo
+ * @return None
+ */
+void servo_reset(SYNC_SERVO *s);
+
+/**
+ * Get the servo state name
+ * @param  [in] state - one of _SERVO_STATE_
+ * @return The state name
+ */
+const char *servo_state_name(int state);
+
+#endif  // __SYNCSERVO_H_
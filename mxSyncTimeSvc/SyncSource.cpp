@@ -0,0 +1,69 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncSource.cpp : time source failover between the Fiber and the IRIG-B port decoders.
+ */
+
+#include <string.h>
+#include "SyncSource.h"
+
+void source_init(SYNC_SOURCE *s, int time_source, int enabled)
+{
+	memset(s, 0, sizeof(*s));
+	s->current = time_source;
+
+	/* The free running RTC has no input to fail over from */
+	s->enabled = enabled &&
+		(time_source == TIMESRC_FIBER || time_source == TIMESRC_PORT1);
+}
+
+int source_update(SYNC_SOURCE *s, const DWORD *status, const struct timespec *now)
+{
+	SOURCE_INPUT *cur, *alt;
+	int i, normal;
+
+	for (i = 0; i < SOURCE_INPUT_MAX; i++) {
+		normal = (status[i] == IRIG_STATUS_NORMAL);
+		s->input[i].quality += SOURCE_QUALITY_WEIGHT * (normal - s->input[i].quality);
+		if (normal) {
+			s->input[i].good++;
+			s->input[i].bad = 0;
+		} else {
+			s->input[i].bad++;
+			s->input[i].good = 0;
+		}
+	}
+
+	if (!s->enabled) {
+		return s->current;
+	}
+
+	cur = &s->input[SOURCE_INPUT(s->current)];
+	alt = &s->input[1 - SOURCE_INPUT(s->current)];
+
+	/* Hold off, do not flap between two marginal inputs */
+	if (s->switches && now->tv_sec - s->last_switch.tv_sec < SOURCE_HOLDOFF) {
+		return s->current;
+	}
+
+	if (alt->good < SOURCE_GOOD_COUNT) {
+		return s->current;
+	}
+
+	if (cur->bad >= SOURCE_BAD_COUNT || alt->quality > cur->quality + SOURCE_HYSTERESIS) {
+		return SOURCE_TIMESRC(1 - SOURCE_INPUT(s->current));
+	}
+
+	return s->current;
+}
+
+void source_switched(SYNC_SOURCE *s, int time_source, const struct timespec *now)
+{
+	s->current = time_source;
+	s->last_switch = *now;
+	s->switches++;
+}
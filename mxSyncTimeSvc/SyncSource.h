@@ -0,0 +1,79 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncSource.h : time source failover between the Fiber and the IRIG-B port decoders.
+ *
+ * Both decoders are polled through the INTSTS bits. Every input keeps a
+ * quality figure, the moving average of its normal samples. The RTC is
+ * switched to the other input when
+ *  - the hold-off time since the last switch has elapsed, and
+ *  - the other input has been normal for SOURCE_GOOD_COUNT polls, and
+ *  - the current input has been bad for SOURCE_BAD_COUNT polls, or its
+ *    quality is SOURCE_HYSTERESIS below the quality of the other input.
+ */
+
+#ifndef __SYNCSOURCE_H_
+#define __SYNCSOURCE_H_
+
+#include <time.h>
+#include "../mxirig/mxirig.h"
+
+#define SOURCE_INPUT_MAX		2	/* Fiber port and IRIG-B port 1 */
+#define SOURCE_POLL_INTERVAL		1	/* seconds between two status polls */
+#define SOURCE_HOLDOFF			5	/* minimum seconds between two switches */
+#define SOURCE_GOOD_COUNT		3	/* normal polls before an input may take over */
+#define SOURCE_BAD_COUNT		2	/* bad polls before the current input is given up */
+#define SOURCE_HYSTERESIS		0.3	/* quality margin to leave a working input */
+#define SOURCE_QUALITY_WEIGHT		0.2	/* weight of a new poll in the quality average */
+
+/* Map a TIMESRC_FIBER or TIMESRC_PORT1 time source to its input index */
+#define SOURCE_INPUT(src)		((src) - TIMESRC_FIBER)
+#define SOURCE_TIMESRC(input)		((input) + TIMESRC_FIBER)
+
+typedef struct _SOURCE_INPUT {
+	double quality;			/* average of the normal polls, 0.0 ~ 1.0 */
+	int good;			/* consecutive normal polls */
+	int bad;			/* consecutive abnormal polls */
+} SOURCE_INPUT;
+
+typedef struct _SYNC_SOURCE {
+	int enabled;			/* automatic failover */
+	int current;			/* one of _RTC_SYNC_SOURCE_ */
+	SOURCE_INPUT input[SOURCE_INPUT_MAX];
+	struct timespec last_switch;	/* monotonic time of the last switch */
+	unsigned long long switches;	/* number of switches */
+} SYNC_SOURCE;
+
+/**
+ * Initialize the source selection
+ * @param  [in] s - the source selection
+ * @param  [in] time_source - the configured time source, one of _RTC_SYNC_SOURCE_
+ * @param  [in] enabled - nonzero to switch automatically
+ * @return None
+ */
+void source_init(SYNC_SOURCE *s, int time_source, int enabled);
+
+/**
+ * Feed the signal status of both inputs and select the time source
+ * @param  [in] s - the source selection
+ * @param  [in] status - the status of the Fiber port and IRIG-B port 1, one of _IRIG_SIGNAL_STATUS_
+ * @param  [in] now - the monotonic time of the poll
+ * @return The time source the RTC should follow, one of _RTC_SYNC_SOURCE_.
+ *         s->current is updated by the caller after RTCCON is written.
+ */
+int source_update(SYNC_SOURCE *s, const DWORD *status, const struct timespec *now);
+
+/**
+ * Record a completed switch
+ * @param  [in] s - the source selection
+ * @param  [in] time_source - the time source now followed by the RTC
+ * @param  [in] now - the monotonic time of the switch
+ * @return None
+ */
+void source_switched(SYNC_SOURCE *s, int time_source, const struct timespec *now);
+
+#endif  // __SYNCSOURCE_H_
@@ -0,0 +1,169 @@
+/*
+  Copyright (C) MOXA Inc. All rights reserved.
+  This software is distributed under the terms of the
+  MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/**
+ * @file SyncState.h : run time state of the IRIG-B time sync daemon.
+ *
+ * Every card is sampled by its own thread. The card selected as reference
+ * disciplines the system clock, the other cards are monitored and take
+ * over when the reference loses its time source. All fields are protected
+ * by SYNC_STATE.lock.
+ */
+
+#ifndef __SYNCSTATE_H_
+#define __SYNCSTATE_H_
+
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "../mxirig/mxirig.h"
+#include "SyncServo.h"
+#include "SyncSource.h"
+#include "SyncJournal.h"
+#include "SyncMonitor.h"
+
+#define MIN_TIME_SYNC_INTERVAL		1	/* 1 second */
+#define MAX_TIME_SYNC_INTERVAL		86400	/* 1 day */
+
+#define MIN_SAMPLE_PHASE		0	/* ms after the second */
+#define MAX_SAMPLE_PHASE		900	/* stay away from the next RTC rollover */
+#define DEFAULT_SAMPLE_PHASE		100	/* 100 ms */
+#define MAX_SAMPLE_RATE			32	/* RTC samples per second */
+#define MAX_DECIMATION			64	/* samples averaged into one servo update */
+#define SYNC_MAX_DEVICES		MXIRIG_MAX_DEVICES
+#define MAX_TAI_OFFSET			1000	/* TAI minus UTC in seconds */
+#define MAX_PPS_HOLD			999	/* PPS input hold time in ms */
+#define MAX_PPS_TIMEOUT			60000	/* PPS input timeout in ms */
+#define MAX_INPUT_DELAY			1000000	/* cable delay of the time source in ns */
+#define LOOPBACK_RUNS			1000	/* loopback runs averaged into the measured input delay */
+#define MAX_OUTPUT_DELAY		1000000	/* cable delay of an output port in ns */
+
+/* The input ports which carry an IRIG-B decoder */
+#define SYNC_INPUT_FIBER		0	/* IRIG-B decoder 0 */
+#define SYNC_INPUT_PORT1		1	/* IRIG-B decoder 1 */
+#define SYNC_INPUT_MAX			SOURCE_INPUT_MAX
+#define DECODER_MISMATCH_COUNT		3	/* consecutive polls the decoders disagree before the mismatch is raised */
+#define DECODER_MISMATCH_LIMIT		1000000	/* ns the decoders may differ without an accuracy limit */
+#define PPS_SECONDS_LIMIT		600000000LL	/* ns the RTC may differ from the system time before its seconds are set */
+#define PPS_SECONDS_WINDOW		500000000	/* ns after the RTC second its seconds may still be set */
+
+#define SYNC_HIST_BUCKETS		8
+
+typedef struct _SYNC_HISTOGRAM {
+	unsigned long long bucket[SYNC_HIST_BUCKETS + 1];	/* per bucket, the last one is +Inf */
+	unsigned long long count;
+	double sum;
+} SYNC_HISTOGRAM;
+
+/* Averages the reference samples into one servo update */
+typedef struct _SYNC_DECIMATOR {
+	long long offset_sum;		/* sum of the offsets in ns */
+	long long local_first;		/* system time of the first sample in ns */
+	long long local_sum;		/* sum of the system times after the first sample in ns */
+	int count;			/* number of samples summed */
+} SYNC_DECIMATOR;
+
+struct _SYNC_STATE;
+
+typedef struct _SYNC_DEVICE {
+	/* Card */
+	struct _SYNC_STATE *state;	/* owner */
+	int index;			/* card index of mxIrigbOpen */
+	HANDLE hDev;
+	DWORD hwid;
+	int time_source;		/* one of _RTC_SYNC_SOURCE_, the one the RTC follows now */
+	long long input_delay;		/* cable delay of the time source in ns, added to the RTC time */
+	long long output_advance;	/* ns a free running RTC leads for the output cables, taken off its time */
+	SYNC_SOURCE source;		/* Fiber and IRIG-B port failover */
+	pthread_t thread;
+	int resync_request;		/* sample now instead of waiting for the interval */
+	int loopback_port;		/* measure the input delay from this output port instead of a sample, 0 if not */
+	DWORD loopback_input;		/* the time source input of the loopback */
+	long long loopback_fallback;	/* the input delay kept when the loopback fails */
+
+	/* The latest sample */
+	DWORD signal_status[SYNC_INPUT_MAX];	/* one of _IRIG_SIGNAL_STATUS_ */
+	long long offset;		/* RTC time minus system time in ns */
+	struct timespec last_sample;	/* system time of the latest sample */
+	int healthy;			/* the RTC follows a valid time source */
+	int rtc_valid;			/* the latest RTC read succeeded */
+	int synced;			/* the RTC followed a valid time source once */
+	struct timespec lost_since;	/* monotonic time the RTC stopped following a valid time source */
+	RTCTIME rtc;			/* the latest RTC time, for its time quality and leap second bits */
+	long long tz_hour;		/* the RTC local hour the UTC offset was computed for */
+	long tz_offset;			/* the local time minus UTC in seconds */
+
+	/* Counters */
+	unsigned long long samples;	/* RTC samples taken */
+	unsigned long long read_errors;	/* RTC or signal status read failures */
+	unsigned long long rtc_tears;	/* RTC reads straddling a second, read again */
+	unsigned long long status_count[SYNC_INPUT_MAX][IRIG_STATUS_UNKNOWN + 1];	/* samples per signal status */
+	IRIGB_STATUS_COUNTERS status_events;	/* polls per status word bit, whatever the signal status */
+
+	/* Distributions */
+	SYNC_HISTOGRAM offset_hist;	/* |offset| in seconds */
+	SYNC_HISTOGRAM latency_hist;	/* RTC read ioctl latency in seconds */
+	SYNC_HISTOGRAM wakeup_hist;	/* thread wake up delay after its deadline in seconds */
+	long long wakeup_max;		/* the longest wake up delay in ns */
+
+	/* Accuracy compliance */
+	SYNC_MONITOR monitor;
+
+	/* Cross-check of the Fiber and port 1 decoders */
+	long long decoder_elapsed[SYNC_INPUT_MAX];	/* ns since the reference marker in the latest poll, -1 if unknown */
+	int decoder_valid;		/* both decoders had a valid frame in the latest poll */
+	long long decoder_diff;		/* port 1 signal time minus Fiber signal time in ns */
+	int decoder_bad;		/* consecutive polls the decoders disagree */
+	int decoder_mismatch;		/* the decoders disagree */
+	unsigned long long decoder_mismatches;	/* mismatches raised */
+	int decoder_phase_valid;	/* the latest sample measured decoder_phase */
+	long long decoder_phase;	/* RTC time minus the signal time of the decoder it follows in ns */
+
+	/* PPS input, the RTC follows the pulse and the daemon sets its seconds */
+	DWORD pps_status;		/* the PPS decoder, one of _IRIG_SIGNAL_STATUS_ */
+	int pps_lost;			/* the PPS input timed out */
+	unsigned long long pps_timeouts;	/* PPS time outs raised */
+	unsigned long long pps_seconds_set;	/* RTC seconds set from the system time */
+} SYNC_DEVICE;
+
+typedef struct _SYNC_STATE {
+	pthread_mutex_t lock;
+	pthread_cond_t wakeup;		/* signaled on resync, interval change and stop */
+	int stopping;
+
+	/* Configuration in effect */
+	long interval;			/* time sync interval in seconds */
+	int rate;			/* RTC samples per second, 0 for one sample per interval */
+	int decimation;			/* reference samples per servo update with a rate */
+	long phase;			/* sample this many ns after the second of the system time */
+	int (*reload)(struct _SYNC_STATE *state);	/* apply the configuration file again, NULL without one */
+	int rt_priority;		/* SCHED_FIFO priority of the sampling threads, 0 for SCHED_OTHER */
+	cpu_set_t rt_cpus;		/* CPU affinity of the sampling threads, empty for any CPU */
+	SYNC_JOURNAL *journal;		/* every sample is queued for its writer, NULL if disabled */
+	long long accuracy;		/* the offset limit of the compliance alarm in ns, 0 for no alarm */
+
+	/* Cards */
+	int device_count;
+	SYNC_DEVICE device[SYNC_MAX_DEVICES];
+	int reference;			/* device disciplining the system clock, -1 if none */
+
+	/* System clock */
+	SYNC_SERVO servo;
+	SYNC_DECIMATOR decimator;
+	double freq;			/* frequency adjustment of the system clock in ppb */
+	struct timespec last_sync;	/* system time of the last successful sync */
+	struct timespec holdover_start;	/* monotonic time the holdover started */
+	double holdover_total;		/* accumulated holdover time in seconds */
+	int leap;			/* STA_INS or STA_DEL armed in the kernel, 0 if none */
+	int tai_offset;			/* TAI minus UTC in seconds kept by the kernel, 0 if unknown */
+
+	/* Counters */
+	unsigned long long sync_errors;	/* system clock adjustment failures */
+	unsigned long long steps;	/* system clock steps */
+	unsigned long long reference_changes;	/* switches to another card */
+} SYNC_STATE;
+
+#endif  // __SYNCSTATE_H_
@@ -21,8 +21,18 @@ umask 022
 #   -t 1 - Sync time in DIFF signal format
 #   -i 10 - The time interval in 10 seconds to sync the IRIG-B time into system time.
 #   -B - Run daemon in the background
+#   -F /etc/ServiceSyncTime.conf - Read the settings from the file, "mx_irigb.sh reload" applies its changes
+#   Add "-m 9478" to serve the OpenMetrics (Prometheus) sync health on TCP port 9478.
+#   Add "-R 50 -A 1" to sample the cards at SCHED_FIFO priority 50 on CPU 1 with the memory locked.
+#   Add "-j /var/lib/ServiceSyncTime.journal" to record every sample in a 100 MB ring file, read it with "ServiceSyncTime -x".
+#   Add "-k /var/lib/ServiceSyncTime.archive" as well to keep the samples compressed for months.
+#   Add "-T T4" to raise an alarm when a card leaves the IEC 61850-5 T4 class (4 us), see the "status" command.
+#   Add "-L 37" to set the TAI offset of the kernel, the leap seconds announced by IRIG-B are applied by the kernel.
 #
 MX_IRIGB_SERVICESYNCTIME_OPTS="-t 1 -i 10 -B"
+if [ -e "/etc/ServiceSyncTime.conf" ]; then
+	MX_IRIGB_SERVICESYNCTIME_OPTS="$MX_IRIGB_SERVICESYNCTIME_OPTS -F /etc/ServiceSyncTime.conf"
+fi
 
 # The IRIG-B utility default configure wtih
 #   -f 15 - Set Output Interface
@@ -58,6 +68,11 @@ case "$1" in
 		rm -rf /var/run/ServiceSyncTime.pid
 	fi
 	;;
+  reload)
+	if [ -e "/var/run/ServiceSyncTime.pid" ]; then
+		pkill -HUP -F /var/run/ServiceSyncTime.pid
+	fi
+	;;
   restart)
 	$0 stop
 	sleep 1
@@ -68,6 +68,11 @@ enum _FPGA_REGS {
 //-----------------------------------------------------------------------------   
 #define LPBTCNT_UNIT    40  // 40 nano second per unit
 
+//-----------------------------------------------------------------------------   
+// Define the IRIG-B Decoder Counter Registers
+//-----------------------------------------------------------------------------   
+#define IRIGBDECNT_UNIT 40  // 40 nano second per unit, the clock of LPBTCNT
+
 //-----------------------------------------------------------------------------   
 // Define the input port configuration Registers
 //-----------------------------------------------------------------------------   
@@ -158,7 +163,7 @@ enum _FPGA_REGS {
 
 #define IRIGBDEDAT1_DAY_MASK        (0xf)
 #define IRIGBDEDAT1_DAY_BIT_S       (0)
-#define IRIGBDEDAT1_TDAY_MASK       (0x3f)
+#define IRIGBDEDAT1_TDAY_MASK       (0xf)
 #define IRIGBDEDAT1_TDAY_BIT_S      (5)
 #define IRIGBDEDAT1_HDAY_MASK       (0x3)
 #define IRIGBDEDAT1_HDAY_BIT_S      (9)
@@ -179,6 +184,9 @@ enum _FPGA_REGS {
 #define IRIGBDEDAT2_TQ_BIT_S        (10)
 #define IRIGBDEDAT2_BIT_PAR         (1<<14)
 
+#define IRIGBDEDAT3_SBS_MASK        (0x1ffff)
+#define IRIGBDEDAT3_SBS_BIT_S       (0)
+
 //-----------------------------------------------------------------------------   
 // Define the Pulse per second configuration Registers
 //-----------------------------------------------------------------------------   
@@ -19,13 +19,34 @@
 
 #include <stdio.h>
 #include <time.h>
+#include <math.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#include <poll.h>
+#endif
 #include "Public.h"
 #include "RegmxIrigbPci.h"
 #include "mxirig.h"
 
+#define RTC_TEAR_WINDOW		10000000	/* ns after the second a register read may straddle */
+#define RTC_READ_RETRY		3		/* re-reads of a torn RTC time before giving up */
+#define QUALITY_READ_RETRY	100		/* reads of a time quality slot racing the publisher */
+#define WAIT_GUARD		1000000		/* ns before the expected edge the event poller reads closely */
+#define WAIT_SPIN		20000		/* ns between the reads of the event poller near the edge */
+#define LOOPBACK_TIMEOUT	10000000	/* ns a loopback test pulse may take to come back */
+#define LOOPBACK_GAP		1000000		/* ns between the loopback test runs */
+
+/* The status word bits an event wait reports as they are, the others are edges */
+#define WAIT_LEVEL_BITS		(INTSTS_BIT_IRIG0DE_OFF | INTSTS_BIT_IRIG0DE_FRMERR | INTSTS_BIT_IRIG0DE_PARERR | \
+				 INTSTS_BIT_IRIG1DE_OFF | INTSTS_BIT_IRIG1DE_FRMERR | INTSTS_BIT_IRIG1DE_PARERR | \
+				 INTSTS_BIT_PPSDE_TIMEOUT)
+
 #ifdef WIN32
 extern HANDLE _stdcall InitializeMxDrv(int devindex);
 extern void _stdcall ShutdownMxDrv(HANDLE hDevice);
+
+/* The cards are read from several threads, none may share the static struct tm of localtime() */
+#define localtime_r(t, tm)	(localtime_s((tm), (t)) ? NULL : (tm))
 #endif
 
 #ifdef __cplusplus    // If used by C++ code, 
@@ -147,6 +168,68 @@ MXIRIG_API BOOL mxIrigbGetHardwareID(HANDLE hDev, PDWORD pdwHwId)
 	return bRet;
 }
 
+#ifndef WIN32
+/**
+ * Get the device node of an Irigb device
+ * @param  [in] index - the device number (started from 0)
+ * @param  [out] path - A buffer of MXIRIG_DEV_PATH_SIZE bytes to receive the device node.
+ * @return - If the device node exists, the return value is nonzero.
+ */
+static BOOL mxirigb_devpath(int index, char *path)
+{
+	if (index < 0 || index >= MXIRIG_MAX_DEVICES) {
+		return FALSE;
+	}
+
+	/* Every card has its own /dev/moxa_irigbN node */
+	snprintf(path, MXIRIG_DEV_PATH_SIZE, MXIRIG_DEV_NAME "%d", index);
+	if (access(path, F_OK) == 0) {
+		return TRUE;
+	}
+
+	/* The single card driver only creates /dev/moxa_irigb */
+	if (index == 0) {
+		snprintf(path, MXIRIG_DEV_PATH_SIZE, MXIRIG_DEV_NAME);
+		if (access(path, F_OK) == 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+#endif
+
+/**
+ * Get the number of Irigb devices
+ * @return The number of devices, they are opened by index 0 to count-1.
+ */
+MXIRIG_API int mxIrigbGetDeviceCount(void)
+{
+	int count;
+
+#ifdef WIN32
+	HANDLE hDev;
+
+	for (count = 0; count < MXIRIG_MAX_DEVICES; count++) {
+		hDev = InitializeMxDrv(count);
+		if (hDev == INVALID_HANDLE_VALUE || hDev == NULL) {
+			break;
+		}
+		ShutdownMxDrv(hDev);
+	}
+#else
+	char path[MXIRIG_DEV_PATH_SIZE];
+
+	for (count = 0; count < MXIRIG_MAX_DEVICES; count++) {
+		if (!mxirigb_devpath(count, path)) {
+			break;
+		}
+	}
+#endif
+
+	return count;
+}
+
 /**
  * Open Irigb device
  * @param  [in] index - the device number (started from 0)
@@ -164,9 +247,17 @@ MXIRIG_API HANDLE mxIrigbOpen(int index)
 	}
 
 #else
-	HANDLE hDev=open("/dev/moxa_irigb", O_RDWR);
+	char path[MXIRIG_DEV_PATH_SIZE];
+	HANDLE hDev;
+
+	if (!mxirigb_devpath(index, path)) {
+		printf("IRIG-B device %d does not exist\n", index);
+		return -1;
+	}
+
+	hDev=open(path, O_RDWR);
 	if ( hDev < 0 ) {
-		printf("open /dev/moxa_irigb fail\n");
+		printf("open %s fail\n", path);
 		return -1;
 	}
 #endif
@@ -243,34 +334,81 @@ MXIRIG_API void mxIrigbClose(HANDLE hDev)
  */
 MXIRIG_API BOOL mxIrigbGetTime(HANDLE hDev, PRTCTIME pRtcTime)
 {
-	DWORD pdwAddress[4] = { RTCDAT0, RTCDAT1, RTCDAT2, RTCDAT3 };
+	return mxIrigbGetTimeEx(hDev, pRtcTime, NULL);
+}
+
+/**
+ * Get internal RTC time from Irigb device, the date and the nanoseconds are from the same second
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pRtcTime - A pointer to a RTCTIME structure to receive the current date and time.
+ * @param  [out] pdwTears - A pointer to receive the number of reads discarded for straddling a second, can be NULL.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetTimeEx(HANDLE hDev, PRTCTIME pRtcTime, PDWORD pdwTears)
+{
+	/* The registers are not latched together. RTCDAT2 is read last, so a read
+	 * straddling the rollover shows a nanosecond count just after the second. */
+	DWORD pdwAddress[4] = { RTCDAT0, RTCDAT1, RTCDAT3, RTCDAT2 };
 	DWORD pdwValue[4];
 	DWORD dwBytesReturned;
+	DWORD dwCheck, dwTears = 0;
 	BOOL bRet;
-#ifdef WIN32
-	bRet = DeviceIoControl(hDev, IOCTL_GET_REGISTER,
-		pdwAddress, sizeof(pdwAddress), pdwValue, sizeof(pdwValue),
-		&dwBytesReturned, NULL);
-#else
+	int retry;
+#ifndef WIN32
 	struct reg_val_pair_struct get;
 	int i;
+#endif
 
-	memset(&get, 0, sizeof(get));
-	get.count = 4;
-	for ( i=0; i<get.count; i++ ) {
-		get.addr[i] = pdwAddress[i];
-	}
+	for ( retry = 0; ; retry++ ) {
+#ifdef WIN32
+		bRet = DeviceIoControl(hDev, IOCTL_GET_REGISTER,
+			pdwAddress, sizeof(pdwAddress), pdwValue, sizeof(pdwValue),
+			&dwBytesReturned, NULL);
+#else
+		memset(&get, 0, sizeof(get));
+		get.count = 4;
+		for ( i=0; i<get.count; i++ ) {
+			get.addr[i] = pdwAddress[i];
+		}
 
-	bRet = ioctl(hDev, IOCTL_GET_REGISTER, &get);
-	/* In Linux system, the return ( value == 0 ) means TRUE */
-	bRet = ( bRet == 0 ) ? TRUE : FALSE;
+		bRet = ioctl(hDev, IOCTL_GET_REGISTER, &get);
+		/* In Linux system, the return ( value == 0 ) means TRUE */
+		bRet = ( bRet == 0 ) ? TRUE : FALSE;
 
-	for ( i=0; i<get.count; i++ ) {
-		pdwValue[i] = get.val[i];
-	}
+		for ( i=0; i<get.count; i++ ) {
+			pdwValue[i] = get.val[i];
+		}
 #endif
-	if (!bRet) {
-		return bRet;
+		if (!bRet) {
+			return bRet;
+		}
+
+		/* Far from the rollover, the registers belong to the same second */
+		if ( pdwValue[3] >= RTC_TEAR_WINDOW ) {
+			break;
+		}
+
+		/* RTCDAT0 changes if the second rolled over after it was read */
+		if ( !mxirigb_getreg(hDev, RTCDAT0, &dwCheck) ) {
+			return FALSE;
+		}
+		if ( dwCheck == pdwValue[0] ) {
+			break;
+		}
+
+		dwTears++;
+		if ( retry >= RTC_READ_RETRY ) {
+			if ( pdwTears != NULL ) {
+				*pdwTears = dwTears;
+			}
+			return FALSE;
+		}
+	}
+
+	if ( pdwTears != NULL ) {
+		*pdwTears = dwTears;
 	}
 
 	/* Transfer BCD to HEX */
@@ -288,45 +426,45 @@ MXIRIG_API BOOL mxIrigbGetTime(HANDLE hDev, PRTCTIME pRtcTime)
 	pRtcTime->year = ((pdwValue[1]>>8)&0xf) + ((pdwValue[1]>>12)&0xf)*10 +
 		((pdwValue[1]>>16)&0xf)*100 + ((pdwValue[1]>>20)&0xf)*1000;
 	/* RTCDAT2[31:0] HEX */
-	pRtcTime->nanosec = pdwValue[2];
+	pRtcTime->nanosec = pdwValue[3];
 
-	pRtcTime->lsp = (pdwValue[3] & RTCDAT3_BIT_LSP) ? 1:0;
-	pRtcTime->ls = (pdwValue[3] & RTCDAT3_BIT_LS) ? 1:0;
-	pRtcTime->dsp = (pdwValue[3] & RTCDAT3_BIT_DSP) ? 1:0;
-	pRtcTime->dst = (pdwValue[3] & RTCDAT3_BIT_DST) ? 1:0;
-	pRtcTime->tzs = (pdwValue[3] & RTCDAT3_BIT_TZS) ? 1:0;
-	pRtcTime->tzh = (pdwValue[3] & RTCDAT3_BIT_TZH) ? 1:0;
-	pRtcTime->tz = (pdwValue[3] >> RTCDAT3_TZ_BIT_S) & RTCDAT3_TZ_MASK;
-	pRtcTime->tq = (pdwValue[3] >> RTCDAT3_TQ_BIT_S) & RTCDAT3_TQ_MASK;
+	pRtcTime->lsp = (pdwValue[2] & RTCDAT3_BIT_LSP) ? 1:0;
+	pRtcTime->ls = (pdwValue[2] & RTCDAT3_BIT_LS) ? 1:0;
+	pRtcTime->dsp = (pdwValue[2] & RTCDAT3_BIT_DSP) ? 1:0;
+	pRtcTime->dst = (pdwValue[2] & RTCDAT3_BIT_DST) ? 1:0;
+	pRtcTime->tzs = (pdwValue[2] & RTCDAT3_BIT_TZS) ? 1:0;
+	pRtcTime->tzh = (pdwValue[2] & RTCDAT3_BIT_TZH) ? 1:0;
+	pRtcTime->tz = (pdwValue[2] >> RTCDAT3_TZ_BIT_S) & RTCDAT3_TZ_MASK;
+	pRtcTime->tq = (pdwValue[2] >> RTCDAT3_TQ_BIT_S) & RTCDAT3_TQ_MASK;
 
 	/* WORKAROUND: avoid FPGA leap second issue */
 	if ( pRtcTime->lsp ) {
 		time_t rawtime;
-		struct tm *systime;
+		struct tm systime;
 
 		if ( pRtcTime->ls ) { /* -1 */
 			if ( pRtcTime->sec == 59 ) {
 				/* ex: 07:59:59 -> 08:00:00 */
 				time (&rawtime);
-				systime = localtime (&rawtime);
-
-				systime->tm_year = pRtcTime->year - 1900;
-				systime->tm_mon  = pRtcTime->mon - 1;
-				systime->tm_mday = pRtcTime->mday;
-				systime->tm_hour = pRtcTime->hour;
-				systime->tm_min = pRtcTime->min;
-				systime->tm_sec = pRtcTime->sec;
-				rawtime = mktime(systime);
+				localtime_r(&rawtime, &systime);
+
+				systime.tm_year = pRtcTime->year - 1900;
+				systime.tm_mon  = pRtcTime->mon - 1;
+				systime.tm_mday = pRtcTime->mday;
+				systime.tm_hour = pRtcTime->hour;
+				systime.tm_min = pRtcTime->min;
+				systime.tm_sec = pRtcTime->sec;
+				rawtime = mktime(&systime);
 				rawtime++;
 
-				systime = localtime (&rawtime);
+				localtime_r(&rawtime, &systime);
 
-				pRtcTime->year = systime->tm_year + 1900;
-				pRtcTime->mon  = systime->tm_mon + 1;
-				pRtcTime->mday = systime->tm_mday;
-				pRtcTime->hour = systime->tm_hour;
-				pRtcTime->min  = systime->tm_min;
-				pRtcTime->sec  = systime->tm_sec;
+				pRtcTime->year = systime.tm_year + 1900;
+				pRtcTime->mon  = systime.tm_mon + 1;
+				pRtcTime->mday = systime.tm_mday;
+				pRtcTime->hour = systime.tm_hour;
+				pRtcTime->min  = systime.tm_min;
+				pRtcTime->sec  = systime.tm_sec;
 
 				pRtcTime->ls = 0;
 				pRtcTime->lsp = 0;
@@ -336,47 +474,47 @@ MXIRIG_API BOOL mxIrigbGetTime(HANDLE hDev, PRTCTIME pRtcTime)
 			if ( pRtcTime->sec == 0 ) {
 				/* ex: 08:00:00 -> 07:59:60 */
 				time (&rawtime);
-				systime = localtime (&rawtime);
-
-				systime->tm_year = pRtcTime->year - 1900;
-				systime->tm_mon  = pRtcTime->mon - 1;
-				systime->tm_mday = pRtcTime->mday;
-				systime->tm_hour = pRtcTime->hour;
-				systime->tm_min = pRtcTime->min;
-				systime->tm_sec = pRtcTime->sec;
-				rawtime = mktime(systime);
+				localtime_r(&rawtime, &systime);
+
+				systime.tm_year = pRtcTime->year - 1900;
+				systime.tm_mon  = pRtcTime->mon - 1;
+				systime.tm_mday = pRtcTime->mday;
+				systime.tm_hour = pRtcTime->hour;
+				systime.tm_min = pRtcTime->min;
+				systime.tm_sec = pRtcTime->sec;
+				rawtime = mktime(&systime);
 				rawtime--;
 
-				systime = localtime (&rawtime);
+				localtime_r(&rawtime, &systime);
 
-				pRtcTime->year = systime->tm_year + 1900;
-				pRtcTime->mon  = systime->tm_mon + 1;
-				pRtcTime->mday = systime->tm_mday;
-				pRtcTime->hour = systime->tm_hour;
-				pRtcTime->min  = systime->tm_min;
-				pRtcTime->sec  = systime->tm_sec + 1;
+				pRtcTime->year = systime.tm_year + 1900;
+				pRtcTime->mon  = systime.tm_mon + 1;
+				pRtcTime->mday = systime.tm_mday;
+				pRtcTime->hour = systime.tm_hour;
+				pRtcTime->min  = systime.tm_min;
+				pRtcTime->sec  = systime.tm_sec + 1;
 			} else if ( pRtcTime->sec == 61 ) {
 				/* ex: 07:59:61 -> 08:00:00 */
 				time (&rawtime);
-				systime = localtime (&rawtime);
-
-				systime->tm_year = pRtcTime->year - 1900;
-				systime->tm_mon  = pRtcTime->mon - 1;
-				systime->tm_mday = pRtcTime->mday;
-				systime->tm_hour = pRtcTime->hour;
-				systime->tm_min = pRtcTime->min;
-				systime->tm_sec = 59;
-				rawtime = mktime(systime);
+				localtime_r(&rawtime, &systime);
+
+				systime.tm_year = pRtcTime->year - 1900;
+				systime.tm_mon  = pRtcTime->mon - 1;
+				systime.tm_mday = pRtcTime->mday;
+				systime.tm_hour = pRtcTime->hour;
+				systime.tm_min = pRtcTime->min;
+				systime.tm_sec = 59;
+				rawtime = mktime(&systime);
 				rawtime++;
 
-				systime = localtime (&rawtime);
+				localtime_r(&rawtime, &systime);
 
-				pRtcTime->year = systime->tm_year + 1900;
-				pRtcTime->mon  = systime->tm_mon + 1;
-				pRtcTime->mday = systime->tm_mday;
-				pRtcTime->hour = systime->tm_hour;
-				pRtcTime->min  = systime->tm_min;
-				pRtcTime->sec  = systime->tm_sec;
+				pRtcTime->year = systime.tm_year + 1900;
+				pRtcTime->mon  = systime.tm_mon + 1;
+				pRtcTime->mday = systime.tm_mday;
+				pRtcTime->hour = systime.tm_hour;
+				pRtcTime->min  = systime.tm_min;
+				pRtcTime->sec  = systime.tm_sec;
 
 				pRtcTime->lsp = 0;
 			}
@@ -484,7 +622,7 @@ MXIRIG_API BOOL mxIrigbSyncTime(HANDLE hDev, BOOL bToFrom)
 	SYSTEMTIME systime;
 #else
 	time_t rawtime;
-	struct tm *systime;
+	struct tm systime;
 #endif
 	RTCTIME rtctime;
 
@@ -512,14 +650,14 @@ MXIRIG_API BOOL mxIrigbSyncTime(HANDLE hDev, BOOL bToFrom)
 		}
 
 		time (&rawtime);
-		systime = localtime (&rawtime);
-
-		rtctime.year = systime->tm_year + 1900;
-		rtctime.mon  = systime->tm_mon + 1;
-		rtctime.mday = systime->tm_mday;
-		rtctime.hour = systime->tm_hour;
-		rtctime.min  = systime->tm_min;
-		rtctime.sec  = systime->tm_sec;
+		localtime_r(&rawtime, &systime);
+
+		rtctime.year = systime.tm_year + 1900;
+		rtctime.mon  = systime.tm_mon + 1;
+		rtctime.mday = systime.tm_mday;
+		rtctime.hour = systime.tm_hour;
+		rtctime.min  = systime.tm_min;
+		rtctime.sec  = systime.tm_sec;
 #endif
 		bRet = mxIrigbSetTime(hDev, &rtctime);
 	} else {
@@ -539,21 +677,21 @@ MXIRIG_API BOOL mxIrigbSyncTime(HANDLE hDev, BOOL bToFrom)
 #else
 		/* Jared, first get the system time. */
 		time (&rawtime);
-		systime = localtime (&rawtime);
+		localtime_r(&rawtime, &systime);
 
 		/* Then sync the time from IRIG-B RTC */
-		systime->tm_year = rtctime.year - 1900;
-		systime->tm_mon  = rtctime.mon - 1;
-		systime->tm_mday = rtctime.mday;
-		systime->tm_hour = rtctime.hour;
-		systime->tm_min = rtctime.min;
+		systime.tm_year = rtctime.year - 1900;
+		systime.tm_mon  = rtctime.mon - 1;
+		systime.tm_mday = rtctime.mday;
+		systime.tm_hour = rtctime.hour;
+		systime.tm_min = rtctime.min;
 		/* In Linux, normally in the range 0 to 59, but can be up to 60 to allow for leap seconds. */
-		systime->tm_sec = rtctime.sec;
+		systime.tm_sec = rtctime.sec;
 		/* The Linux system time structure, struct tm, doesn't has miniseconds information.
 		 * So we do some delay here.
 		 */
 		/* After the small delay, sync the time to system clock. */
-		rawtime = mktime(systime);
+		rawtime = mktime(&systime);
 		if ( stime(&rawtime) < 0 ) {
 			printf("stime() fail\n");
 			bRet = FALSE;
@@ -576,7 +714,7 @@ MXIRIG_API BOOL mxIrigbSetSyncTimeSrc(HANDLE hDev, DWORD dwSource)
 {
 	DWORD dwHwId;
 
-	if( dwSource >= TIMESRC_UNKNOWN) {
+	if( dwSource >= TIMESRC_UNKNOWN && dwSource != TIMESRC_PPS) {
 		SetLastError(ERROR_ACCESS_DENIED);
 		return FALSE;
 	}
@@ -628,7 +766,8 @@ MXIRIG_API BOOL mxIrigbSetSyncTimeSrc(HANDLE hDev, DWORD dwSource)
 		}
 	}
 
-	return mxirigb_setclrreg(hDev, RTCCON, dwSource, RTCCON_SYNCSRC_MASK);
+	return mxirigb_setclrreg(hDev, RTCCON,
+		(dwSource == TIMESRC_PPS) ? RTCCON_SYNCSRC_PPS : dwSource, RTCCON_SYNCSRC_MASK);
 }
 
 /**
@@ -647,7 +786,9 @@ MXIRIG_API BOOL mxIrigbGetSyncTimeSrc(HANDLE hDev, PDWORD pdwSource)
 	}
 	
 	dwValue &= RTCCON_SYNCSRC_MASK;
-	if (dwValue>=TIMESRC_UNKNOWN) {
+	if (dwValue==RTCCON_SYNCSRC_PPS) {
+		dwValue = TIMESRC_PPS;
+	} else if (dwValue>=TIMESRC_UNKNOWN) {
 		dwValue = TIMESRC_UNKNOWN;
 	}
 
@@ -656,217 +797,552 @@ MXIRIG_API BOOL mxIrigbGetSyncTimeSrc(HANDLE hDev, PDWORD pdwSource)
 	return TRUE;
 }
 
-/**
- * Get IRIGB signal status
- * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
- * @param  [in] dwSource - IRIGB signal source, the value is one of _PORT_LIST_.
- * @param  [out] dwStatus - A point to get IRIGB signal status, the value is one of _IRIG_SIGNAL_STATUS_.
- * @return - If the operation completes successfully, the return value is nonzero.
- *           If the operation fails or is pending, the return value is zero. 
- *           To get extended error information, call GetLastError.
- */
-MXIRIG_API BOOL mxIrigbGetSignalStatus(HANDLE hDev, DWORD dwSource, PDWORD pdwStatus)
+/* Read up to MAX_PAIRS registers in one ioctl */
+static BOOL get_registers(HANDLE hDev, const DWORD *pdwAddress, PDWORD pdwValue, int count)
 {
-	DWORD dwStatus;
+	BOOL bRet;
+#ifdef WIN32
 	DWORD dwBytesReturned;
+
+	bRet = DeviceIoControl(hDev, IOCTL_GET_REGISTER,
+		(LPVOID)pdwAddress, count * sizeof(DWORD), pdwValue, count * sizeof(DWORD),
+		&dwBytesReturned, NULL);
+#else
+	struct reg_val_pair_struct get;
+	int i;
+
+	memset(&get, 0, sizeof(get));
+	get.count = count;
+	for ( i=0; i<count; i++ ) {
+		get.addr[i] = pdwAddress[i];
+	}
+
+	/* In Linux system, the return ( value == 0 ) means TRUE */
+	bRet = ( ioctl(hDev, IOCTL_GET_REGISTER, &get) == 0 ) ? TRUE : FALSE;
+
+	for ( i=0; i<count; i++ ) {
+		pdwValue[i] = get.val[i];
+	}
+#endif
+
+	return bRet;
+}
+
+/* The INTSTS bits kept by the driver */
+static BOOL get_status(HANDLE hDev, PDWORD pdwStatus)
+{
 	BOOL bRet;
 #ifdef WIN32
+	DWORD dwBytesReturned;
+
 	bRet = DeviceIoControl(hDev, IOCTL_GET_TIMESRC_STATUS, NULL,
-			0, &dwStatus, sizeof(dwStatus), &dwBytesReturned, NULL);
+			0, pdwStatus, sizeof(DWORD), &dwBytesReturned, NULL);
 #else
 	/* In Linux system, the return ( value == 0 ) means TRUE */
-	bRet = (ioctl(hDev, IOCTL_GET_TIMESRC_STATUS, &dwStatus)==0) ? TRUE : FALSE;
+	bRet = (ioctl(hDev, IOCTL_GET_TIMESRC_STATUS, pdwStatus)==0) ? TRUE : FALSE;
 #endif
-	if (!bRet) {
-		return bRet;
-	}
-	
-	if ( dwSource == TIMESRC_FIBER) {
-		if (dwStatus & INTSTS_BIT_IRIG0DE_OFF) {
-			*pdwStatus = IRIG_STATUS_OFF_LINE;
-		} else if (dwStatus & INTSTS_BIT_IRIG0DE_FRMERR) {
-			*pdwStatus = IRIG_STATUS_FRAME_ERROR;
-		} else if (dwStatus & INTSTS_BIT_IRIG0DE_PARERR) {
-			*pdwStatus = IRIG_STATUS_PARITY_ERROR;
-		} else if (dwStatus & INTSTS_BIT_IRIG0DE_DONE) {
-			*pdwStatus = IRIG_STATUS_NORMAL;
-		} else {
-			*pdwStatus = IRIG_STATUS_UNKNOWN;
-		}
-	} else if ( dwSource == TIMESRC_PORT1) {
-		if (dwStatus & INTSTS_BIT_IRIG1DE_OFF) {
-			*pdwStatus = IRIG_STATUS_OFF_LINE;
-		} else if (dwStatus & INTSTS_BIT_IRIG1DE_FRMERR) {
-			*pdwStatus = IRIG_STATUS_FRAME_ERROR;
-		} else if (dwStatus & INTSTS_BIT_IRIG1DE_PARERR) {
-			*pdwStatus = IRIG_STATUS_PARITY_ERROR;
-		} else if (dwStatus & INTSTS_BIT_IRIG1DE_DONE) {
-			*pdwStatus = IRIG_STATUS_NORMAL;
-		} else {
-			*pdwStatus = IRIG_STATUS_UNKNOWN;
-		}
-	} else {
-		SetLastError(ERROR_ACCESS_DENIED);
-		bRet = FALSE;
-	}
 
 	return bRet;
 }
 
-/**
- * Set IRIGB input Parity check mode
- * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
- * @param  [in] dwSource - the value is one of _RTC_SYNC_SOURCE_, should not be TIMESRC_FREERUN.
- * @param  [in] dwMode - the value is one of _PARITY_CHECK_MODE_.
- * @return - If the operation completes successfully, the return value is nonzero.
- *           If the operation fails or is pending, the return value is zero. 
- *           To get extended error information, call GetLastError.
- */
-MXIRIG_API BOOL mxIrigbSetInputParityCheckMode(HANDLE hDev, DWORD dwSource, DWORD dwMode)
+/* The _IRIG_SIGNAL_STATUS_ of a decoder in the INTSTS bits, dwSource is TIMESRC_FIBER or TIMESRC_PORT1 */
+static DWORD decoder_status(DWORD dwStatus, DWORD dwSource)
 {
-	BOOL bRet = TRUE;
-	DWORD dwSetReg = 0;
-	DWORD dwClrReg = 0;
-
-	if ( dwSource == TIMESRC_FIBER ) {
-		if (dwMode == PARITY_CHECK_EVEN) {
-			dwClrReg = TMCON_BIT_IRIGDE0PARCHK_ODD |
-						TMCON_BIT_IRIGDE0PARCHK_DIS;
-		} else if (dwMode == PARITY_CHECK_ODD) {
-			dwSetReg = TMCON_BIT_IRIGDE0PARCHK_ODD;
-			dwClrReg = TMCON_BIT_IRIGDE0PARCHK_DIS;
-		} else if (dwMode == PARITY_CHECK_NONE) {
-			dwSetReg = TMCON_BIT_IRIGDE0PARCHK_DIS;
-		} else {
-			bRet = FALSE;
-		}
-	} else if ( dwSource == TIMESRC_PORT1 ) {
-		if (dwMode == PARITY_CHECK_EVEN) {
-			dwClrReg = TMCON_BIT_IRIGDE1PARCHK_ODD |
-						TMCON_BIT_IRIGDE1PARCHK_DIS;
-		} else if (dwMode == PARITY_CHECK_ODD) {
-			dwSetReg = TMCON_BIT_IRIGDE1PARCHK_ODD;
-			dwClrReg = TMCON_BIT_IRIGDE1PARCHK_DIS;
-		} else if (dwMode == PARITY_CHECK_NONE) {
-			dwSetReg = TMCON_BIT_IRIGDE1PARCHK_DIS;
-		} else {
-			bRet = FALSE;
-		}
-	} else {
-		bRet = FALSE;
+	/* The bits of decoder 1 follow the ones of decoder 0 */
+	if ( dwSource == TIMESRC_PORT1 ) {
+		dwStatus >>= 4;
 	}
 
-	if (bRet) {
-		bRet = mxirigb_setclrreg(hDev, TMCON, dwSetReg, dwClrReg );
+	if (dwStatus & INTSTS_BIT_IRIG0DE_OFF) {
+		return IRIG_STATUS_OFF_LINE;
+	} else if (dwStatus & INTSTS_BIT_IRIG0DE_FRMERR) {
+		return IRIG_STATUS_FRAME_ERROR;
+	} else if (dwStatus & INTSTS_BIT_IRIG0DE_PARERR) {
+		return IRIG_STATUS_PARITY_ERROR;
+	} else if (dwStatus & INTSTS_BIT_IRIG0DE_DONE) {
+		return IRIG_STATUS_NORMAL;
 	}
 
-	if (!bRet) {
-		SetLastError(ERROR_ACCESS_DENIED);
+	return IRIG_STATUS_UNKNOWN;
+}
+
+/* The _IRIG_SIGNAL_STATUS_ of the PPS decoder in the INTSTS bits */
+static DWORD pps_status(DWORD dwStatus)
+{
+	if (dwStatus & INTSTS_BIT_PPSDE_TIMEOUT) {
+		return IRIG_STATUS_OFF_LINE;
+	} else if (dwStatus & INTSTS_BIT_PPSDE_DONE) {
+		return IRIG_STATUS_NORMAL;
 	}
 
-	return bRet;
+	return IRIG_STATUS_UNKNOWN;
 }
 
 /**
- * Get IRIGB input Parity check mode
+ * Get IRIGB signal status
  * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
- * @param  [in] dwSource - the value is one of _RTC_SYNC_SOURCE_, should not be TIMESRC_FREERUN.
- * @param  [out] pdwMode - A point to get output parity check mode, the value is one of _PARITY_CHECK_MODE_.
+ * @param  [in] dwSource - TIMESRC_FIBER, TIMESRC_PORT1 or TIMESRC_PPS. The PPS decoder is off line
+ *         after a time out and normal after a pulse.
+ * @param  [out] dwStatus - A point to get IRIGB signal status, the value is one of _IRIG_SIGNAL_STATUS_.
  * @return - If the operation completes successfully, the return value is nonzero.
  *           If the operation fails or is pending, the return value is zero. 
  *           To get extended error information, call GetLastError.
  */
-MXIRIG_API BOOL mxIrigbGetInputParityCheckMode(HANDLE hDev, DWORD dwSource, PDWORD pdwMode)
+MXIRIG_API BOOL mxIrigbGetSignalStatus(HANDLE hDev, DWORD dwSource, PDWORD pdwStatus)
 {
-	BOOL bRet = TRUE;
-	DWORD dwReg = 0;
-	DWORD dwMode;
-
-	bRet = mxirigb_getreg(hDev, TMCON, &dwReg );
-	if ( dwSource == TIMESRC_FIBER ) {
-		if (dwReg & TMCON_BIT_IRIGDE0PARCHK_DIS) {
-			dwMode = PARITY_CHECK_NONE;
-		} else if (dwReg & TMCON_BIT_IRIGDE0PARCHK_ODD) {
-			dwMode = PARITY_CHECK_ODD;
-		} else {
-			dwMode = PARITY_CHECK_EVEN;
-		}
-	} else if ( dwSource == TIMESRC_PORT1 ) {
-		if (dwReg & TMCON_BIT_IRIGDE1PARCHK_DIS) {
-			dwMode = PARITY_CHECK_NONE;
-		} else if (dwReg & TMCON_BIT_IRIGDE1PARCHK_ODD) {
-			dwMode = PARITY_CHECK_ODD;
-		} else {
-			dwMode = PARITY_CHECK_EVEN;
-		}
-	} else {
-		bRet = FALSE;
-	}
+	DWORD dwStatus;
+	BOOL bRet;
 
+	bRet = get_status(hDev, &dwStatus);
 	if (!bRet) {
-		SetLastError(ERROR_ACCESS_DENIED);
+		return bRet;
+	}
+	
+	if ( dwSource == TIMESRC_FIBER || dwSource == TIMESRC_PORT1 ) {
+		*pdwStatus = decoder_status(dwStatus, dwSource);
+	} else if ( dwSource == TIMESRC_PPS ) {
+		*pdwStatus = pps_status(dwStatus);
 	} else {
-		*pdwMode = dwMode;
+		SetLastError(ERROR_ACCESS_DENIED);
+		bRet = FALSE;
 	}
 
 	return bRet;
 }
 
 /**
- * Set IRIGB output Parity check mode
+ * Get the status of all sources from one status word
  * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
- * @param  [in] dwMode - the value is one of _PARITY_CHECK_MODE_, should not be PARITY_CHECK_NONE.
+ * @param  [out] pStatus - A pointer to an IRIGB_ALL_STATUS structure to receive the status.
+ * @param  [in,out] pCounters - The event counters to accumulate the status word into, NULL for none.
  * @return - If the operation completes successfully, the return value is nonzero.
  *           If the operation fails or is pending, the return value is zero. 
  *           To get extended error information, call GetLastError.
  */
-MXIRIG_API BOOL mxIrigbSetOutputParityCheckMode(HANDLE hDev, DWORD dwMode)
+MXIRIG_API BOOL mxIrigbGetAllStatus(HANDLE hDev, PIRIGB_ALL_STATUS pStatus, PIRIGB_STATUS_COUNTERS pCounters)
 {
-	BOOL bRet = TRUE;
-	DWORD dwSetReg = 0;
-	DWORD dwClrReg = 0;
+	DWORD dwStatus;
 
-	if (dwMode == PARITY_CHECK_EVEN) {
-		dwClrReg = TMCON_BIT_IRIGENPARCHK_ODD;
-	} else if (dwMode == PARITY_CHECK_ODD) {
-		dwSetReg = TMCON_BIT_IRIGENPARCHK_ODD;
-	} else {
-		bRet = FALSE;
+	if ( !get_status(hDev, &dwStatus) ) {
+		return FALSE;
 	}
 
-	if (bRet) {
-		bRet = mxirigb_setclrreg(hDev, TMCON, dwSetReg, dwClrReg );
-	}
+	pStatus->intsts = dwStatus;
+	pStatus->signal[0] = decoder_status(dwStatus, TIMESRC_FIBER);
+	pStatus->signal[1] = decoder_status(dwStatus, TIMESRC_PORT1);
+	pStatus->ppsTimeout = (dwStatus & INTSTS_BIT_PPSDE_TIMEOUT) ? 1:0;
+	pStatus->ppsDone = (dwStatus & INTSTS_BIT_PPSDE_DONE) ? 1:0;
+	pStatus->irigEncoderDone = (dwStatus & INTSTS_BIT_IRIGEN_DONE) ? 1:0;
+	pStatus->ppsEncoderDone = (dwStatus & INTSTS_BIT_PPSEN_DONE) ? 1:0;
 
-	if (!bRet) {
-		SetLastError(ERROR_ACCESS_DENIED);
+	if ( pCounters ) {
+		mxIrigbCountStatus(dwStatus, pCounters);
 	}
 
-	return bRet;
+	return TRUE;
 }
 
 /**
- * Get IRIGB output Parity check mode
- * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
- * @param  [out] pdwMode - A point to get output parity check mode.
- * @return - If the operation completes successfully, the return value is nonzero.
- *           If the operation fails or is pending, the return value is zero. 
- *           To get extended error information, call GetLastError.
+ * Accumulate a status word into event counters
+ * @param  [in] dwStatus - The INTSTS bits, e.g. IRIGB_ALL_STATUS.intsts or IRIGB_DECODERS.intsts.
+ * @param  [in,out] pCounters - The event counters.
+ * @return None
  */
-MXIRIG_API BOOL mxIrigbGetOutputParityCheckMode(HANDLE hDev, PDWORD pdwMode)
+MXIRIG_API void mxIrigbCountStatus(DWORD dwStatus, PIRIGB_STATUS_COUNTERS pCounters)
 {
-	BOOL bRet = TRUE;
-	DWORD dwReg = 0;
-	DWORD dwMode;
+	int i;
 
-	bRet = mxirigb_getreg(hDev, TMCON, &dwReg );
-	if (dwReg & TMCON_BIT_IRIGENPARCHK_ODD) {
-		dwMode = PARITY_CHECK_ODD;
-	} else {
-		dwMode = PARITY_CHECK_EVEN;
+	pCounters->polls++;
+	for ( i = 0; i < IRIGB_STATUS_BITS; i++ ) {
+		if ( dwStatus & (1<<i) ) {
+			pCounters->bit[i]++;
+		}
 	}
+}
 
-	if (!bRet) {
+#ifdef WIN32
+static long long monotonic_ns(void)
+{
+	return (long long)GetTickCount64() * 1000000;
+}
+
+static void sleep_ns(long long ns)
+{
+	Sleep((DWORD)((ns + 999999) / 1000000));
+}
+#else
+static long long monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_ns(long long ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ns / 1000000000LL;
+	ts.tv_nsec = ns % 1000000000LL;
+	nanosleep(&ts, NULL);
+}
+
+/* Wait in poll() for the events latched by the driver, return 0 if it does not support it, -1 on failure */
+static int wait_poll(HANDLE hDev, DWORD dwMask, long long deadline, PDWORD pdwEvents)
+{
+	struct pollfd pfd;
+	DWORD dwStatus;
+	long long now;
+	int timeout;
+
+	/* Without poll support the device is always ready, also for writing */
+	pfd.fd = hDev;
+	pfd.events = POLLIN | POLLPRI | POLLOUT;
+	if ( poll(&pfd, 1, 0) < 0 || (pfd.revents & POLLOUT) ) {
+		return 0;
+	}
+
+	for (;;) {
+		if ( pfd.revents & (POLLERR | POLLHUP | POLLNVAL) ) {
+			return -1;
+		}
+		if ( pfd.revents & (POLLIN | POLLPRI) ) {
+			if ( !get_status(hDev, &dwStatus) ) {
+				return -1;
+			}
+			*pdwEvents = dwStatus & dwMask;
+			if ( *pdwEvents ) {
+				return 1;
+			}
+		}
+
+		timeout = -1;
+		if ( deadline >= 0 ) {
+			now = monotonic_ns();
+			if ( now >= deadline ) {
+				return 1;
+			}
+			timeout = (int)((deadline - now + 999999) / 1000000);
+		}
+
+		pfd.events = POLLIN | POLLPRI;
+		pfd.revents = 0;
+		if ( poll(&pfd, 1, timeout) < 0 && errno != EINTR ) {
+			return -1;
+		}
+	}
+}
+#endif
+
+/* The registers the event poller watches: the decoder counters, the RTC second and nanoseconds */
+static const DWORD wait_address[4] = { IRIGBDE0CNT, IRIGBDE1CNT, RTCDAT0, RTCDAT2 };
+
+/* The port configuration read on an RTC second, whether the PPS decoder and the encoders are in use */
+static const DWORD wait_port_address[2] = { INPORTCON, OUTPORTCON };
+
+/* The events the RTC second stands in for */
+#define WAIT_SECOND_BITS	(INTSTS_BIT_PPSDE_DONE | INTSTS_BIT_IRIGEN_DONE | INTSTS_BIT_PPSEN_DONE)
+
+/* Whether an output port of OUTPORTCON selects dwSel */
+static BOOL output_selected(DWORD dwOutportcon, DWORD dwSel)
+{
+	int i;
+
+	for ( i = 0; i < 6; i++ ) {
+		if ( ((dwOutportcon >> (OUTPORTCON_P0_BIT_S + i * (OUTPORTCON_P1_BIT_S - OUTPORTCON_P0_BIT_S))) &
+			OUTPORTCON_MASK) == dwSel ) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* The edges between two reads of wait_address and the status word, pdwPort is read on the last RTC second */
+static DWORD wait_edges(const DWORD *pdwLast, const DWORD *pdwNow, const DWORD *pdwPort, DWORD dwLastStatus,
+	DWORD dwStatus)
+{
+	DWORD dwEvents = 0;
+
+	/* The done bits the card latches itself */
+	dwEvents |= dwStatus & ~dwLastStatus & (INTSTS_BIT_IRIG0DE_DONE | INTSTS_BIT_IRIG1DE_DONE | WAIT_SECOND_BITS);
+
+	/* A decoder counter restarts at the reference marker of the next frame */
+	if ( pdwNow[0] < pdwLast[0] ) {
+		dwEvents |= INTSTS_BIT_IRIG0DE_DONE;
+	}
+	if ( pdwNow[1] < pdwLast[1] ) {
+		dwEvents |= INTSTS_BIT_IRIG1DE_DONE;
+	}
+
+	/* The PPS decoder with a pulse and the encoders driving a port are on the RTC second,
+	 * INPORTCON_BIT_PPSDE_DIS set enables the PPS decoder as mxIrigbGetPpsInput() reads it */
+	if ( pdwNow[2] != pdwLast[2] ) {
+		if ( (pdwPort[0] & INPORTCON_BIT_PPSDE_DIS) && !(dwStatus & INTSTS_BIT_PPSDE_TIMEOUT) ) {
+			dwEvents |= INTSTS_BIT_PPSDE_DONE;
+		}
+		if ( output_selected(pdwPort[1], OUTPSEL_IRIGBEN) ) {
+			dwEvents |= INTSTS_BIT_IRIGEN_DONE;
+		}
+		if ( output_selected(pdwPort[1], OUTPSEL_PPSEN) ) {
+			dwEvents |= INTSTS_BIT_PPSEN_DONE;
+		}
+	}
+
+	return dwEvents;
+}
+
+/* ns to the next edge of the events waited for */
+static long long wait_next_edge(DWORD dwMask, const DWORD *pdwNow)
+{
+	long long next = -1, t;
+	int i;
+
+	for ( i = 0; i < 2; i++ ) {
+		if ( dwMask & (i ? INTSTS_BIT_IRIG1DE_DONE : INTSTS_BIT_IRIG0DE_DONE) ) {
+			t = (long long)pdwNow[i] * IRIGBDECNT_UNIT;
+			/* A lost signal leaves the counter running */
+			if ( t < 1000000000LL && (next < 0 || 1000000000LL - t < next) ) {
+				next = 1000000000LL - t;
+			}
+		}
+	}
+
+	/* The other events and the decoders without a signal follow the RTC second */
+	if ( next < 0 || (dwMask & ~(INTSTS_BIT_IRIG0DE_DONE | INTSTS_BIT_IRIG1DE_DONE)) ) {
+		t = 1000000000LL - (long long)pdwNow[3] % 1000000000LL;
+		if ( next < 0 || t < next ) {
+			next = t;
+		}
+	}
+
+	return next;
+}
+
+/**
+ * Wait for events of the decoders, the PPS decoder or the encoders
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwMask - The events to wait for, (1 << _IRIGB_STATUS_BIT_) bits.
+ * @param  [in] dwTimeout - The timeout in ms, MXIRIG_WAIT_INFINITE for none.
+ * @param  [out] pdwEvents - The events occurred, 0 on timeout.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbWaitEvent(HANDLE hDev, DWORD dwMask, DWORD dwTimeout, PDWORD pdwEvents)
+{
+	DWORD pdwLast[4], pdwNow[4], pdwPort[2] = { 0, 0 };
+	DWORD dwLastStatus, dwStatus;
+	long long deadline, now, wait;
+
+	*pdwEvents = 0;
+	dwMask &= (1 << IRIGB_STATUS_BITS) - 1;
+	if ( dwMask == 0 ) {
+		SetLastError(ERROR_ACCESS_DENIED);
+		return FALSE;
+	}
+	deadline = (dwTimeout == MXIRIG_WAIT_INFINITE) ? -1 : monotonic_ns() + dwTimeout * 1000000LL;
+
+#ifndef WIN32
+	switch ( wait_poll(hDev, dwMask, deadline, pdwEvents) ) {
+	case 1:
+		return TRUE;
+	case -1:
+		return FALSE;
+	}
+#endif
+
+	/* Without interrupts, sleep until shortly before the expected edge and read closely */
+	if ( !get_status(hDev, &dwLastStatus) || !get_registers(hDev, wait_address, pdwLast, 4) ) {
+		return FALSE;
+	}
+	for (;;) {
+		if ( !get_status(hDev, &dwStatus) || !get_registers(hDev, wait_address, pdwNow, 4) ) {
+			return FALSE;
+		}
+		if ( pdwNow[2] != pdwLast[2] && (dwMask & WAIT_SECOND_BITS) &&
+			!get_registers(hDev, wait_port_address, pdwPort, 2) ) {
+			return FALSE;
+		}
+		*pdwEvents = ((dwStatus & WAIT_LEVEL_BITS) | wait_edges(pdwLast, pdwNow, pdwPort, dwLastStatus, dwStatus)) &
+			dwMask;
+		if ( *pdwEvents ) {
+			return TRUE;
+		}
+
+		now = monotonic_ns();
+		if ( deadline >= 0 && now >= deadline ) {
+			return TRUE;
+		}
+		memcpy(pdwLast, pdwNow, sizeof(pdwLast));
+		dwLastStatus = dwStatus;
+
+		wait = wait_next_edge(dwMask, pdwNow) - WAIT_GUARD;
+		if ( wait < WAIT_SPIN ) {
+			wait = WAIT_SPIN;
+		}
+		if ( deadline >= 0 && now + wait > deadline ) {
+			wait = deadline - now;
+		}
+		sleep_ns(wait);
+	}
+}
+
+/**
+ * Set IRIGB input Parity check mode
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwSource - the value is one of _RTC_SYNC_SOURCE_, should not be TIMESRC_FREERUN.
+ * @param  [in] dwMode - the value is one of _PARITY_CHECK_MODE_.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetInputParityCheckMode(HANDLE hDev, DWORD dwSource, DWORD dwMode)
+{
+	BOOL bRet = TRUE;
+	DWORD dwSetReg = 0;
+	DWORD dwClrReg = 0;
+
+	if ( dwSource == TIMESRC_FIBER ) {
+		if (dwMode == PARITY_CHECK_EVEN) {
+			dwClrReg = TMCON_BIT_IRIGDE0PARCHK_ODD |
+						TMCON_BIT_IRIGDE0PARCHK_DIS;
+		} else if (dwMode == PARITY_CHECK_ODD) {
+			dwSetReg = TMCON_BIT_IRIGDE0PARCHK_ODD;
+			dwClrReg = TMCON_BIT_IRIGDE0PARCHK_DIS;
+		} else if (dwMode == PARITY_CHECK_NONE) {
+			dwSetReg = TMCON_BIT_IRIGDE0PARCHK_DIS;
+		} else {
+			bRet = FALSE;
+		}
+	} else if ( dwSource == TIMESRC_PORT1 ) {
+		if (dwMode == PARITY_CHECK_EVEN) {
+			dwClrReg = TMCON_BIT_IRIGDE1PARCHK_ODD |
+						TMCON_BIT_IRIGDE1PARCHK_DIS;
+		} else if (dwMode == PARITY_CHECK_ODD) {
+			dwSetReg = TMCON_BIT_IRIGDE1PARCHK_ODD;
+			dwClrReg = TMCON_BIT_IRIGDE1PARCHK_DIS;
+		} else if (dwMode == PARITY_CHECK_NONE) {
+			dwSetReg = TMCON_BIT_IRIGDE1PARCHK_DIS;
+		} else {
+			bRet = FALSE;
+		}
+	} else {
+		bRet = FALSE;
+	}
+
+	if (bRet) {
+		bRet = mxirigb_setclrreg(hDev, TMCON, dwSetReg, dwClrReg );
+	}
+
+	if (!bRet) {
+		SetLastError(ERROR_ACCESS_DENIED);
+	}
+
+	return bRet;
+}
+
+/**
+ * Get IRIGB input Parity check mode
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwSource - the value is one of _RTC_SYNC_SOURCE_, should not be TIMESRC_FREERUN.
+ * @param  [out] pdwMode - A point to get output parity check mode, the value is one of _PARITY_CHECK_MODE_.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetInputParityCheckMode(HANDLE hDev, DWORD dwSource, PDWORD pdwMode)
+{
+	BOOL bRet = TRUE;
+	DWORD dwReg = 0;
+	DWORD dwMode;
+
+	bRet = mxirigb_getreg(hDev, TMCON, &dwReg );
+	if ( dwSource == TIMESRC_FIBER ) {
+		if (dwReg & TMCON_BIT_IRIGDE0PARCHK_DIS) {
+			dwMode = PARITY_CHECK_NONE;
+		} else if (dwReg & TMCON_BIT_IRIGDE0PARCHK_ODD) {
+			dwMode = PARITY_CHECK_ODD;
+		} else {
+			dwMode = PARITY_CHECK_EVEN;
+		}
+	} else if ( dwSource == TIMESRC_PORT1 ) {
+		if (dwReg & TMCON_BIT_IRIGDE1PARCHK_DIS) {
+			dwMode = PARITY_CHECK_NONE;
+		} else if (dwReg & TMCON_BIT_IRIGDE1PARCHK_ODD) {
+			dwMode = PARITY_CHECK_ODD;
+		} else {
+			dwMode = PARITY_CHECK_EVEN;
+		}
+	} else {
+		bRet = FALSE;
+	}
+
+	if (!bRet) {
+		SetLastError(ERROR_ACCESS_DENIED);
+	} else {
+		*pdwMode = dwMode;
+	}
+
+	return bRet;
+}
+
+/**
+ * Set IRIGB output Parity check mode
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwMode - the value is one of _PARITY_CHECK_MODE_, should not be PARITY_CHECK_NONE.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetOutputParityCheckMode(HANDLE hDev, DWORD dwMode)
+{
+	BOOL bRet = TRUE;
+	DWORD dwSetReg = 0;
+	DWORD dwClrReg = 0;
+
+	if (dwMode == PARITY_CHECK_EVEN) {
+		dwClrReg = TMCON_BIT_IRIGENPARCHK_ODD;
+	} else if (dwMode == PARITY_CHECK_ODD) {
+		dwSetReg = TMCON_BIT_IRIGENPARCHK_ODD;
+	} else {
+		bRet = FALSE;
+	}
+
+	if (bRet) {
+		bRet = mxirigb_setclrreg(hDev, TMCON, dwSetReg, dwClrReg );
+	}
+
+	if (!bRet) {
+		SetLastError(ERROR_ACCESS_DENIED);
+	}
+
+	return bRet;
+}
+
+/**
+ * Get IRIGB output Parity check mode
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pdwMode - A point to get output parity check mode.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetOutputParityCheckMode(HANDLE hDev, PDWORD pdwMode)
+{
+	BOOL bRet = TRUE;
+	DWORD dwReg = 0;
+	DWORD dwMode;
+
+	bRet = mxirigb_getreg(hDev, TMCON, &dwReg );
+	if (dwReg & TMCON_BIT_IRIGENPARCHK_ODD) {
+		dwMode = PARITY_CHECK_ODD;
+	} else {
+		dwMode = PARITY_CHECK_EVEN;
+	}
+
+	if (!bRet) {
 		SetLastError(ERROR_ACCESS_DENIED);
 	} else {
 		*pdwMode = dwMode;
@@ -926,6 +1402,175 @@ MXIRIG_API BOOL mxIrigbGetPpsWidth(HANDLE hDev, PDWORD pdwMilliSecond)
 	return bRet;
 }
 
+/**
+ * Feed the PPS decoder from the input of a port.
+ * The decoder takes the input line the IRIG-B decoder of the port takes, so the signal
+ * type and inversion are set by "mxIrigbSetInputSignalType" function.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwPort - PORT_FIBER or PORT_1, PORT_UNKNOWN to disable the PPS decoder.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetPpsInput(HANDLE hDev, DWORD dwPort)
+{
+	DWORD dwValue;
+	DWORD dwInput;
+	BOOL bRet = FALSE;
+
+	if (dwPort == PORT_UNKNOWN) {
+		bRet = mxirigb_setclrreg(hDev, INPORTCON, 0, INPORTCON_BIT_PPSDE_DIS);
+	} else if ((dwPort == PORT_FIBER || dwPort == PORT_1) &&
+		mxirigb_getreg(hDev, INPORTCON, &dwValue)) {
+		dwInput = (dwValue >> ((dwPort == PORT_FIBER) ? INPORTCON_IRIGDE0_BIT_S : INPORTCON_IRIGDE1_BIT_S)) &
+			INPORTCON_MASK;
+
+		/* As the IRIG-B decoders, the PPSDE_DIS bit set enables the decoder */
+		bRet = mxirigb_setclrreg(hDev, INPORTCON,
+			(dwInput << INPORTCON_PPSDE_BIT_S) | INPORTCON_BIT_PPSDE_DIS,
+			(INPORTCON_MASK << INPORTCON_PPSDE_BIT_S) | INPORTCON_BIT_PPSDE_DIS );
+	}
+
+	if (!bRet) {
+		SetLastError(ERROR_ACCESS_DENIED);
+	}
+
+	return bRet;
+}
+
+/**
+ * Get the port feeding the PPS decoder
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pdwPort - A point to get PORT_FIBER or PORT_1, PORT_UNKNOWN if the decoder is
+ *         disabled or takes another input.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetPpsInput(HANDLE hDev, PDWORD pdwPort)
+{
+	DWORD dwValue;
+	DWORD dwInput;
+	BOOL bRet;
+
+	bRet = mxirigb_getreg(hDev, INPORTCON, &dwValue);
+	if (bRet) {
+		dwInput = (dwValue >> INPORTCON_PPSDE_BIT_S) & INPORTCON_MASK;
+		if (!(dwValue & INPORTCON_BIT_PPSDE_DIS)) {
+			*pdwPort = PORT_UNKNOWN;
+		} else if (dwInput == ((dwValue >> INPORTCON_IRIGDE1_BIT_S) & INPORTCON_MASK)) {
+			*pdwPort = PORT_1;
+		} else if (dwInput == ((dwValue >> INPORTCON_IRIGDE0_BIT_S) & INPORTCON_MASK)) {
+			*pdwPort = PORT_FIBER;
+		} else {
+			*pdwPort = PORT_UNKNOWN;
+		}
+	}
+
+	if (!bRet) {
+		SetLastError(ERROR_ACCESS_DENIED);
+	}
+
+	return bRet;
+}
+
+/**
+ * Set Pulse Per Second input hold time, the PPS decoder ignores the edges this long after a pulse
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwMilliSecond - The hold time per millisecond, 0 ~ 999.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetPpsHoldTime(HANDLE hDev, DWORD dwMilliSecond)
+{
+	BOOL bRet = FALSE;
+
+	/* A hold of a second would swallow the next pulse */
+	if (dwMilliSecond<1000) {
+		bRet = mxirigb_setclrreg(hDev, PPSCON,
+			dwMilliSecond << PPSCON_DE_HOLDTIME_BIT_S,
+			PPSCON_DE_HOLDTIME_MASK << PPSCON_DE_HOLDTIME_BIT_S );
+	}
+
+	if (!bRet) {
+		SetLastError(ERROR_ACCESS_DENIED);
+	}
+
+	return bRet;
+}
+
+/**
+ * Get Pulse Per Second input hold time
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pdwMilliSecond - A point to get the hold time per millisecond value.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetPpsHoldTime(HANDLE hDev, PDWORD pdwMilliSecond)
+{
+	BOOL bRet = FALSE;
+	DWORD dwValue;
+
+	bRet = mxirigb_getreg(hDev, PPSCON, &dwValue);
+	if (bRet) {
+		*pdwMilliSecond = (dwValue >> PPSCON_DE_HOLDTIME_BIT_S) &
+						PPSCON_DE_HOLDTIME_MASK;
+	}
+
+	if (!bRet) {
+		SetLastError(ERROR_ACCESS_DENIED);
+	}
+
+	return bRet;
+}
+
+/**
+ * Set Pulse Per Second input timeout, the PPS decoder raises IRIGB_BIT_PPSDE_TIMEOUT
+ * when no pulse comes this long
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwMilliSecond - The timeout per millisecond, more than 1000.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetPpsTimeout(HANDLE hDev, DWORD dwMilliSecond)
+{
+	BOOL bRet = FALSE;
+
+	/* The pulses come a second apart */
+	if (dwMilliSecond>1000) {
+		bRet = mxirigb_setreg(hDev, PPSDETIMEOUT, dwMilliSecond);
+	}
+
+	if (!bRet) {
+		SetLastError(ERROR_ACCESS_DENIED);
+	}
+
+	return bRet;
+}
+
+/**
+ * Get Pulse Per Second input timeout
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pdwMilliSecond - A point to get the timeout per millisecond value.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetPpsTimeout(HANDLE hDev, PDWORD pdwMilliSecond)
+{
+	BOOL bRet;
+
+	bRet = mxirigb_getreg(hDev, PPSDETIMEOUT, pdwMilliSecond);
+	if (!bRet) {
+		SetLastError(ERROR_ACCESS_DENIED);
+	}
+
+	return bRet;
+}
+
 /**
  * Set input signal type
  * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
@@ -1342,32 +1987,223 @@ MXIRIG_API BOOL mxIrigbGetOutputSignalType(HANDLE hDev, DWORD dwPort, PDWORD pdw
 			*pbInvert = FALSE;
 		}
 
-		if (OUTPSEL_IRIGBEN==((dwOutportcon >> dwOutportconShift)&OUTPORTCON_MASK)) {
-			*pdwMode = MODE_IRIGB;
-		} else if (OUTPSEL_PPSEN==((dwOutportcon >> dwOutportconShift)&OUTPORTCON_MASK)) {
-			*pdwMode = MODE_PPS;
-		} else if (OUTPSEL_INP0==((dwOutportcon >> dwOutportconShift)&OUTPORTCON_MASK)) {
-			*pdwMode = MODE_FROM_FIBER_IN;
-		} else if (OUTPSEL_INP1==((dwOutportcon >> OUTPORTCON_P1_BIT_S)&OUTPORTCON_MASK)) {
-			*pdwMode = MODE_FROM_PORT1_IN; // TYPE_TTL
-		} else if (OUTPSEL_INP2==((dwOutportcon >> OUTPORTCON_P1_BIT_S)&OUTPORTCON_MASK)) {
-			*pdwMode = MODE_FROM_PORT1_IN; // TYPE_DIFFERENTIAL
+		if (OUTPSEL_IRIGBEN==((dwOutportcon >> dwOutportconShift)&OUTPORTCON_MASK)) {
+			*pdwMode = MODE_IRIGB;
+		} else if (OUTPSEL_PPSEN==((dwOutportcon >> dwOutportconShift)&OUTPORTCON_MASK)) {
+			*pdwMode = MODE_PPS;
+		} else if (OUTPSEL_INP0==((dwOutportcon >> dwOutportconShift)&OUTPORTCON_MASK)) {
+			*pdwMode = MODE_FROM_FIBER_IN;
+		} else if (OUTPSEL_INP1==((dwOutportcon >> OUTPORTCON_P1_BIT_S)&OUTPORTCON_MASK)) {
+			*pdwMode = MODE_FROM_PORT1_IN; // TYPE_TTL
+		} else if (OUTPSEL_INP2==((dwOutportcon >> OUTPORTCON_P1_BIT_S)&OUTPORTCON_MASK)) {
+			*pdwMode = MODE_FROM_PORT1_IN; // TYPE_DIFFERENTIAL
+		}
+
+		if (0==(dwPortdat&(1 << (dwOutputModeShift+PORTDATA_OUTPUT_BIT_S)))) {
+			*pdwType = TYPE_TTL;
+		} else {
+			*pdwType = TYPE_DIFFERENTIAL;
+		}
+
+		bRet = TRUE;
+	}
+
+	if (!bRet) {
+		SetLastError(ERROR_ACCESS_DENIED);
+	}
+
+	return bRet;
+}
+
+/* One loopback test run, the round trip in ns, 0 if the pulse did not come back, -1 on failure */
+static long long loopback_run(HANDLE hDev)
+{
+	DWORD dwValue;
+	long long deadline;
+
+	/* The FPGA clears the LBT bit when the input stops the counter */
+	if (!mxirigb_setclrreg(hDev, SYSCON, 0, SYSCON_BIT_LBT) ||
+		!mxirigb_setclrreg(hDev, SYSCON, SYSCON_BIT_LBT, SYSCON_BIT_LBT)) {
+		return -1;
+	}
+
+	deadline = monotonic_ns() + LOOPBACK_TIMEOUT;
+	do {
+		if (!mxirigb_getreg(hDev, SYSCON, &dwValue)) {
+			return -1;
+		}
+		if (!(dwValue & SYSCON_BIT_LBT)) {
+			if (!mxirigb_getreg(hDev, LPBTCNT, &dwValue)) {
+				return -1;
+			}
+			return (long long)dwValue * LPBTCNT_UNIT;
+		}
+	} while (monotonic_ns() < deadline);
+
+	mxirigb_setclrreg(hDev, SYSCON, 0, SYSCON_BIT_LBT);
+	return 0;
+}
+
+/**
+ * Measure the round trip delay of a loopback from an output port to an input port.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwOutPort - The output port, PORT_1 ~ PORT_4.
+ * @param  [in] dwInPort - The input port, PORT_FIBER or PORT_1.
+ * @param  [in] dwRuns - The runs to average, 1 ~ MXIRIG_LOOPBACK_MAX_RUNS.
+ * @param  [out] pResult - A pointer to an IRIGB_LOOPBACK structure to receive the delays.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbMeasureLoopback(HANDLE hDev, DWORD dwOutPort, DWORD dwInPort, DWORD dwRuns, PIRIGB_LOOPBACK pResult)
+{
+	DWORD dwHwId;
+	DWORD dwInportcon;
+	DWORD dwOutportcon;
+	DWORD dwOutportconShift = -1;
+	DWORD dwInput;
+	DWORD i;
+	double mean = 0, m2 = 0, delta;
+	long long delay;
+	BOOL bRet = FALSE;
+
+	memset(pResult, 0, sizeof(*pResult));
+
+	if (!mxIrigbGetHardwareID(hDev, &dwHwId)) {
+		return FALSE;
+	}
+
+	/* The port fields of "mxIrigbSetOutputSignalType" function */
+	if (dwOutPort==PORT_1) {
+		dwOutportconShift = OUTPORTCON_P1_BIT_S;
+	} else if (dwHwId==DA_IRIGB_S) {
+		if (dwOutPort==PORT_2) {
+			dwOutportconShift = OUTPORTCON_P3_BIT_S;
+		} else if (dwOutPort==PORT_3) {
+			dwOutportconShift = OUTPORTCON_P2_BIT_S;
+		} else if (dwOutPort==PORT_4) {
+			dwOutportconShift = OUTPORTCON_P4_BIT_S;
+		}
+	}
+
+	if (dwOutportconShift==-1 || (dwInPort!=PORT_FIBER && dwInPort!=PORT_1) ||
+		dwRuns<1 || dwRuns>MXIRIG_LOOPBACK_MAX_RUNS ||
+		!mxirigb_getreg(hDev, INPORTCON, &dwInportcon) ||
+		!mxirigb_getreg(hDev, OUTPORTCON, &dwOutportcon)) {
+		SetLastError(ERROR_ACCESS_DENIED);
+		return FALSE;
+	}
+
+	/* The LBT input takes the input line of the IRIG-B decoder, its DIS bit set enables it */
+	dwInput = (dwInportcon >> ((dwInPort == PORT_FIBER) ? INPORTCON_IRIGDE0_BIT_S : INPORTCON_IRIGDE1_BIT_S)) &
+		INPORTCON_MASK;
+	if (mxirigb_setclrreg(hDev, INPORTCON,
+			(dwInput << INPORTCON_LBT_BIT_S) | INPORTCON_BIT_LBT_DIS,
+			(INPORTCON_MASK << INPORTCON_LBT_BIT_S) | INPORTCON_BIT_LBT_DIS ) &&
+		mxirigb_setclrreg(hDev, OUTPORTCON,
+			OUTPSEL_LPTS << dwOutportconShift,
+			OUTPORTCON_MASK << dwOutportconShift )) {
+		bRet = TRUE;
+		for ( i = 0; i < dwRuns; i++ ) {
+			if (i) {
+				sleep_ns(LOOPBACK_GAP);
+			}
+			delay = loopback_run(hDev);
+			if (delay < 0) {
+				bRet = FALSE;
+				break;
+			}
+			if (delay == 0) {
+				pResult->failures++;
+				continue;
+			}
+
+			/* Welford's running mean and variance */
+			if (pResult->runs == 0 || delay < pResult->min) {
+				pResult->min = delay;
+			}
+			if (pResult->runs == 0 || delay > pResult->max) {
+				pResult->max = delay;
+			}
+			pResult->runs++;
+			delta = delay - mean;
+			mean += delta / pResult->runs;
+			m2 += delta * (delay - mean);
+		}
+	}
+
+	mxirigb_setreg(hDev, OUTPORTCON, dwOutportcon);
+	mxirigb_setreg(hDev, INPORTCON, dwInportcon);
+
+	if (pResult->runs) {
+		pResult->mean = (long long)(mean + 0.5);
+		pResult->stddev = (long long)(sqrt(m2 / pResult->runs) + 0.5);
+	} else {
+		bRet = FALSE;
+	}
+
+	if (!bRet) {
+		SetLastError(ERROR_ACCESS_DENIED);
+	}
+
+	return bRet;
+}
+
+/**
+ * Get the advance of the RTC compensating the cable delays of the output ports.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] plDelay - The cable delays of the ports in ns, indexed by _PORT_LIST_ up to PORT_4.
+ * @param  [out] pllAdvance - A point to get the time the RTC should lead in ns.
+ * @param  [out] pllSpread - A point to get the largest error of a port in ns.
+ * @param  [out] pdwPorts - A point to get the encoder ports, (1 << port) bits.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetOutputAdvance(HANDLE hDev, const long plDelay[PORT_UNKNOWN], long long *pllAdvance,
+	long long *pllSpread, PDWORD pdwPorts)
+{
+	DWORD dwHwId;
+	DWORD dwPort;
+	DWORD dwType;
+	DWORD dwMode;
+	BOOL bInvert;
+	long lMin = 0, lMax = 0;
+
+	*pllAdvance = 0;
+	*pllSpread = 0;
+	*pdwPorts = 0;
+
+	if (!mxIrigbGetHardwareID(hDev, &dwHwId)) {
+		SetLastError(ERROR_ACCESS_DENIED);
+		return FALSE;
+	}
+
+	/* Only DA-IRIGB-S has the ports 2 ~ 4 */
+	for ( dwPort = PORT_1; dwPort <= ((dwHwId == DA_IRIGB_S) ? PORT_4 : PORT_1); dwPort++ ) {
+		dwMode = MODE_UNKNOWN;
+		if (!mxIrigbGetOutputSignalType(hDev, dwPort, &dwType, &dwMode, &bInvert)) {
+			return FALSE;
+		}
+		if (dwMode != MODE_IRIGB && dwMode != MODE_PPS) {
+			continue;
+		}
+
+		if (*pdwPorts == 0 || plDelay[dwPort] < lMin) {
+			lMin = plDelay[dwPort];
 		}
-
-		if (0==(dwPortdat&(1 << (dwOutputModeShift+PORTDATA_OUTPUT_BIT_S)))) {
-			*pdwType = TYPE_TTL;
-		} else {
-			*pdwType = TYPE_DIFFERENTIAL;
+		if (*pdwPorts == 0 || plDelay[dwPort] > lMax) {
+			lMax = plDelay[dwPort];
 		}
-
-		bRet = TRUE;
+		*pdwPorts |= 1 << dwPort;
 	}
 
-	if (!bRet) {
-		SetLastError(ERROR_ACCESS_DENIED);
+	if (*pdwPorts) {
+		*pllAdvance = ((long long)lMin + lMax) / 2;
+		*pllSpread = ((long long)lMax - lMin + 1) / 2;
 	}
 
-	return bRet;
+	return TRUE;
 }
 
 /**
@@ -1610,6 +2446,523 @@ MXIRIG_API BOOL mxIrigbGetFpgaBuildDate(HANDLE hDev, PDWORD pValue)
 	return bRet;
 }
 
+/* A binary value to BCD, and back */
+static DWORD to_bcd(int value)
+{
+	return (value%10) | (((value/10)%10)<<4) | (((value/100)%10)<<8);
+}
+
+static int from_bcd(DWORD value)
+{
+	return (value&0xf) + ((value>>4)&0xf)*10 + ((value>>8)&0xf)*100;
+}
+
+/* Days from the Epoch to January 1 of the years 2000 ~ 2099 */
+static const int cumulative_days[100] = {
+#define YEAR_DAYS(n)	(10957 + (n) * 365 + ((n) + 3) / 4)	/* every 4th year is a leap year up to 2099 */
+#define YEAR_DAYS10(n)	YEAR_DAYS(n), YEAR_DAYS(n+1), YEAR_DAYS(n+2), YEAR_DAYS(n+3), YEAR_DAYS(n+4), \
+			YEAR_DAYS(n+5), YEAR_DAYS(n+6), YEAR_DAYS(n+7), YEAR_DAYS(n+8), YEAR_DAYS(n+9)
+	YEAR_DAYS10(0), YEAR_DAYS10(10), YEAR_DAYS10(20), YEAR_DAYS10(30), YEAR_DAYS10(40),
+	YEAR_DAYS10(50), YEAR_DAYS10(60), YEAR_DAYS10(70), YEAR_DAYS10(80), YEAR_DAYS10(90)
+#undef YEAR_DAYS10
+#undef YEAR_DAYS
+};
+
+/* The counter read with a frame, the time since its reference marker */
+static void decode_count(PIRIGB_FRAME pFrame, DWORD dwCount)
+{
+	pFrame->count = dwCount;
+	pFrame->elapsed = (long long)dwCount * IRIGBDECNT_UNIT;
+
+	/* The next frame resets the counter, a lost signal leaves it counting */
+	if ( pFrame->elapsed >= 1000000000LL ) {
+		pFrame->elapsed = -1;
+	}
+}
+
+/* Decode IRIGBDExDAT0 ~ 3 in pFrame->raw, return FALSE if the time is out of range */
+static BOOL decode_frame(PIRIGB_FRAME pFrame)
+{
+	DWORD *pdwValue = pFrame->raw;
+	int offset;
+
+	/* Transfer BCD to HEX */
+	pFrame->sec = ((pdwValue[0] >> IRIGBDEDAT0_SEC_BIT_S) & IRIGBDEDAT0_SEC_MASK) +
+		((pdwValue[0] >> IRIGBDEDAT0_TSEC_BIT_S) & IRIGBDEDAT0_TSEC_MASK) * 10;
+	pFrame->min = ((pdwValue[0] >> IRIGBDEDAT0_MIN_BIT_S) & IRIGBDEDAT0_MIN_MASK) +
+		((pdwValue[0] >> IRIGBDEDAT0_TMIN_BIT_S) & IRIGBDEDAT0_TMIN_MASK) * 10;
+	pFrame->hour = ((pdwValue[0] >> IRIGBDEDAT0_HOUR_BIT_S) & IRIGBDEDAT0_HOUR_MASK) +
+		((pdwValue[0] >> IRIGBDEDAT0_THOUR_BIT_S) & IRIGBDEDAT0_THOUR_MASK) * 10;
+	pFrame->yday = ((pdwValue[1] >> IRIGBDEDAT1_DAY_BIT_S) & IRIGBDEDAT1_DAY_MASK) +
+		((pdwValue[1] >> IRIGBDEDAT1_TDAY_BIT_S) & IRIGBDEDAT1_TDAY_MASK) * 10 +
+		((pdwValue[1] >> IRIGBDEDAT1_HDAY_BIT_S) & IRIGBDEDAT1_HDAY_MASK) * 100;
+	pFrame->year = 2000 + ((pdwValue[1] >> IRIGBDEDAT1_YEAR_BIT_S) & IRIGBDEDAT1_YEAR_MASK) +
+		((pdwValue[1] >> IRIGBDEDAT1_TYEAR_BIT_S) & IRIGBDEDAT1_TYEAR_MASK) * 10;
+	pFrame->sbs = (pdwValue[3] >> IRIGBDEDAT3_SBS_BIT_S) & IRIGBDEDAT3_SBS_MASK;
+
+	pFrame->lsp = (pdwValue[2] & IRIGBDEDAT2_BIT_LSP) ? 1:0;
+	pFrame->ls = (pdwValue[2] & IRIGBDEDAT2_BIT_LS) ? 1:0;
+	pFrame->dsp = (pdwValue[2] & IRIGBDEDAT2_BIT_DSP) ? 1:0;
+	pFrame->dst = (pdwValue[2] & IRIGBDEDAT2_BIT_DST) ? 1:0;
+	pFrame->tzs = (pdwValue[2] & IRIGBDEDAT2_BIT_TZS) ? 1:0;
+	pFrame->tzh = (pdwValue[2] & IRIGBDEDAT2_BIT_TZH) ? 1:0;
+	pFrame->tz = (pdwValue[2] >> IRIGBDEDAT2_TZ_BIT_S) & IRIGBDEDAT2_TZ_MASK;
+	pFrame->tq = (pdwValue[2] >> IRIGBDEDAT2_TQ_BIT_S) & IRIGBDEDAT2_TQ_MASK;
+	pFrame->par = (pdwValue[2] & IRIGBDEDAT2_BIT_PAR) ? 1:0;
+
+	/* Every 4th year is a leap year up to 2099, day 366 of another year is out of range */
+	if (pFrame->yday < 1 || pFrame->yday > 365 + (pFrame->year % 4 == 0) || pFrame->year > 2099 ||
+		pFrame->hour > 23 || pFrame->min > 59 || pFrame->sec > 60) {
+		pFrame->epoch = 0;
+		return FALSE;
+	}
+
+	/* The day of the year needs no month and day of the month, UTC = IRIG-B time + the signed offset */
+	offset = pFrame->tz * 3600 + (pFrame->tzh ? 1800 : 0);
+	pFrame->epoch = (long long)(cumulative_days[pFrame->year - 2000] + pFrame->yday - 1) * 86400 +
+		pFrame->hour * 3600 + pFrame->min * 60 + pFrame->sec +
+		(pFrame->tzs ? -offset : offset);
+
+	return TRUE;
+}
+
+/**
+ * Get the last frame decoded from an IRIG-B input, a timestamp of the signal independent of the RTC
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwSource - The decoder, TIMESRC_FIBER or TIMESRC_PORT1.
+ * @param  [out] pFrame - A pointer to an IRIGB_FRAME structure to receive the frame and the time elapsed in it.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetDecoderFrame(HANDLE hDev, DWORD dwSource, PIRIGB_FRAME pFrame)
+{
+	DWORD pdwAddress[4];
+	DWORD pdwCheck[2], pdwValue[2];
+	int retry;
+
+	if ( dwSource == TIMESRC_FIBER ) {
+		pdwAddress[0] = IRIGBDE0DAT0;
+	} else if ( dwSource == TIMESRC_PORT1 ) {
+		pdwAddress[0] = IRIGBDE1DAT0;
+	} else {
+		SetLastError(ERROR_ACCESS_DENIED);
+		return FALSE;
+	}
+	pdwAddress[1] = pdwAddress[0] + 1;
+	pdwAddress[2] = pdwAddress[0] + 2;
+	pdwAddress[3] = pdwAddress[0] + 3;
+	/* The counter follows the data registers */
+	pdwCheck[0] = pdwAddress[0] + 4;
+	pdwCheck[1] = pdwAddress[0];
+
+	for ( retry = 0; ; retry++ ) {
+		if ( !get_registers(hDev, pdwAddress, pFrame->raw, 4) ) {
+			return FALSE;
+		}
+
+		/* The next frame may be latched while the registers are read */
+		if ( !get_registers(hDev, pdwCheck, pdwValue, 2) ) {
+			return FALSE;
+		}
+		if ( pdwValue[1] == pFrame->raw[0] ) {
+			break;
+		}
+		if ( retry >= RTC_READ_RETRY ) {
+			return FALSE;
+		}
+	}
+	decode_count(pFrame, pdwValue[0]);
+
+	if ( !decode_frame(pFrame) ) {
+		SetLastError(ERROR_ACCESS_DENIED);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Get the frames, counters and signal status of both decoders at once
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pDecoders - A pointer to an IRIGB_DECODERS structure to receive the decoders.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetDecoders(HANDLE hDev, PIRIGB_DECODERS pDecoders)
+{
+	static const DWORD pdwFrame0[4] = { IRIGBDE0DAT0, IRIGBDE0DAT1, IRIGBDE0DAT2, IRIGBDE0DAT3 };
+	static const DWORD pdwFrame1[4] = { IRIGBDE1DAT0, IRIGBDE1DAT1, IRIGBDE1DAT2, IRIGBDE1DAT3 };
+	/* The counters with the first data again, a frame latched meanwhile changes it */
+	static const DWORD pdwCheck[4] = { IRIGBDE0CNT, IRIGBDE1CNT, IRIGBDE0DAT0, IRIGBDE1DAT0 };
+	DWORD pdwValue[4];
+	int retry, i;
+
+	for ( retry = 0; ; retry++ ) {
+		if ( !get_registers(hDev, pdwFrame0, pDecoders->frame[0].raw, 4) ||
+			!get_registers(hDev, pdwFrame1, pDecoders->frame[1].raw, 4) ||
+			!get_registers(hDev, pdwCheck, pdwValue, 4) ) {
+			return FALSE;
+		}
+		if ( pdwValue[2] == pDecoders->frame[0].raw[0] && pdwValue[3] == pDecoders->frame[1].raw[0] ) {
+			break;
+		}
+		if ( retry >= RTC_READ_RETRY ) {
+			return FALSE;
+		}
+	}
+	decode_count(&pDecoders->frame[0], pdwValue[0]);
+	decode_count(&pDecoders->frame[1], pdwValue[1]);
+
+	if ( !get_status(hDev, &pDecoders->intsts) ) {
+		return FALSE;
+	}
+
+	for ( i = 0; i < 2; i++ ) {
+		pDecoders->status[i] = decoder_status(pDecoders->intsts, i ? TIMESRC_PORT1 : TIMESRC_FIBER);
+		pDecoders->frameValid[i] = decode_frame(&pDecoders->frame[i]);
+	}
+	pDecoders->ppsStatus = pps_status(pDecoders->intsts);
+
+	return TRUE;
+}
+
+/* An FPGA without the register reads it as 0, a cleared one keeps the harmless probe value.
+ * The probe writes the register, only a setter about to write it anyway may call it. */
+static BOOL probe_register(HANDLE hDev, DWORD address, DWORD dwProbe)
+{
+	DWORD dwValue;
+	BOOL bRet;
+
+	if (!mxirigb_getreg(hDev, address, &dwValue)) {
+		return FALSE;
+	}
+	if (dwValue) {
+		return TRUE;
+	}
+
+	bRet = mxirigb_setreg(hDev, address, dwProbe) &&
+		mxirigb_getreg(hDev, address, &dwValue) && dwValue == dwProbe;
+	mxirigb_setreg(hDev, address, 0);
+
+	return bRet;
+}
+
+/* A leap second at minute 1 left disabled, a DST window on day 0 which no day of the year matches */
+#define RTCLS_PROBE		(to_bcd(1) << RTCLS_MIN_BIT_S)
+#define RTCDST_PROBE		(to_bcd(1) << RTCDST_ST_HOUR_BIT_S)
+
+/**
+ * Check the FPGA supports the leap second and DST registers.
+ * An FPGA without a register reads it as 0, a cleared register is probed with a value that
+ * schedules nothing and cleared again. Call it at setup, not while another process sets the events.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @return - If both registers keep a written value, the return value is nonzero.
+ */
+MXIRIG_API BOOL mxIrigbIsRtcEventSupported(HANDLE hDev)
+{
+	return probe_register(hDev, RTCLS, RTCLS_PROBE) &&
+		probe_register(hDev, RTCDST, RTCDST_PROBE) ? TRUE : FALSE;
+}
+
+/**
+ * Schedule or cancel the leap second of the RTC
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] pLeap - A pointer to a LEAP_SECOND structure, enable 0 cancels the scheduled leap second.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the FPGA does not support it or the time is invalid, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetLeapSecond(HANDLE hDev, PLEAP_SECOND pLeap)
+{
+	DWORD dwValue = 0;
+	DWORD dwCheck;
+
+	if (pLeap->enable) {
+		if (pLeap->year<2000 || pLeap->year>2099 ||
+			pLeap->yday<1 || pLeap->yday>366 ||
+			pLeap->hour<0 || pLeap->hour>23 ||
+			pLeap->min<0 || pLeap->min>59) {
+			SetLastError(ERROR_ACCESS_DENIED);
+			return FALSE;
+		}
+
+		dwValue = RTCLS_BIT_ENABLE |
+			((to_bcd(pLeap->min) & RTCLS_MIN_MASK) << RTCLS_MIN_BIT_S) |
+			((to_bcd(pLeap->hour) & RTCLS_HOUR_MASK) << RTCLS_HOUR_BIT_S) |
+			((to_bcd(pLeap->yday) & RTCLS_DAY_MASK) << RTCLS_DAY_BIT_S) |
+			((to_bcd(pLeap->year%100) & RTCLS_YEAR_MASK) << RTCLS_YEAR_BIT_S);
+	}
+
+	/* Cancelling is read back as 0 on an FPGA without the register too */
+	if (!probe_register(hDev, RTCLS, RTCLS_PROBE)) {
+		SetLastError(ERROR_NOT_SUPPORTED);
+		return FALSE;
+	}
+
+	/* The type first, the RTC may act on the event as soon as it is enabled */
+	if (!mxirigb_setclrreg(hDev, RTCCON, pLeap->ls ? RTCCON_BIT_LS_TYPE : 0, RTCCON_BIT_LS_TYPE) ||
+		!mxirigb_setreg(hDev, RTCLS, dwValue)) {
+		SetLastError(ERROR_ACCESS_DENIED);
+		return FALSE;
+	}
+
+	/* An FPGA without the register reads it back as 0. The register has 32 bits,
+	 * the int RTCLS_BIT_ENABLE sign extends in a 64 bit DWORD. */
+	if (!mxirigb_getreg(hDev, RTCLS, &dwCheck) || (dwCheck & 0xffffffffUL) != (dwValue & 0xffffffffUL)) {
+		SetLastError(ERROR_NOT_SUPPORTED);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Get the leap second scheduled in the RTC, the register is only read.
+ * An FPGA without the register reports no leap second.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pLeap - A pointer to a LEAP_SECOND structure to receive the leap second.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetLeapSecond(HANDLE hDev, PLEAP_SECOND pLeap)
+{
+	DWORD dwValue, dwCon;
+
+	/* Only read, an FPGA without the register reports no leap second */
+	if (!mxirigb_getreg(hDev, RTCLS, &dwValue) || !mxirigb_getreg(hDev, RTCCON, &dwCon)) {
+		SetLastError(ERROR_ACCESS_DENIED);
+		return FALSE;
+	}
+
+	pLeap->enable = (dwValue & RTCLS_BIT_ENABLE) ? 1:0;
+	pLeap->min = from_bcd((dwValue >> RTCLS_MIN_BIT_S) & RTCLS_MIN_MASK);
+	pLeap->hour = from_bcd((dwValue >> RTCLS_HOUR_BIT_S) & RTCLS_HOUR_MASK);
+	pLeap->yday = from_bcd((dwValue >> RTCLS_DAY_BIT_S) & RTCLS_DAY_MASK);
+	pLeap->year = 2000 + from_bcd((dwValue >> RTCLS_YEAR_BIT_S) & RTCLS_YEAR_MASK);
+	pLeap->ls = (dwCon & RTCCON_BIT_LS_TYPE) ? 1:0;
+
+	return TRUE;
+}
+
+/**
+ * Set or clear the daylight saving time window of the RTC
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] pDst - A pointer to a DST_WINDOW structure, startYday 0 clears the window.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the FPGA does not support it or the window is invalid, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetDstWindow(HANDLE hDev, PDST_WINDOW pDst)
+{
+	DWORD dwValue = 0;
+	DWORD dwCheck;
+
+	if (pDst->startYday) {
+		if (pDst->startYday<1 || pDst->startYday>366 ||
+			pDst->endYday<1 || pDst->endYday>366 ||
+			pDst->startHour<0 || pDst->startHour>23 ||
+			pDst->endHour<0 || pDst->endHour>23 ||
+			(pDst->startYday == pDst->endYday && pDst->startHour == pDst->endHour)) {
+			SetLastError(ERROR_ACCESS_DENIED);
+			return FALSE;
+		}
+
+		dwValue =
+			((to_bcd(pDst->startHour) & RTCDST_ST_HOUR_MASK) << RTCDST_ST_HOUR_BIT_S) |
+			((to_bcd(pDst->startYday) & RTCDST_ST_DAY_MASK) << RTCDST_ST_DAY_BIT_S) |
+			((to_bcd(pDst->endHour) & RTCDST_ED_HOUR_MASK) << RTCDST_ED_HOUR_BIT_S) |
+			((to_bcd(pDst->endYday) & RTCDST_ED_DAY_MASK) << RTCDST_ED_DAY_BIT_S);
+	}
+
+	/* Clearing is read back as 0 on an FPGA without the register too */
+	if (!probe_register(hDev, RTCDST, RTCDST_PROBE)) {
+		SetLastError(ERROR_NOT_SUPPORTED);
+		return FALSE;
+	}
+
+	if (!mxirigb_setreg(hDev, RTCDST, dwValue)) {
+		SetLastError(ERROR_ACCESS_DENIED);
+		return FALSE;
+	}
+
+	if (!mxirigb_getreg(hDev, RTCDST, &dwCheck) || dwCheck != dwValue) {
+		SetLastError(ERROR_NOT_SUPPORTED);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Get the daylight saving time window of the RTC, the register is only read.
+ * An FPGA without the register reports no window.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pDst - A pointer to a DST_WINDOW structure to receive the window.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetDstWindow(HANDLE hDev, PDST_WINDOW pDst)
+{
+	DWORD dwValue;
+
+	/* Only read, an FPGA without the register reports no window */
+	if (!mxirigb_getreg(hDev, RTCDST, &dwValue)) {
+		SetLastError(ERROR_ACCESS_DENIED);
+		return FALSE;
+	}
+
+	pDst->startHour = from_bcd((dwValue >> RTCDST_ST_HOUR_BIT_S) & RTCDST_ST_HOUR_MASK);
+	pDst->startYday = from_bcd((dwValue >> RTCDST_ST_DAY_BIT_S) & RTCDST_ST_DAY_MASK);
+	pDst->endHour = from_bcd((dwValue >> RTCDST_ED_HOUR_BIT_S) & RTCDST_ED_HOUR_MASK);
+	pDst->endYday = from_bcd((dwValue >> RTCDST_ED_DAY_BIT_S) & RTCDST_ED_DAY_MASK);
+
+	return TRUE;
+}
+
+/* The error bound of an IRIG-B (IEEE 1344) time quality code in ns, locked is 0 */
+static long long tq_bound(unsigned char tq)
+{
+	long long bound = 1;
+	int i;
+
+	if (tq == C37118_TQ_LOCKED) {
+		return 0;
+	}
+	/* 0x1: 1 ns, 0x2: 10 ns, ... 0xB: 10 s, 0xC ~ 0xE are reserved */
+	for (i = 1; i < tq && i < 0xB; i++) {
+		bound *= 10;
+	}
+
+	return bound;
+}
+
+/**
+ * Derive the IEC 61850 and IEEE C37.118 time quality from the input fields
+ * @param  [in,out] pQuality - A pointer to a TIME_QUALITY structure with the input fields set.
+ * @return None
+ */
+MXIRIG_API void mxIrigbEvalTimeQuality(PTIME_QUALITY pQuality)
+{
+	PTIME_QUALITY q = pQuality;
+	long long offset = (q->offset < 0) ? -q->offset : q->offset;
+	long long limit;
+	int code;
+
+	q->clockFailure = q->failure || q->tq == C37118_TQ_FAULT;
+	q->clockNotSynchronized = q->clockFailure || !q->synchronized;
+	q->leapSecondsKnown = !q->clockFailure && q->synced;
+
+	if (q->clockFailure) {
+		q->error = -1;
+		q->timeAccuracy = MXIRIG_ACCURACY_UNSPECIFIED;
+		q->c37118Quality = C37118_TQ_FAULT;
+		return;
+	}
+
+	q->error = tq_bound(q->tq) + offset + q->holdover / 1000000000LL * MXIRIG_HOLDOVER_DRIFT;
+
+	/* TimeAccuracy n: the error is within 2^-n s */
+	q->timeAccuracy = 0;
+	while (q->timeAccuracy < 24 && q->error <= (1000000000LL >> (q->timeAccuracy + 1))) {
+		q->timeAccuracy++;
+	}
+
+	/* Locked while the source is locked and the clock follows it within 1 us,
+	 * else the smallest power of ten bounding the error, 0xB is 10 s */
+	if (!q->clockNotSynchronized && q->tq == C37118_TQ_LOCKED && q->error <= 1000) {
+		q->c37118Quality = C37118_TQ_LOCKED;
+		return;
+	}
+	for (code = 0x1, limit = 1; code < 0xB && q->error > limit; code++) {
+		limit *= 10;
+	}
+	q->c37118Quality = code;
+}
+
+/**
+ * Get the time quality published by the time sync daemon, without an ioctl
+ * @param  [in] index - the card index, or MXIRIG_QUALITY_SYSTEM for the system clock
+ * @param  [out] pQuality - A pointer to a TIME_QUALITY structure to receive the quality.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the daemon does not publish the quality of the clock, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetTimeQuality(int index, PTIME_QUALITY pQuality)
+{
+#ifdef WIN32
+	SetLastError(ERROR_NOT_SUPPORTED);
+	return FALSE;
+#else
+	/* Mapped once, the publisher keeps the same object across restarts */
+	static TIME_QUALITY_TABLE *table = NULL;
+	TIME_QUALITY_SLOT *slot;
+	struct timespec now;
+	unsigned int seq;
+	int fd, retry;
+
+	if (index < 0 || index >= MXIRIG_QUALITY_SLOTS || pQuality == NULL) {
+		errno = EINVAL;
+		return FALSE;
+	}
+
+	if (table == NULL) {
+		TIME_QUALITY_TABLE *map;
+
+		fd = shm_open(MXIRIG_QUALITY_SHM, O_RDONLY, 0);
+		if (fd < 0) {
+			return FALSE;
+		}
+		map = (TIME_QUALITY_TABLE *)mmap(NULL, sizeof(*map), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED) {
+			return FALSE;
+		}
+		if (map->magic != MXIRIG_QUALITY_MAGIC || map->version != MXIRIG_QUALITY_VERSION) {
+			munmap(map, sizeof(*map));
+			errno = EPROTO;
+			return FALSE;
+		}
+		if (!__sync_bool_compare_and_swap(&table, NULL, map)) {
+			munmap(map, sizeof(*map));
+		}
+	}
+
+	slot = &table->slot[index];
+	for (retry = 0; retry < QUALITY_READ_RETRY; retry++) {
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			continue;
+		}
+		memcpy(pQuality, &slot->quality, sizeof(*pQuality));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+			break;
+		}
+	}
+	if (retry == QUALITY_READ_RETRY) {
+		errno = EBUSY;
+		return FALSE;
+	}
+	if (!__atomic_load_n(&slot->used, __ATOMIC_RELAXED)) {
+		errno = ENODEV;
+		return FALSE;
+	}
+
+	/* A dead publisher leaves the last quality behind */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (now.tv_sec - __atomic_load_n(&table->heartbeat, __ATOMIC_RELAXED) > MXIRIG_QUALITY_STALE) {
+		pQuality->failure = 1;
+		mxIrigbEvalTimeQuality(pQuality);
+	}
+
+	return TRUE;
+#endif
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -12,6 +12,9 @@
  * @author holsety.chen@moxa.com
  */
 
+#ifndef __MXIRIG_H_
+#define __MXIRIG_H_
+
 #ifdef WIN32
     #ifdef MXIRIG_EXPORTS
     #define MXIRIG_API __declspec(dllexport)
@@ -59,6 +62,10 @@
 extern "C" {          // we need to export the C interface
 #endif
 
+#define MXIRIG_MAX_DEVICES      8
+#define MXIRIG_DEV_NAME         "/dev/moxa_irigb"
+#define MXIRIG_DEV_PATH_SIZE    32
+
 typedef struct _RTCTIME {
     int nanosec;        /* nano seconds after the second - [0,999999999] */
     int sec;            /* seconds after the minute - [0,60] */
@@ -84,7 +91,8 @@ enum _RTC_SYNC_SOURCE_
     TIMESRC_FIBER,
     TIMESRC_PORT1,
 
-    TIMESRC_UNKNOWN
+    TIMESRC_UNKNOWN,
+    TIMESRC_PPS = 4     /* the edge of the PPS decoder, the seconds are kept, after TIMESRC_UNKNOWN */
 };
 
 enum _IRIG_SIGNAL_STATUS_
@@ -97,6 +105,25 @@ enum _IRIG_SIGNAL_STATUS_
     IRIG_STATUS_UNKNOWN
 };
 
+/* The bits of the status word, the INTSTS register */
+enum _IRIGB_STATUS_BIT_
+{
+    IRIGB_BIT_DE0_OFF = 0,      /* decoder 0 (Fiber) off line */
+    IRIGB_BIT_DE0_FRMERR,       /* decoder 0 frame error */
+    IRIGB_BIT_DE0_PARERR,       /* decoder 0 parity error */
+    IRIGB_BIT_DE0_DONE,         /* decoder 0 frame done */
+    IRIGB_BIT_DE1_OFF,          /* decoder 1 (port 1) off line */
+    IRIGB_BIT_DE1_FRMERR,
+    IRIGB_BIT_DE1_PARERR,
+    IRIGB_BIT_DE1_DONE,
+    IRIGB_BIT_PPSDE_TIMEOUT,    /* PPS decoder pulse time out */
+    IRIGB_BIT_PPSDE_DONE,       /* PPS decoder pulse done */
+    IRIGB_BIT_IRIGEN_DONE,      /* IRIG-B encoder frame done */
+    IRIGB_BIT_PPSEN_DONE,       /* PPS encoder pulse done */
+
+    IRIGB_STATUS_BITS
+};
+
 enum _PORT_LIST_
 {
     PORT_FIBER = 0,
@@ -133,6 +160,161 @@ enum _PARITY_CHECK_MODE_
     PARITY_CHECK_NONE
 };
 
+/*
+ * Time quality of a clock, published by ServiceSyncTime in the shared memory
+ * MXIRIG_QUALITY_SHM, a slot per card and one for the system clock.
+ * The input fields describe the clock, "mxIrigbEvalTimeQuality" derives the
+ * IEC 61850-7-2 TimeQuality and the IEEE C37.118 time quality from them.
+ */
+#define MXIRIG_QUALITY_SHM          "/mxirigb_quality"  /* shm_open() name */
+#define MXIRIG_QUALITY_MAGIC        0x5154584d  /* "MXTQ" */
+#define MXIRIG_QUALITY_VERSION      1
+#define MXIRIG_QUALITY_SYSTEM       MXIRIG_MAX_DEVICES  /* the slot of the system clock */
+#define MXIRIG_QUALITY_SLOTS        (MXIRIG_MAX_DEVICES + 1)
+#define MXIRIG_QUALITY_STALE        5       /* seconds without an update before the publisher is dead */
+#define MXIRIG_HOLDOVER_DRIFT       1000    /* assumed drift of a free running clock in ns per second */
+#define MXIRIG_ACCURACY_UNSPECIFIED 31      /* TimeAccuracy of an unknown error */
+#define C37118_TQ_LOCKED            0x0     /* locked to a UTC traceable source */
+#define C37118_TQ_FAULT             0xF     /* clock failure, the time is not reliable */
+
+typedef struct _TIME_QUALITY {
+    /* Inputs */
+    int failure;            /* the clock cannot be read, or was never set */
+    int synchronized;       /* the clock follows a valid time source now */
+    int synced;             /* the clock followed a valid time source since the publisher started */
+    unsigned char tq;       /* IRIG-B (IEEE 1344) time quality of the source, 0xF for a fault */
+    unsigned char lsp;      /* leap second pending at the end of the minute */
+    unsigned char ls;       /* leap second type, 0=+, 1=- */
+    unsigned char dst;      /* daylight saving time in effect */
+    long long holdover;     /* ns since the time source was lost, 0 while synchronized */
+    long long offset;       /* the measured error against the time source in ns */
+
+    /* Derived */
+    BOOL leapSecondsKnown;      /* IEC 61850 LeapSecondsKnown */
+    BOOL clockFailure;          /* IEC 61850 ClockFailure */
+    BOOL clockNotSynchronized;  /* IEC 61850 ClockNotSynchronized */
+    int timeAccuracy;           /* IEC 61850 TimeAccuracy, 0 ~ 24 bits of the second, 31 unspecified */
+    int c37118Quality;          /* IEEE C37.118 time quality code, 0x0 ~ 0xB, 0xF on a fault */
+    long long error;            /* the estimated time error bound in ns */
+
+    long long updateSec;    /* system time the slot was written */
+    long long updateNsec;
+} TIME_QUALITY, *PTIME_QUALITY;
+
+/* The shared memory layout, a slot is written with a sequence lock: odd while being written */
+typedef struct _TIME_QUALITY_SLOT {
+    unsigned int seq;
+    unsigned int used;      /* the slot has a clock */
+    TIME_QUALITY quality;
+} TIME_QUALITY_SLOT;
+
+typedef struct _TIME_QUALITY_TABLE {
+    unsigned int magic;     /* MXIRIG_QUALITY_MAGIC */
+    unsigned int version;   /* MXIRIG_QUALITY_VERSION */
+    unsigned int pid;       /* the publisher */
+    unsigned int reserved;
+    long long heartbeat;    /* CLOCK_MONOTONIC seconds of the last update */
+    TIME_QUALITY_SLOT slot[MXIRIG_QUALITY_SLOTS];
+} TIME_QUALITY_TABLE;
+
+/*
+ * The last frame decoded by an IRIG-B decoder, independent of the RTC.
+ * The time is the on-time marker of the frame in the IRIG-B (local) time,
+ * the IEEE 1344 (C37.118) signed time offset gives UTC: IRIG-B time + offset = UTC,
+ * a PST signal (UTC - 8 h) carries an offset of +8 h.
+ * The frame is latched at its end, the reference marker of the next frame, where
+ * IRIGBDExCNT starts counting: the signal time at the read is epoch + 1 s + elapsed.
+ */
+typedef struct _IRIGB_FRAME {
+    DWORD raw[4];       /* IRIGBDExDAT0 ~ IRIGBDExDAT3 */
+    int sec;            /* [0,60] */
+    int min;            /* [0,59] */
+    int hour;           /* [0,23] */
+    int yday;           /* day of the year - [1,366] */
+    int year;           /* 2000 ~ 2099 */
+    int sbs;            /* straight binary seconds of the day */
+    unsigned char lsp;  /* leap second pending */
+    unsigned char ls;   /* leap second type, 0=+, 1=- */
+    unsigned char dsp;  /* DST pending */
+    unsigned char dst;  /* DST in effect */
+    unsigned char tzs;  /* time offset sign, 0=+, 1=- */
+    unsigned char tzh;  /* time offset additional half hour */
+    unsigned char tz;   /* time offset in hours */
+    unsigned char tq;   /* time quality */
+    unsigned char par;  /* parity bit */
+    long long epoch;    /* UTC seconds since the Epoch of the frame */
+    DWORD count;        /* IRIGBDExCNT read with the frame */
+    long long elapsed;  /* ns since the reference marker, -1 if the counter ran past a frame */
+} IRIGB_FRAME, *PIRIGB_FRAME;
+
+/* Both decoders read at once, decoder 0 is the Fiber port and decoder 1 IRIG-B port 1 */
+typedef struct _IRIGB_DECODERS {
+    IRIGB_FRAME frame[2];   /* the last frames */
+    BOOL frameValid[2];     /* the frame time is in range */
+    DWORD status[2];        /* one of _IRIG_SIGNAL_STATUS_ */
+    DWORD ppsStatus;        /* the PPS decoder, one of _IRIG_SIGNAL_STATUS_ */
+    DWORD intsts;           /* the INTSTS bits the status are from */
+} IRIGB_DECODERS, *PIRIGB_DECODERS;
+
+#define MXIRIG_WAIT_INFINITE    0xFFFFFFFF  /* mxIrigbWaitEvent without a timeout */
+
+/* The status of all sources, from one status word */
+typedef struct _IRIGB_ALL_STATUS {
+    DWORD intsts;                   /* the status word, _IRIGB_STATUS_BIT_ bits */
+    DWORD signal[2];                /* Fiber and port 1 decoders, one of _IRIG_SIGNAL_STATUS_ */
+    unsigned char ppsTimeout;       /* the PPS decoder timed out */
+    unsigned char ppsDone;          /* the PPS decoder took a pulse */
+    unsigned char irigEncoderDone;  /* the IRIG-B encoder sent a frame */
+    unsigned char ppsEncoderDone;   /* the PPS encoder sent a pulse */
+} IRIGB_ALL_STATUS, *PIRIGB_ALL_STATUS;
+
+/*
+ * Event counters of the status word, owned by the caller and cleared by it.
+ * Every status word read adds a poll, and one to each bit set in it, so an
+ * intermittent parity error is counted even when the priority ordered
+ * _IRIG_SIGNAL_STATUS_ of the source reads another status.
+ */
+typedef struct _IRIGB_STATUS_COUNTERS {
+    DWORD polls;                    /* status words counted */
+    DWORD bit[IRIGB_STATUS_BITS];   /* status words with the _IRIGB_STATUS_BIT_ set */
+} IRIGB_STATUS_COUNTERS, *PIRIGB_STATUS_COUNTERS;
+
+/*
+ * The loopback test times a pulse of an output port back into an input port through
+ * the cables and the equipment between them. The delays are the round trip in ns.
+ */
+#define MXIRIG_LOOPBACK_MAX_RUNS    10000
+
+typedef struct _IRIGB_LOOPBACK {
+    DWORD runs;         /* runs timed */
+    DWORD failures;     /* runs the pulse did not come back */
+    long long mean;     /* mean round trip delay */
+    long long min;      /* shortest round trip delay */
+    long long max;      /* longest round trip delay */
+    long long stddev;   /* standard deviation of the round trip delay */
+} IRIGB_LOOPBACK, *PIRIGB_LOOPBACK;
+
+/*
+ * Leap second and daylight saving time events kept by the RTC, which announces them
+ * with the LSP and DSP bits of the IRIG-B output and applies them itself.
+ * The times are in the RTC time, the day is the day of the year.
+ */
+typedef struct _LEAP_SECOND {
+    int enable;         /* 0: no leap second scheduled */
+    int year;           /* 2000 ~ 2099 */
+    int yday;           /* day of the year - [1,366] */
+    int hour;           /* [0,23] */
+    int min;            /* [0,59], the leap second is at the end of this minute */
+    int ls;             /* leap second type, 0=+ (23:59:60 is inserted), 1=- (23:59:59 is deleted) */
+} LEAP_SECOND, *PLEAP_SECOND;
+
+typedef struct _DST_WINDOW {
+    int startYday;      /* day of the year DST starts - [1,366], 0: no DST */
+    int startHour;      /* [0,23] */
+    int endYday;        /* day of the year DST ends - [1,366] */
+    int endHour;        /* [0,23] */
+} DST_WINDOW, *PDST_WINDOW;
+
 enum _IRIGB_BOARD_HWID_
 {
     DA_IRIGB_4DIO_PCI104 = 1,
@@ -151,6 +333,12 @@ enum _IRIGB_BOARD_HWID_
  */
 MXIRIG_API BOOL mxIrigbGetHardwareID(HANDLE hDev, PDWORD pdwHwId);
 
+/**
+ * Get the number of Irigb devices
+ * @return The number of devices, they are opened by index 0 to count-1.
+ */
+MXIRIG_API int mxIrigbGetDeviceCount(void);
+
 /**
  * Open Irigb device
  * @param  [in] index - the device number (started from 0)
@@ -175,6 +363,18 @@ MXIRIG_API void mxIrigbClose(HANDLE hDev);
  */
 MXIRIG_API BOOL mxIrigbGetTime(HANDLE hDev, PRTCTIME pRtcTime);
 
+/**
+ * Get internal RTC time from Irigb device, the date and the nanoseconds are from the same second.
+ * The RTC registers are not latched together, a read straddling the second rollover is read again.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pRtcTime - A pointer to a RTCTIME structure to receive the current date and time.
+ * @param  [out] pdwTears - A pointer to receive the number of reads discarded for straddling a second, can be NULL.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetTimeEx(HANDLE hDev, PRTCTIME pRtcTime, PDWORD pdwTears);
+
 /**
  * Set internal RTC time to Irigb device
  * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
@@ -218,7 +418,8 @@ MXIRIG_API BOOL mxIrigbGetSyncTimeSrc(HANDLE hDev, PDWORD pdwSource);
 /**
  * Get IRIGB signal status
  * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
- * @param  [in] dwSource - IRIGB signal source, the value is one of _PORT_LIST_.
+ * @param  [in] dwSource - TIMESRC_FIBER, TIMESRC_PORT1 or TIMESRC_PPS. The PPS decoder is off line
+ *         after a time out and normal after a pulse.
  * @param  [out] dwStatus - A point to get IRIGB signal status, the value is one of _IRIG_SIGNAL_STATUS_.
  * @return - If the operation completes successfully, the return value is nonzero.
  *           If the operation fails or is pending, the return value is zero. 
@@ -226,6 +427,40 @@ MXIRIG_API BOOL mxIrigbGetSyncTimeSrc(HANDLE hDev, PDWORD pdwSource);
  */
 MXIRIG_API BOOL mxIrigbGetSignalStatus(HANDLE hDev, DWORD dwSource, PDWORD pdwStatus);
 
+/**
+ * Get the status of all sources from one status word
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pStatus - A pointer to an IRIGB_ALL_STATUS structure to receive the status.
+ * @param  [in,out] pCounters - The event counters to accumulate the status word into, NULL for none.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetAllStatus(HANDLE hDev, PIRIGB_ALL_STATUS pStatus, PIRIGB_STATUS_COUNTERS pCounters);
+
+/**
+ * Accumulate a status word into event counters
+ * @param  [in] dwStatus - The INTSTS bits, e.g. IRIGB_ALL_STATUS.intsts or IRIGB_DECODERS.intsts.
+ * @param  [in,out] pCounters - The event counters.
+ * @return None
+ */
+MXIRIG_API void mxIrigbCountStatus(DWORD dwStatus, PIRIGB_STATUS_COUNTERS pCounters);
+
+/**
+ * Wait for events of the decoders, the PPS decoder or the encoders
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwMask - The events to wait for, (1 << _IRIGB_STATUS_BIT_) bits. The DONE bits are
+ *         edges, a new frame or pulse; the off line, error and time out bits are reported while set.
+ * @param  [in] dwTimeout - The timeout in ms, MXIRIG_WAIT_INFINITE for none.
+ * @param  [out] pdwEvents - The events occurred, 0 on timeout.
+ *         The call blocks in poll() on the device if the driver supports it, otherwise it sleeps until
+ *         shortly before the expected edge, from the decoder counters or the RTC, and reads closely.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbWaitEvent(HANDLE hDev, DWORD dwMask, DWORD dwTimeout, PDWORD pdwEvents);
+
 /**
  * Set IRIGB input Parity check mode
  * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
@@ -288,6 +523,70 @@ MXIRIG_API BOOL mxIrigbSetPpsWidth(HANDLE hDev, DWORD dwMilliSecond);
  */
 MXIRIG_API BOOL mxIrigbGetPpsWidth(HANDLE hDev, PDWORD pdwMilliSecond);
 
+/**
+ * Feed the PPS decoder from the input of a port.
+ * The decoder takes the input line the IRIG-B decoder of the port takes, so the signal
+ * type and inversion are set by "mxIrigbSetInputSignalType" function.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwPort - PORT_FIBER or PORT_1, PORT_UNKNOWN to disable the PPS decoder.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetPpsInput(HANDLE hDev, DWORD dwPort);
+
+/**
+ * Get the port feeding the PPS decoder
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pdwPort - A point to get PORT_FIBER or PORT_1, PORT_UNKNOWN if the decoder is
+ *         disabled or takes another input.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetPpsInput(HANDLE hDev, PDWORD pdwPort);
+
+/**
+ * Set Pulse Per Second input hold time, the PPS decoder ignores the edges this long after a pulse
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwMilliSecond - The hold time per millisecond, 0 ~ 999.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetPpsHoldTime(HANDLE hDev, DWORD dwMilliSecond);
+
+/**
+ * Get Pulse Per Second input hold time
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pdwMilliSecond - A point to get the hold time per millisecond value.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetPpsHoldTime(HANDLE hDev, PDWORD pdwMilliSecond);
+
+/**
+ * Set Pulse Per Second input timeout, the PPS decoder raises IRIGB_BIT_PPSDE_TIMEOUT
+ * when no pulse comes this long
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwMilliSecond - The timeout per millisecond, more than 1000.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetPpsTimeout(HANDLE hDev, DWORD dwMilliSecond);
+
+/**
+ * Get Pulse Per Second input timeout
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pdwMilliSecond - A point to get the timeout per millisecond value.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetPpsTimeout(HANDLE hDev, PDWORD pdwMilliSecond);
+
 /**
  * Set input signal type
  * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
@@ -338,6 +637,41 @@ MXIRIG_API BOOL mxIrigbSetOutputSignalType(HANDLE hDev, DWORD dwPort, DWORD dwTy
  */
 MXIRIG_API BOOL mxIrigbGetOutputSignalType(HANDLE hDev, DWORD dwPort, PDWORD pdwType, PDWORD pdwMode, PBOOL pbInvert);
 
+/**
+ * Measure the round trip delay of a loopback from an output port to an input port.
+ * The output port sends the loopback test pulse and the input line of the IRIG-B decoder
+ * of the input port stops the LPBTCNT counter, so the input signal type is the one set by
+ * "mxIrigbSetInputSignalType" function. The port settings are restored afterwards; the
+ * output port does not carry its signal while the test runs, about a millisecond a run.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwOutPort - The output port, PORT_1 ~ PORT_4.
+ * @param  [in] dwInPort - The input port, PORT_FIBER or PORT_1.
+ * @param  [in] dwRuns - The runs to average, 1 ~ MXIRIG_LOOPBACK_MAX_RUNS.
+ * @param  [out] pResult - A pointer to an IRIGB_LOOPBACK structure to receive the delays.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero, also when no run
+ *           came back. To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbMeasureLoopback(HANDLE hDev, DWORD dwOutPort, DWORD dwInPort, DWORD dwRuns, PIRIGB_LOOPBACK pResult);
+
+/**
+ * Get the advance of the RTC compensating the cable delays of the output ports.
+ * The card has no output delay and a single IRIG-B and PPS encoder driven by the RTC, so the
+ * ports in MODE_IRIGB or MODE_PPS share one phase: the advance is the middle of their delays and
+ * every port is on time within the spread. The ports passing an input through are left out.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] plDelay - The cable delays of the ports in ns, indexed by _PORT_LIST_ up to PORT_4;
+ *         negative if a port leads. The PORT_FIBER entry is not used.
+ * @param  [out] pllAdvance - A point to get the time the RTC should lead in ns, 0 without an encoder port.
+ * @param  [out] pllSpread - A point to get the largest error of a port in ns.
+ * @param  [out] pdwPorts - A point to get the encoder ports, (1 << port) bits.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetOutputAdvance(HANDLE hDev, const long plDelay[PORT_UNKNOWN], long long *pllAdvance,
+    long long *pllSpread, PDWORD pdwPorts);
+
 /**
  * Set digital output signal
  * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
@@ -381,7 +715,101 @@ MXIRIG_API BOOL mxIrigbGetDigitalInputSignal(HANDLE hDev, DWORD dwPort, PDWORD p
  */
 MXIRIG_API BOOL mxIrigbGetFpgaBuildDate(HANDLE hDev, PDWORD pValue);
 
+/**
+ * Get the last frame decoded from an IRIG-B input, a timestamp of the signal independent of the RTC
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] dwSource - The decoder, TIMESRC_FIBER or TIMESRC_PORT1.
+ * @param  [out] pFrame - A pointer to an IRIGB_FRAME structure to receive the frame.
+ *         The decoder counter read with it gives the time elapsed since the reference marker.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetDecoderFrame(HANDLE hDev, DWORD dwSource, PIRIGB_FRAME pFrame);
+
+/**
+ * Get the frames, counters and signal status of both decoders at once
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pDecoders - A pointer to an IRIGB_DECODERS structure to receive the decoders.
+ *         The registers are read in three ioctls and the status in one, a frame latched meanwhile is read again.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetDecoders(HANDLE hDev, PIRIGB_DECODERS pDecoders);
+
+/**
+ * Check the FPGA supports the leap second and DST registers.
+ * An FPGA without a register reads it as 0, a cleared register is probed with a value that
+ * schedules nothing and cleared again. Call it at setup, not while another process sets the events.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @return - If both registers keep a written value, the return value is nonzero.
+ */
+MXIRIG_API BOOL mxIrigbIsRtcEventSupported(HANDLE hDev);
+
+/**
+ * Schedule or cancel the leap second of the RTC
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] pLeap - A pointer to a LEAP_SECOND structure, enable 0 cancels the scheduled leap second.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the FPGA does not support it or the time is invalid, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetLeapSecond(HANDLE hDev, PLEAP_SECOND pLeap);
+
+/**
+ * Get the leap second scheduled in the RTC, the register is only read.
+ * An FPGA without the register reports no leap second.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pLeap - A pointer to a LEAP_SECOND structure to receive the leap second.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetLeapSecond(HANDLE hDev, PLEAP_SECOND pLeap);
+
+/**
+ * Set or clear the daylight saving time window of the RTC
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [in] pDst - A pointer to a DST_WINDOW structure, startYday 0 clears the window.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the FPGA does not support it or the window is invalid, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbSetDstWindow(HANDLE hDev, PDST_WINDOW pDst);
+
+/**
+ * Get the daylight saving time window of the RTC, the register is only read.
+ * An FPGA without the register reports no window.
+ * @param  [in] hDev - A valid handle value return from "mxIrigbOpen" function.
+ * @param  [out] pDst - A pointer to a DST_WINDOW structure to receive the window.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the operation fails or is pending, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetDstWindow(HANDLE hDev, PDST_WINDOW pDst);
+
+/**
+ * Derive the IEC 61850 and IEEE C37.118 time quality from the input fields
+ * @param  [in,out] pQuality - A pointer to a TIME_QUALITY structure with the input fields set.
+ *         The error bound is the source tq bound plus |offset| plus MXIRIG_HOLDOVER_DRIFT per second of holdover.
+ * @return None
+ */
+MXIRIG_API void mxIrigbEvalTimeQuality(PTIME_QUALITY pQuality);
+
+/**
+ * Get the time quality published by the time sync daemon, without an ioctl
+ * @param  [in] index - the card index, or MXIRIG_QUALITY_SYSTEM for the system clock
+ * @param  [out] pQuality - A pointer to a TIME_QUALITY structure to receive the quality.
+ *         The clock fails if the daemon stopped updating for MXIRIG_QUALITY_STALE seconds.
+ * @return - If the operation completes successfully, the return value is nonzero.
+ *           If the daemon does not publish the quality of the clock, the return value is zero. 
+ *           To get extended error information, call GetLastError.
+ */
+MXIRIG_API BOOL mxIrigbGetTimeQuality(int index, PTIME_QUALITY pQuality);
+
 #ifdef __cplusplus    // If used by C++ code, 
 }
 #endif
 
+#endif  // __MXIRIG_H_